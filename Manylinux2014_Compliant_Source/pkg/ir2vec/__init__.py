@@ -9,7 +9,37 @@ from IR2Vec.core import *
 
 import pathlib as pl
 import os, io
+import asyncio
+import concurrent.futures
+import functools
 
 __version__ = getVersion()
 __copyright__ = "Copyright The Contributors of IR2Vec"
 __license__ = "Apache License v2.0 with LLVM Exceptions"
+
+
+def embed_many_async(paths, mode, level, dim=300, threads=1, executor=None):
+    """Runs embed_many on an executor of the running event loop, and returns
+    the future of its result. embed_many releases the GIL, so the loop keeps
+    running while the files are embedded."""
+    loop = asyncio.get_running_loop()
+    return loop.run_in_executor(
+        executor, functools.partial(embed_many, paths, mode, level, dim, threads)
+    )
+
+
+def iter_embed_many(paths, mode, level, dim=300, threads=1, chunk_size=64):
+    """Yields the result of embed_many for each path, in order. Files are
+    embedded in chunks of chunk_size, the next chunk in the background while
+    the results of the current one are consumed."""
+    paths = list(paths)
+    chunks = [paths[i : i + chunk_size] for i in range(0, len(paths), chunk_size)]
+    with concurrent.futures.ThreadPoolExecutor(max_workers=1) as executor:
+        submit = lambda chunk: executor.submit(
+            embed_many, chunk, mode, level, dim, threads
+        )
+        pending = submit(chunks[0]) if chunks else None
+        for k in range(len(chunks)):
+            results = pending.result()
+            pending = submit(chunks[k + 1]) if k + 1 < len(chunks) else None
+            yield from results
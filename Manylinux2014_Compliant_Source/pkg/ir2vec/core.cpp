@@ -8,11 +8,15 @@
 #include "utils.h"
 #include "version.h"
 #include <Python.h>
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "llvm/ADT/APSInt.h"
@@ -65,9 +69,164 @@ bool fileNotValid(const char *filename) {
   return false;
 }
 
+// Sets a ValueError unless a seed vocabulary of dimension dim is built in.
+// The check comes before any encoding, as the exception the vocabulary
+// factory throws would terminate the interpreter in a worker thread
+bool dimNotValid(unsigned dim) {
+  try {
+    IR2Vec::VocabularyFactory::createVocabulary(dim);
+  } catch (const std::invalid_argument &) {
+    PyErr_Format(PyExc_ValueError,
+                 "Invalid dimension %u: no seed vocabulary of this dimension",
+                 dim);
+    return true;
+  }
+  return false;
+}
+
+// Vectors handed to Python, packed in a row-major array of one or two
+// dimensions. The object exposes the array through the buffer protocol, so
+// that the NumPy arrays returned are views of data, which it keeps alive.
+// The views are read-only, as the arrays of a handler share their data.
+typedef struct {
+  PyObject_HEAD std::shared_ptr<std::vector<double>> *data;
+  int ndim;
+  Py_ssize_t shape[2];
+  Py_ssize_t strides[2];
+} IR2VecArrayObject;
+
+static int getArrayBuffer(IR2VecArrayObject *self, Py_buffer *view,
+                          int flags) {
+  if (flags & PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "IR2Vec arrays are read-only");
+    return -1;
+  }
+  auto &data = **self->data;
+  // Empty arrays still need a valid pointer
+  static double empty;
+  view->obj = (PyObject *)self;
+  view->buf = data.empty() ? &empty : data.data();
+  view->len = data.size() * sizeof(double);
+  view->readonly = 1;
+  view->itemsize = sizeof(double);
+  view->format = (flags & PyBUF_FORMAT) ? (char *)"d" : nullptr;
+  view->ndim = self->ndim;
+  view->shape = (flags & PyBUF_ND) ? self->shape : nullptr;
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides
+                                                           : nullptr;
+  view->suboffsets = nullptr;
+  view->internal = nullptr;
+  Py_INCREF(self);
+  return 0;
+}
+
+static void deallocArray(IR2VecArrayObject *self) {
+  delete self->data;
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyBufferProcs IR2VecArrayBufferProcs = {
+    (getbufferproc)getArrayBuffer,
+    nullptr,
+};
+
+static PyTypeObject IR2VecArrayType = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "IR2Vec.core.IR2VecArray",
+    .tp_basicsize = sizeof(IR2VecArrayObject),
+    .tp_dealloc = (destructor)deallocArray,
+    .tp_as_buffer = &IR2VecArrayBufferProcs,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Vectors of IR2Vec in the buffer protocol",
+};
+
+// Calls numpy.<function>(arg)
+static PyObject *toNumPy(const char *function, PyObject *arg) {
+  PyObject *numpy = PyImport_ImportModule("numpy");
+  if (!numpy)
+    return nullptr;
+  PyObject *array = PyObject_CallMethod(numpy, function, "O", arg);
+  Py_DECREF(numpy);
+  return array;
+}
+
+// NumPy array of the given shape viewing data, without copying it
+static PyObject *createArray(std::shared_ptr<std::vector<double>> data,
+                             std::initializer_list<Py_ssize_t> shape) {
+  IR2VecArrayObject *buffer = PyObject_New(IR2VecArrayObject, &IR2VecArrayType);
+  if (!buffer)
+    return nullptr;
+  buffer->data = new std::shared_ptr<std::vector<double>>(std::move(data));
+  buffer->ndim = shape.size();
+  Py_ssize_t stride = sizeof(double);
+  for (int i = buffer->ndim - 1; i >= 0; i--) {
+    buffer->shape[i] = shape.begin()[i];
+    buffer->strides[i] = stride;
+    stride *= buffer->shape[i];
+  }
+
+  PyObject *array = toNumPy("asarray", (PyObject *)buffer);
+  Py_DECREF(buffer);
+  return array;
+}
+
+static PyObject *createArray(std::vector<double> data,
+                             std::initializer_list<Py_ssize_t> shape) {
+  return createArray(std::make_shared<std::vector<double>>(std::move(data)),
+                     shape);
+}
+
+// Takes the IR of obj: a path, "-" for the standard input, or an object
+// exposing the IR in text or bitcode through the buffer protocol, like bytes,
+// whose memory view holds without a copy until it is released with
+// PyBuffer_Release. view.obj is null for paths. Returns false with a Python
+// exception set if obj is neither
+static bool getIRInput(PyObject *obj, std::string &path, Py_buffer &view) {
+  view.obj = nullptr;
+  if (PyObject_CheckBuffer(obj)) {
+    path = "<bytes>";
+    return PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) == 0;
+  }
+
+  PyObject *fsPath = PyOS_FSPath(obj);
+  const char *str = fsPath ? PyUnicode_AsUTF8(fsPath) : nullptr;
+  if (str)
+    path = str;
+  Py_XDECREF(fsPath);
+  if (!str) {
+    PyErr_Clear();
+    PyErr_SetString(PyExc_TypeError,
+                    "IR must be a path, \"-\" or a bytes-like object");
+    return false;
+  }
+  return true;
+}
+
+// Parses the IR taken by getIRInput; sets error on failure. Does not use the
+// Python API, so that it may run without the GIL
+static std::unique_ptr<llvm::Module> parseIRInput(const std::string &path,
+                                                  const Py_buffer &view,
+                                                  llvm::LLVMContext &context,
+                                                  std::string &error) {
+  llvm::SMDiagnostic err;
+  std::unique_ptr<llvm::Module> module;
+  if (view.obj)
+    module = IR2Vec::parseIR(
+        llvm::StringRef(static_cast<const char *>(view.buf), view.len),
+        context, err, path);
+  else
+    module = llvm::parseIRFile(path, err, context);
+  if (!module) {
+    llvm::raw_string_ostream OS(error);
+    err.print(nullptr, OS, false);
+  }
+  return module;
+}
+
 // create Enum with three options : Program, Function, Instruction
 enum class OpType { Program, Function, Instruction };
 
+// Parses the file and computes its embeddings once; the getters answer from
+// the module and the embeddings, which live as long as the handler
 class IR2VecHandler {
 private:
   std::string fileName;
@@ -76,118 +235,138 @@ private:
   std::string level;
   unsigned dim;
 
+  // Destroyed in reverse order: the embeddings refer to the module, and the
+  // module to the context
+  std::unique_ptr<llvm::LLVMContext> context;
+  std::unique_ptr<llvm::Module> module;
+  std::unique_ptr<IR2Vec::Embeddings> emb;
+
+  // Vectors packed for Python on the first request, shared by the arrays
+  // returned afterwards
+  std::shared_ptr<std::vector<double>> pgmData;
+  std::shared_ptr<std::vector<double>> funcData;
+  std::shared_ptr<std::vector<double>> instData;
+  PyObject *funcNames = nullptr;
+
 public:
   IR2VecHandler(std::string fileName, std::string outputFile, std::string mode,
                 std::string level, unsigned dim)
       : fileName(fileName), outputFile(outputFile), mode(mode), level(level),
         dim(dim) {}
 
+  ~IR2VecHandler() { Py_XDECREF(funcNames); }
+
   std::string getFile() { return fileName; }
   std::string getOutputFile() { return outputFile; }
   std::string getMode() { return mode; }
   std::string getLevel() { return level; }
 
-  // Function to get Program Vector List
-  PyObject *createProgramVectorList(IR2Vec::Vector llvmPgmVec) {
-    // for PgmVector
-    PyObject *PgmList = PyList_New(0);
-    for (auto &Pgm_it : llvmPgmVec)
-      PyList_Append(PgmList, PyFloat_FromDouble(Pgm_it));
-    return PgmList;
-  }
-
-  // Function to get Function Vector Dictionary
-  PyObject *createFunctionVectorDict(
-      llvm::SmallMapVector<const llvm::Function *, IR2Vec::Vector, 16>
-          funcMap) {
-    PyObject *FuncVecDict = PyDict_New();
-
-    for (auto &Func_it : funcMap) {
-      const llvm::Function *func = Func_it.first;
-      std::string demangledName = IR2Vec::getDemagledName(func);
-      std::string actualName =
-          IR2Vec::getActualName(const_cast<llvm::Function *>(func));
-
-      PyObject *functionVector = PyList_New(0);
-      for (auto &Vec_it : Func_it.second) {
-        PyList_Append(functionVector, PyFloat_FromDouble(Vec_it));
-      }
+  // Parses the IR of the file, or of view if it is set, and computes the
+  // embeddings of all of its functions, which are written to the output file
+  // if one is given. Returns false with a Python exception set on failure
+  bool embed(const Py_buffer &view) {
+    context = std::make_unique<llvm::LLVMContext>();
+    std::string error;
+    module = parseIRInput(fileName, view, *context, error);
+    if (!module) {
+      PyErr_SetString(PyExc_ValueError, error.c_str());
+      return false;
+    }
 
-      PyObject *funcDict = PyDict_New();
-      PyDict_SetDefault(funcDict, PyUnicode_FromString("demangledName"),
-                        Py_None);
-      PyDict_SetDefault(funcDict, PyUnicode_FromString("actualName"), Py_None);
-      PyDict_SetDefault(funcDict, PyUnicode_FromString("vector"), Py_None);
+    IR2Vec::IR2VecMode ir2vecMode =
+        (this->mode == string("sym") ? IR2Vec::Symbolic : IR2Vec::FlowAware);
+    ofstream output;
+    if (!outputFile.empty())
+      output.open(outputFile, ios_base::app);
+    emb = std::make_unique<IR2Vec::Embeddings>(
+        *module, ir2vecMode, level[0], outputFile.empty() ? nullptr : &output,
+        dim);
+    return true;
+  }
 
-      PyDict_SetItemString(funcDict, "demangledName",
-                           PyUnicode_FromString(demangledName.c_str()));
-      PyDict_SetItemString(funcDict, "actualName",
-                           PyUnicode_FromString(actualName.c_str()));
-      PyDict_SetItemString(funcDict, "vector", functionVector);
+  // Program vector as a (dim,) array
+  PyObject *createProgramVectorArray() {
+    if (!pgmData)
+      pgmData = std::make_shared<std::vector<double>>(emb->getProgramVector());
+    return createArray(pgmData, {Py_ssize_t(pgmData->size())});
+  }
 
-      PyDict_SetItemString(FuncVecDict, demangledName.c_str(), funcDict);
+  // Function vectors as a tuple of the array of their demangled names and a
+  // (n_funcs, dim) array, whose rows follow the order of the names. Only the
+  // functions whose demangled or base name is funcName if one is given
+  PyObject *createFunctionVectorArrays(const std::string &funcName) {
+    PyObject *names;
+    std::shared_ptr<std::vector<double>> data;
+    if (funcName.empty() && funcNames) {
+      names = funcNames;
+      Py_INCREF(names);
+      data = funcData;
+    } else {
+      llvm::SmallVector<const llvm::Function *, 16> functions;
+      for (auto &Func_it : emb->getFunctionVecMap()) {
+        auto F = const_cast<llvm::Function *>(Func_it.first);
+        if (funcName.empty() || IR2Vec::getDemagledName(F) == funcName ||
+            IR2Vec::getActualName(F) == funcName)
+          functions.push_back(F);
+      }
 
-      Py_DECREF(funcDict);
-    }
-    return FuncVecDict;
-  }
-
-  // Function to get Instruction Vector Dictionary
-  PyObject *createInstructionVectorList(
-      llvm::SmallMapVector<const llvm::Instruction *, IR2Vec::Vector, 128>
-          llvmInstVecMap) {
-    PyObject *instructionVectorList = PyList_New(0);
-    for (auto &Inst_it : llvmInstVecMap) {
-      PyObject *instructionVector = PyList_New(0);
-      for (auto &Vec_it : Inst_it.second) {
-        PyList_Append(instructionVector, PyFloat_FromDouble(Vec_it));
+      PyObject *nameList = PyList_New(functions.size());
+      data = std::make_shared<std::vector<double>>();
+      data->reserve(functions.size() * dim);
+      Py_ssize_t i = 0;
+      for (auto F : functions) {
+        std::string demangledName = IR2Vec::getDemagledName(F);
+        PyList_SET_ITEM(nameList, i++,
+                        PyUnicode_FromString(demangledName.c_str()));
+        auto &vec = emb->getFunctionVecMap().find(F)->second;
+        data->insert(data->end(), vec.begin(), vec.end());
       }
+      names = toNumPy("array", nameList);
+      Py_DECREF(nameList);
+      if (!names)
+        return nullptr;
+      if (funcName.empty()) {
+        Py_INCREF(names);
+        funcNames = names;
+        funcData = data;
+      }
+    }
 
-      // add InstVec to instructionVector
-      PyList_Append(instructionVectorList, instructionVector);
+    PyObject *vectors =
+        createArray(data, {Py_ssize_t(data->size() / dim), Py_ssize_t(dim)});
+    if (!vectors) {
+      Py_DECREF(names);
+      return nullptr;
     }
-    return instructionVectorList;
+    return Py_BuildValue("(NN)", names, vectors);
   }
 
-  // generateEncodings
-  PyObject *generateEncodings(OpType type, std::string funcName = "") {
-    // Invokinng IR2Vec lib exposed functions
-    IR2Vec::iname = this->fileName;
-    IR2Vec::IR2VecMode ir2vecMode =
-        (this->mode == string("sym") ? IR2Vec::Symbolic : IR2Vec::FlowAware);
-    // The scope of this Module object is extremely crucial
-    std::unique_ptr<llvm::Module> Module;
-    Module = IR2Vec::getLLVMIR();
-
-    IR2Vec::Embeddings *emb = new IR2Vec::Embeddings();
-    // if output file is provided
-    if (this->outputFile != "") {
-      string outFile = this->outputFile;
-      ofstream output;
-      output.open(outFile, ios_base::app);
-      emb = std::move(new IR2Vec::Embeddings(
-          *Module, ir2vecMode, (this->level)[0], &output, this->dim, funcName));
-    } else {
-      emb = std::move(new IR2Vec::Embeddings(
-          *Module, ir2vecMode, (this->level)[0], nullptr, this->dim, funcName));
+  // Instruction vectors as a (n_insts, dim) array, in the order of the
+  // instructions in the module
+  PyObject *createInstructionVectorArray() {
+    auto &instVecMap = emb->getInstVecMap();
+    if (!instData) {
+      instData = std::make_shared<std::vector<double>>();
+      instData->reserve(instVecMap.size() * dim);
+      for (auto &It : instVecMap)
+        instData->insert(instData->end(), It.second.begin(), It.second.end());
     }
+    return createArray(instData,
+                       {Py_ssize_t(instVecMap.size()), Py_ssize_t(dim)});
+  }
 
+  PyObject *generateEncodings(OpType type, std::string funcName = "") {
     if (!emb) {
       PyErr_SetString(PyExc_TypeError, "Embedding Object not created");
-      Py_RETURN_NONE;
+      return nullptr;
     }
 
     if (type == OpType::Program) {
-      IR2Vec::Vector progVector = emb->getProgramVector();
-      return this->createProgramVectorList(progVector);
+      return this->createProgramVectorArray();
     } else if (type == OpType::Function) {
-      llvm::SmallMapVector<const llvm::Function *, IR2Vec::Vector, 16>
-          funcVecMap = emb->getFunctionVecMap();
-      return this->createFunctionVectorDict(funcVecMap);
+      return this->createFunctionVectorArrays(funcName);
     } else if (type == OpType::Instruction) {
-      llvm::SmallMapVector<const llvm::Instruction *, IR2Vec::Vector, 128>
-          instVecMap = emb->getInstVecMap();
-      return this->createInstructionVectorList(instVecMap);
+      return this->createInstructionVectorArray();
     } else {
       PyErr_SetString(PyExc_TypeError, "Invalid OpType");
       Py_RETURN_NONE;
@@ -241,10 +420,16 @@ PyMethodDef ir2vecObjMethods[] = {
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
 
+static void deallocIR2VecHandler(IR2VecHandlerObject *self) {
+  delete self->ir2vecObj;
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
 static PyTypeObject IR2VecHandlerType = {
     PyVarObject_HEAD_INIT(NULL, 0).tp_name =
         "IR2VecHandler.IR2VecHandlerObject",
     .tp_basicsize = sizeof(IR2VecHandlerObject),
+    .tp_dealloc = (destructor)deallocIR2VecHandler,
     .tp_flags = Py_TPFLAGS_DEFAULT,
     .tp_doc = "IR2VecHandlerObject",
     .tp_methods = ir2vecObjMethods,
@@ -291,18 +476,21 @@ PyObject *getFunctionVectors(PyObject *self, PyObject *args) {
   return runEncodings(args, OpType::Function);
 }
 
-IR2VecHandlerObject *createIR2VECObject(const char *filename,
+IR2VecHandlerObject *createIR2VECObject(const std::string &filename,
+                                        const Py_buffer &view,
                                         const char *output_file,
                                         const char *mode, const char *level,
                                         unsigned dim) {
   IR2VecHandler *ir2vecObj =
       new IR2VecHandler(filename, output_file, mode, level, dim);
-  if (!ir2vecObj) {
+  if (!ir2vecObj->embed(view)) {
+    delete ir2vecObj;
     return nullptr;
   }
   IR2VecHandlerObject *ir2vecHandlerObj =
       PyObject_New(IR2VecHandlerObject, &IR2VecHandlerType);
   if (!ir2vecHandlerObj) {
+    delete ir2vecObj;
     return nullptr;
   }
   ir2vecHandlerObj->ir2vecObj = ir2vecObj;
@@ -311,24 +499,19 @@ IR2VecHandlerObject *createIR2VECObject(const char *filename,
 
 PyObject *initEmbedding(PyObject *self, PyObject *args) {
   Py_Initialize();
-  const char *filename = "\0";
+  PyObject *input = nullptr;
   const char *mode = "\0";
   const char *level = "\0";
   const char *output_file = "\0";
   unsigned dim = 300;
 
-  if (!PyArg_ParseTuple(args, "sss|Is", &filename, &mode, &level, &dim,
+  if (!PyArg_ParseTuple(args, "Oss|Is", &input, &mode, &level, &dim,
                         &output_file)) {
     // raise error here
     PyErr_SetString(PyExc_TypeError, "Invalid Arguments");
     Py_RETURN_NONE;
   }
 
-  if (fileNotValid(filename)) {
-    PyErr_SetString(PyExc_TypeError, "Invalid File Path");
-    Py_RETURN_NONE;
-  }
-
   if (string(output_file).empty() == false) {
     if (fileNotValid(output_file)) {
       PyErr_SetString(PyExc_TypeError, "Invalid Output File Path");
@@ -349,17 +532,195 @@ PyObject *initEmbedding(PyObject *self, PyObject *args) {
     Py_RETURN_NONE;
   }
 
+  if (dimNotValid(dim))
+    return nullptr;
+
+  std::string filename;
+  Py_buffer view;
+  if (!getIRInput(input, filename, view))
+    return nullptr;
+  // IR in memory or on the standard input is parsed as it is
+  if (!view.obj && filename != "-" && fileNotValid(filename.c_str())) {
+    PyErr_SetString(PyExc_TypeError, "Invalid File Path");
+    Py_RETURN_NONE;
+  }
+
   IR2VecHandlerObject *ir2vecObj =
-      createIR2VECObject(filename, output_file, mode, level, dim);
+      createIR2VECObject(filename, view, output_file, mode, level, dim);
+  PyBuffer_Release(&view);
 
   if (!ir2vecObj) {
-    PyErr_SetString(PyExc_TypeError, "Embedding Object not created");
-    Py_RETURN_NONE;
+    if (!PyErr_Occurred())
+      PyErr_SetString(PyExc_TypeError, "Embedding Object not created");
+    return nullptr;
   }
 
   return (PyObject *)ir2vecObj;
 }
 
+// Embeddings of one file of embed_many, computed without the GIL
+struct EmbedManyResult {
+  std::vector<double> pgmVector;
+  std::vector<std::string> funcNames;
+  std::shared_ptr<std::vector<double>> funcVectors;
+  std::string error;
+};
+
+static void embedFile(const std::string &path, const Py_buffer &view,
+                      IR2Vec::IR2VecMode mode, char level, unsigned dim,
+                      llvm::LLVMContext &context, EmbedManyResult &result) {
+  auto module = parseIRInput(path, view, context, result.error);
+  if (!module)
+    return;
+
+  IR2Vec::Embeddings emb(*module, mode, dim);
+  if (level == 'p') {
+    result.pgmVector = std::move(emb.getProgramVector());
+    return;
+  }
+  auto &funcVecMap = emb.getFunctionVecMap();
+  result.funcVectors = std::make_shared<std::vector<double>>();
+  result.funcVectors->reserve(funcVecMap.size() * dim);
+  for (auto &It : funcVecMap) {
+    result.funcNames.push_back(IR2Vec::getDemagledName(It.first));
+    result.funcVectors->insert(result.funcVectors->end(), It.second.begin(),
+                               It.second.end());
+  }
+}
+
+// A worker of embed_many starts over with a fresh LLVMContext after these
+// many files
+static constexpr unsigned ModulesPerContext = 256;
+
+// embed_many(paths, mode, level, dim=300, threads=1) embeds the files of
+// paths, or the IR of the bytes-like objects among them, on a pool of threads,
+// each owning an LLVMContext. The GIL is released while the files are
+// embedded. Returns a (len(paths), dim) array of the
+// program vectors at level p, and a list of the (names, vectors) pairs of
+// getFunctionVectors at level f
+PyObject *embedMany(PyObject *self, PyObject *args, PyObject *kwargs) {
+  static const char *keywords[] = {"paths", "mode",    "level",
+                                   "dim",   "threads", nullptr};
+  PyObject *pathList = nullptr;
+  const char *mode = "\0";
+  const char *level = "\0";
+  unsigned dim = 300;
+  unsigned threads = 1;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oss|II", (char **)keywords,
+                                   &pathList, &mode, &level, &dim, &threads))
+    return nullptr;
+
+  if (string(mode) != string("sym") && string(mode) != string("fa")) {
+    PyErr_SetString(PyExc_TypeError,
+                    "Eroneous mode entered . Either of sym, fa should be "
+                    "specified");
+    return nullptr;
+  }
+  if (level[0] != 'p' && level[0] != 'f') {
+    PyErr_SetString(PyExc_TypeError,
+                    "Invalid level specified: Use either p or f");
+    return nullptr;
+  }
+  if (dimNotValid(dim))
+    return nullptr;
+
+  PyObject *pathSeq = PySequence_Fast(pathList, "paths must be a sequence");
+  if (!pathSeq)
+    return nullptr;
+  Py_ssize_t size = PySequence_Fast_GET_SIZE(pathSeq);
+  std::vector<std::string> paths(size);
+  // Views of the bytes-like objects, held by the sequence until released
+  std::vector<Py_buffer> views(size);
+  auto releaseViews = [&]() {
+    for (auto &view : views)
+      if (view.obj)
+        PyBuffer_Release(&view);
+  };
+  for (Py_ssize_t i = 0; i < size; i++) {
+    views[i].obj = nullptr;
+    if (!getIRInput(PySequence_Fast_GET_ITEM(pathSeq, i), paths[i],
+                    views[i])) {
+      releaseViews();
+      Py_DECREF(pathSeq);
+      return nullptr;
+    }
+  }
+
+  IR2Vec::IR2VecMode ir2vecMode =
+      (string(mode) == string("sym") ? IR2Vec::Symbolic : IR2Vec::FlowAware);
+  std::vector<EmbedManyResult> results(paths.size());
+  Py_BEGIN_ALLOW_THREADS
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    std::unique_ptr<llvm::LLVMContext> context;
+    unsigned parsed = 0;
+    for (size_t i; (i = next++) < paths.size();) {
+      // Types and constants of parsed modules are only freed along with
+      // their context
+      if (parsed++ % ModulesPerContext == 0)
+        context = std::make_unique<llvm::LLVMContext>();
+      // Exceptions must not escape the thread, which would terminate the
+      // interpreter
+      try {
+        embedFile(paths[i], views[i], ir2vecMode, level[0], dim, *context,
+                  results[i]);
+      } catch (const std::exception &e) {
+        results[i].error = paths[i] + ": " + e.what() + "\n";
+      }
+    }
+  };
+  unsigned workers = std::max(1u, std::min<unsigned>(threads, paths.size()));
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < workers; i++)
+    pool.emplace_back(work);
+  work();
+  for (auto &t : pool)
+    t.join();
+  Py_END_ALLOW_THREADS
+  releaseViews();
+  Py_DECREF(pathSeq);
+
+  std::string errors;
+  for (size_t i = 0; i < paths.size(); i++)
+    errors += results[i].error;
+  if (!errors.empty()) {
+    PyErr_SetString(PyExc_ValueError, errors.c_str());
+    return nullptr;
+  }
+
+  if (level[0] == 'p') {
+    std::vector<double> data;
+    data.reserve(paths.size() * dim);
+    for (auto &result : results)
+      data.insert(data.end(), result.pgmVector.begin(), result.pgmVector.end());
+    return createArray(std::move(data),
+                       {Py_ssize_t(paths.size()), Py_ssize_t(dim)});
+  }
+
+  PyObject *list = PyList_New(paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+    auto &result = results[i];
+    PyObject *nameList = PyList_New(result.funcNames.size());
+    for (size_t j = 0; j < result.funcNames.size(); j++)
+      PyList_SET_ITEM(nameList, j,
+                      PyUnicode_FromString(result.funcNames[j].c_str()));
+    PyObject *names = toNumPy("array", nameList);
+    Py_DECREF(nameList);
+    PyObject *vectors =
+        names ? createArray(result.funcVectors,
+                            {Py_ssize_t(result.funcNames.size()),
+                             Py_ssize_t(dim)})
+              : nullptr;
+    if (!vectors) {
+      Py_XDECREF(names);
+      Py_DECREF(list);
+      return nullptr;
+    }
+    PyList_SET_ITEM(list, i, Py_BuildValue("(NN)", names, vectors));
+  }
+  return list;
+}
+
 PyMethodDef IR2Vec_core_Methods[] = {
     {"initEmbedding", (PyCFunction)initEmbedding, METH_VARARGS,
      "Create an Embedding Object"},
@@ -369,6 +730,9 @@ PyMethodDef IR2Vec_core_Methods[] = {
      "Get Program Vector"},
     {"getFunctionVectors", (PyCFunction)getFunctionVectors, METH_VARARGS,
      "Get Function Vectors"},
+    {"embed_many", (PyCFunction)(void (*)(void))embedMany,
+     METH_VARARGS | METH_KEYWORDS,
+     "Embed many files on a pool of threads, without holding the GIL"},
     {"getVersion", getIR2VecVersion, METH_VARARGS, "Get IR2Vec Version"},
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
@@ -389,6 +753,9 @@ PyMODINIT_FUNC PyInit_core(void) {
   if (PyType_Ready(&IR2VecHandlerType) < 0) {
     Py_RETURN_NONE;
   }
+  if (PyType_Ready(&IR2VecArrayType) < 0) {
+    Py_RETURN_NONE;
+  }
 
   Py_INCREF(&IR2VecHandlerType);
   return module;
@@ -80,5 +80,6 @@ setup(
     ],
     ext_modules=[IR2Vec_core],
     packages=["ir2vec"],
+    install_requires=["numpy"],
     include_package_data=True,
 )
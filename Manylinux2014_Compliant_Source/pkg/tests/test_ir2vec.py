@@ -5,6 +5,7 @@
 
 import pathlib as pl
 import ir2vec
+import numpy as np
 import pytest
 
 from collections import defaultdict
@@ -45,51 +46,42 @@ def read_p_file(path):
     return p_vectors
 
 
-def assert_valid_progVector(progVector):
+def assert_valid_progVector(progVector, dim=300):
     assert progVector is not None
-    assert isinstance(progVector, list)
-    assert all(isinstance(x, float) for x in progVector)
+    assert isinstance(progVector, np.ndarray)
+    assert progVector.dtype == np.float64
+    assert progVector.shape == (dim,)
     return True
 
 
-def assert_valid_instructionVectors(instVecList):
-    assert instVecList is not None
-
-    for vec in instVecList:
-        assert vec is not None
-        assert isinstance(vec, list)
-        assert all(isinstance(x, float) for x in vec)
-
+def assert_valid_instructionVectors(instVecs, dim=300):
+    assert instVecs is not None
+    assert isinstance(instVecs, np.ndarray)
+    assert instVecs.dtype == np.float64
+    assert instVecs.ndim == 2
+    assert instVecs.shape[1] == dim
+    assert instVecs.flags["C_CONTIGUOUS"]
     return True
 
 
-def assert_valid_functionVector(functionVectorMap):
-    assert functionVectorMap is not None
-
-    keys = list(functionVectorMap.keys())
-    assert len(keys) > 0
-
-    values = list(functionVectorMap.values())
-    assert len(values) > 0
+def assert_valid_functionVector(functionVectors, dim=300):
+    assert functionVectors is not None
 
-    for fun, funcObj in functionVectorMap.items():
-        assert fun is not None
+    names, vectors = functionVectors
+    assert len(names) > 0
+    assert all(isinstance(name, str) for name in names)
 
-        vec = funcObj["vector"]
-        assert vec is not None
-        assert isinstance(vec, list)
-        assert all(isinstance(x, float) for x in vec)
+    assert isinstance(vectors, np.ndarray)
+    assert vectors.dtype == np.float64
+    assert vectors.shape == (len(names), dim)
+    assert vectors.flags["C_CONTIGUOUS"]
 
-        demagName = funcObj["demangledName"]
-        assert isinstance(demagName, str)
-        assert demagName is not None
-        assert demagName == fun
+    return True
 
-        actName = funcObj["actualName"]
-        assert isinstance(actName, str)
-        assert actName is not None
 
-    return True
+def get_function_vector(functionVectors, name):
+    names, vectors = functionVectors
+    return vectors[list(names).index(name)]
 
 
 def test_fa_p():
@@ -163,32 +155,28 @@ def test_fa_f():
         initObj = ir2vec.initEmbedding(full_path, "fa", "f", 300)
         assert initObj is not None
 
-        functionVectorMap = ir2vec.getFunctionVectors(initObj)
-        assert_valid_functionVector(functionVectorMap)
-
-        functionVectorMap2 = initObj.getFunctionVectors()
-        assert_valid_functionVector(functionVectorMap2)
+        functionVectors = ir2vec.getFunctionVectors(initObj)
+        assert_valid_functionVector(functionVectors)
 
-        for fun, funcObj in functionVectorMap.items():
-            assert fun == funcObj["demangledName"]
+        functionVectors2 = initObj.getFunctionVectors()
+        assert_valid_functionVector(functionVectors2)
 
-            f_vecs[path.name.strip()][fun] = funcObj["vector"]
+        names, vectors = functionVectors
+        for fun, vec in zip(names, vectors):
+            f_vecs[path.name.strip()][fun] = vec
 
-            functionOutput1 = ir2vec.getFunctionVectors(
-                initObj,
-                funcObj["actualName"],
-            )
+            functionOutput1 = ir2vec.getFunctionVectors(initObj, fun)
             assert_valid_functionVector(functionOutput1)
 
-            functionOutput2 = initObj.getFunctionVectors(funcObj["actualName"])
+            functionOutput2 = initObj.getFunctionVectors(fun)
             assert_valid_functionVector(functionOutput2)
 
-            assert functionOutput1[fun]["vector"] == pytest.approx(
-                functionOutput2[fun]["vector"], abs=ABS_ACCURACY
+            assert get_function_vector(functionOutput1, fun) == pytest.approx(
+                get_function_vector(functionOutput2, fun), abs=ABS_ACCURACY
             )
 
-            assert funcObj["vector"] == pytest.approx(
-                functionOutput1[fun]["vector"], abs=ABS_ACCURACY
+            assert vec == pytest.approx(
+                get_function_vector(functionOutput1, fun), abs=ABS_ACCURACY
             )
 
     print(TEST_SUITE_DIR)
@@ -211,32 +199,28 @@ def test_sym_f():
         initObj = ir2vec.initEmbedding(full_path, "sym", "f")
         assert initObj is not None
 
-        functionVectorMap = ir2vec.getFunctionVectors(initObj)
-        assert_valid_functionVector(functionVectorMap)
+        functionVectors = ir2vec.getFunctionVectors(initObj)
+        assert_valid_functionVector(functionVectors)
 
-        functionVectorMap2 = initObj.getFunctionVectors()
-        assert_valid_functionVector(functionVectorMap2)
+        functionVectors2 = initObj.getFunctionVectors()
+        assert_valid_functionVector(functionVectors2)
 
-        for fun, funcObj in functionVectorMap.items():
-            assert fun == funcObj["demangledName"]
+        names, vectors = functionVectors
+        for fun, vec in zip(names, vectors):
+            f_vecs[path.name.strip()][fun] = vec
 
-            f_vecs[path.name.strip()][fun] = funcObj["vector"]
-
-            functionOutput1 = ir2vec.getFunctionVectors(
-                initObj,
-                funcObj["actualName"],
-            )
+            functionOutput1 = ir2vec.getFunctionVectors(initObj, fun)
             assert_valid_functionVector(functionOutput1)
 
-            functionOutput2 = initObj.getFunctionVectors(funcObj["actualName"])
+            functionOutput2 = initObj.getFunctionVectors(fun)
             assert_valid_functionVector(functionOutput2)
 
-            assert functionOutput1[fun]["vector"] == pytest.approx(
-                functionOutput2[fun]["vector"], abs=ABS_ACCURACY
+            assert get_function_vector(functionOutput1, fun) == pytest.approx(
+                get_function_vector(functionOutput2, fun), abs=ABS_ACCURACY
             )
 
-            assert funcObj["vector"] == pytest.approx(
-                functionOutput1[fun]["vector"], abs=ABS_ACCURACY
+            assert vec == pytest.approx(
+                get_function_vector(functionOutput1, fun), abs=ABS_ACCURACY
             )
 
     print(TEST_SUITE_DIR)
@@ -248,3 +232,50 @@ def test_sym_f():
             assert vec == pytest.approx(
                 f_vecs[pname][fname], abs=ABS_ACCURACY
             ), f"Checking {pname}: {fname}"
+
+
+def test_embed_many():
+    paths = [str((TEST_SUITE_DIR / file).resolve()).strip() for file in ll_files]
+    for mode, oracle in (("fa", "FA"), ("sym", "SYM")):
+        p_vectors = ir2vec.embed_many(paths, mode, "p", threads=4)
+        assert p_vectors.shape == (len(paths), 300)
+
+        p_vectors_oracle = read_p_file(
+            TEST_SUITE_DIR / "oracle" / f"{oracle}_{SEED_VERSION}_p" / "ir2vec.txt"
+        )
+        for idx, vec in enumerate(p_vectors_oracle):
+            assert vec == pytest.approx(p_vectors[idx], abs=ABS_ACCURACY)
+
+        f_vectors = ir2vec.embed_many(paths[:8], mode, "f", threads=4)
+        for path, functionVectors in zip(paths[:8], f_vectors):
+            assert_valid_functionVector(functionVectors)
+            names, vectors = ir2vec.initEmbedding(path, mode, "f").getFunctionVectors()
+            assert list(functionVectors[0]) == list(names)
+            assert np.array_equal(functionVectors[1], vectors)
+
+    # Dimensions without a seed vocabulary are rejected before any encoding
+    with pytest.raises(ValueError):
+        ir2vec.embed_many(paths[:4], "fa", "p", dim=64, threads=4)
+    with pytest.raises(ValueError):
+        ir2vec.initEmbedding(paths[0], "fa", "p", 64)
+
+
+def test_ir_in_memory():
+    paths = [(TEST_SUITE_DIR / file.strip()).resolve() for file in ll_files[:8]]
+    for mode in ("fa", "sym"):
+        for path in paths:
+            progVector = ir2vec.initEmbedding(str(path), mode, "p").getProgramVector()
+            inMemory = ir2vec.initEmbedding(path.read_bytes(), mode, "p")
+            assert np.array_equal(inMemory.getProgramVector(), progVector)
+
+            # A view of part of a buffer is not followed by a NUL
+            data = path.read_bytes()
+            view = memoryview(data + b"garbage")[: len(data)]
+            inView = ir2vec.initEmbedding(view, mode, "p")
+            assert np.array_equal(inView.getProgramVector(), progVector)
+
+        p_vectors = ir2vec.embed_many([path.read_bytes() for path in paths], mode, "p")
+        assert np.array_equal(p_vectors, ir2vec.embed_many(paths, mode, "p"))
+
+    with pytest.raises(ValueError):
+        ir2vec.initEmbedding(b"not IR", "fa", "p")
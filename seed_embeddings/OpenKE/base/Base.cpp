@@ -3,8 +3,11 @@
 #include "Reader.h"
 #include "Setting.h"
 #include "Test.h"
+#include <atomic>
 #include <cstdlib>
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
 extern "C" void setInPath(char *path);
 
@@ -57,8 +60,7 @@ struct Parameter {
   bool filter_flag;
 };
 
-void *getBatch(void *con) {
-  Parameter *para = (Parameter *)(con);
+void getBatch(Parameter *para) {
   INT id = para->id;
   INT *batch_h = para->batch_h;
   INT *batch_t = para->batch_t;
@@ -141,7 +143,141 @@ void *getBatch(void *con) {
       batch_y[batch] = 1;
     }
   }
-  pthread_exit(NULL);
+}
+
+/*
+============================================================
+*/
+
+// Batches are sampled by a pool of workThreads threads that lives across
+// calls of sampling. The batches are jobs of a ring: job j is held by slot
+// j % ringSize, and each worker fills its slice of every job, in order, with
+// the random seed of its id. Jobs are handed over through counters only:
+// the consumer posts a job by advancing jobsPosted, and the last worker to
+// finish a job advances jobsDone. Since every worker goes through the jobs
+// in order, jobs are done in order.
+//
+// With prefetchSlots set, the pool samples up to that many batches ahead of
+// the consumer, with the parameters of the last call, into buffers of the
+// ring; a call with the same parameters takes the oldest of them. Otherwise,
+// or when the parameters change, a batch is sampled in place while the
+// caller waits.
+
+INT prefetchSlots = 0;
+
+pthread_t *poolThreads = NULL;
+INT poolSize = 0;
+INT ringSize = 0;
+Parameter *jobs = NULL;
+std::atomic<INT> *jobRemaining = NULL;
+std::atomic<INT> jobsPosted(0);
+std::atomic<INT> jobsDone(0);
+std::atomic<bool> poolStop(false);
+
+// jobs taken by sampling, and the parameters and size of the batches
+// sampled ahead
+INT jobsTaken = 0;
+Parameter ahead;
+INT aheadCalls = 0;
+INT slotLength = 0;
+INT *slotH = NULL;
+INT *slotT = NULL;
+INT *slotR = NULL;
+REAL *slotY = NULL;
+
+// Waits for counter to reach target; false if the pool is stopped first.
+// Waiting workers spin briefly, then yield, then sleep, so that an idle pool
+// does not take the cores of the optimizer.
+bool waitFor(std::atomic<INT> &counter, INT target) {
+  for (INT spins = 0; counter.load() < target; spins++) {
+    if (poolStop.load())
+      return false;
+    if (spins < 1024)
+      sched_yield();
+    else
+      usleep(50);
+  }
+  return true;
+}
+
+void *poolWorker(void *con) {
+  INT id = (INT)(con);
+  for (INT job = 0; waitFor(jobsPosted, job + 1); job++) {
+    Parameter para = jobs[job % ringSize];
+    para.id = id;
+    getBatch(&para);
+    if (jobRemaining[job % ringSize].fetch_sub(1) == 1)
+      jobsDone.store(job + 1);
+  }
+  return NULL;
+}
+
+void postJob(Parameter &para) {
+  INT job = jobsPosted.load();
+  jobs[job % ringSize] = para;
+  jobRemaining[job % ringSize].store(poolSize);
+  jobsPosted.store(job + 1);
+}
+
+// Joins the pool, discarding the batches sampled ahead
+extern "C" void stopSampling() {
+  if (poolThreads == NULL)
+    return;
+  waitFor(jobsDone, jobsPosted.load());
+  poolStop.store(true);
+  for (INT threads = 0; threads < poolSize; threads++)
+    pthread_join(poolThreads[threads], NULL);
+  poolStop.store(false);
+  free(poolThreads);
+  free(jobs);
+  delete[] jobRemaining;
+  free(slotH);
+  free(slotT);
+  free(slotR);
+  free(slotY);
+  poolThreads = NULL;
+  slotH = slotT = slotR = NULL;
+  slotY = NULL;
+  slotLength = 0;
+  aheadCalls = 0;
+}
+
+// Number of batches sampled ahead of sampling; 0 samples each batch when it
+// is asked for. The pool must be stopped before the training set or the
+// random seeds are changed.
+extern "C" void setPrefetch(INT slots) {
+  if (slots == prefetchSlots)
+    return;
+  stopSampling();
+  prefetchSlots = slots;
+}
+
+void startSampling() {
+  poolSize = workThreads;
+  ringSize = prefetchSlots > 0 ? prefetchSlots : 1;
+  jobs = (Parameter *)calloc(ringSize, sizeof(Parameter));
+  jobRemaining = new std::atomic<INT>[ringSize];
+  jobsPosted.store(0);
+  jobsDone.store(0);
+  jobsTaken = 0;
+  poolThreads = (pthread_t *)malloc(poolSize * sizeof(pthread_t));
+  for (INT threads = 0; threads < poolSize; threads++)
+    pthread_create(&poolThreads[threads], NULL, poolWorker, (void *)threads);
+}
+
+bool sameParameters(const Parameter &a, const Parameter &b) {
+  return a.batchSize == b.batchSize && a.negRate == b.negRate &&
+         a.negRelRate == b.negRelRate && a.p == b.p &&
+         a.val_loss == b.val_loss && a.mode == b.mode &&
+         a.filter_flag == b.filter_flag;
+}
+
+// Points para to the buffers of a slot of the ring
+void useSlot(Parameter &para, INT slot) {
+  para.batch_h = slotH + slot * slotLength;
+  para.batch_t = slotT + slot * slotLength;
+  para.batch_r = slotR + slot * slotLength;
+  para.batch_y = slotY + slot * slotLength;
 }
 
 extern "C" void sampling(INT *batch_h, INT *batch_t, INT *batch_r,
@@ -149,28 +285,68 @@ extern "C" void sampling(INT *batch_h, INT *batch_t, INT *batch_r,
                          INT negRelRate = 0, INT mode = 0,
                          bool filter_flag = true, bool p = false,
                          bool val_loss = false) {
-  pthread_t *pt = (pthread_t *)malloc(workThreads * sizeof(pthread_t));
-  Parameter *para = (Parameter *)malloc(workThreads * sizeof(Parameter));
-  for (INT threads = 0; threads < workThreads; threads++) {
-    para[threads].id = threads;
-    para[threads].batch_h = batch_h;
-    para[threads].batch_t = batch_t;
-    para[threads].batch_r = batch_r;
-    para[threads].batch_y = batch_y;
-    para[threads].batchSize = batchSize;
-    para[threads].negRate = negRate;
-    para[threads].negRelRate = negRelRate;
-    para[threads].p = p;
-    para[threads].val_loss = val_loss;
-    para[threads].mode = mode;
-    para[threads].filter_flag = filter_flag;
-    pthread_create(&pt[threads], NULL, getBatch, (void *)(para + threads));
+  if (poolThreads != NULL && poolSize != workThreads)
+    stopSampling();
+  if (poolThreads == NULL)
+    startSampling();
+
+  Parameter para;
+  para.id = 0;
+  para.batch_h = batch_h;
+  para.batch_t = batch_t;
+  para.batch_r = batch_r;
+  para.batch_y = batch_y;
+  para.batchSize = batchSize;
+  para.negRate = negRate;
+  para.negRelRate = negRelRate;
+  para.p = p;
+  para.val_loss = val_loss;
+  para.mode = mode;
+  para.filter_flag = filter_flag;
+  INT length = batchSize * (1 + negRate + negRelRate);
+
+  if (aheadCalls > 0 && sameParameters(para, ahead)) {
+    aheadCalls++;
+  } else {
+    // the batches sampled ahead are of no use
+    waitFor(jobsDone, jobsPosted.load());
+    jobsTaken = jobsPosted.load();
+    ahead = para;
+    aheadCalls = 1;
   }
-  for (INT threads = 0; threads < workThreads; threads++)
-    pthread_join(pt[threads], NULL);
 
-  free(pt);
-  free(para);
+  if (jobsTaken == jobsPosted.load()) {
+    postJob(para);
+    waitFor(jobsDone, ++jobsTaken);
+  } else {
+    INT slot = jobsTaken % ringSize;
+    waitFor(jobsDone, ++jobsTaken);
+    memcpy(batch_h, slotH + slot * slotLength, length * sizeof(INT));
+    memcpy(batch_t, slotT + slot * slotLength, length * sizeof(INT));
+    memcpy(batch_r, slotR + slot * slotLength, length * sizeof(INT));
+    memcpy(batch_y, slotY + slot * slotLength, length * sizeof(REAL));
+  }
+
+  // Samples ahead once a call repeats the parameters of the one before it,
+  // refilling the ring as it is drained
+  if (prefetchSlots == 0 || aheadCalls < 2)
+    return;
+  if (length > slotLength && jobsPosted.load() == jobsTaken) {
+    free(slotH);
+    free(slotT);
+    free(slotR);
+    free(slotY);
+    slotLength = length;
+    slotH = (INT *)malloc(ringSize * slotLength * sizeof(INT));
+    slotT = (INT *)malloc(ringSize * slotLength * sizeof(INT));
+    slotR = (INT *)malloc(ringSize * slotLength * sizeof(INT));
+    slotY = (REAL *)malloc(ringSize * slotLength * sizeof(REAL));
+  }
+  while (jobsPosted.load() < jobsTaken + ringSize) {
+    Parameter next = para;
+    useSlot(next, jobsPosted.load() % ringSize);
+    postJob(next);
+  }
 }
 
 int main() {
@@ -4,8 +4,14 @@
 #include "Triple.h"
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <fcntl.h>
 #include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
 INT *freqRel, *freqEnt;
 INT *lefHead, *rigHead;
@@ -22,6 +28,197 @@ Triple *trainRel;
 INT *testLef, *testRig;
 INT *validLef, *validRig;
 
+// Training triples of train_file, or of inPath: train2id.bin if
+// ir2vec -collectIR -format=bin wrote one, else train2id.txt. The binary file
+// has the layout of TripleFileHeader of src/include/TripleIndex.h: a header of
+// 64 bytes holding the number of triples at byte 16, followed by the triples
+// in the layout of Triple.
+struct TrainFile {
+  std::string path;
+  FILE *fin;
+  bool binary;
+  INT total;
+};
+
+static_assert(sizeof(Triple) == 3 * sizeof(int64_t),
+              "train2id.bin holds triples of three int64 ids");
+
+// Opens the training triples and reads their number
+TrainFile openTrainFile() {
+  std::string path = train_file;
+  if (path == "") {
+    path = inPath + "train2id.bin";
+    FILE *bin = fopen(path.c_str(), "rb");
+    if (bin)
+      fclose(bin);
+    else
+      path = inPath + "train2id.txt";
+  }
+
+  TrainFile file;
+  file.path = path;
+  file.binary = path.size() > 4 && path.substr(path.size() - 4) == ".bin";
+  file.fin = fopen(path.c_str(), file.binary ? "rb" : "r");
+  file.total = 0;
+  if (!file.fin) {
+    printf("Cannot open %s.\n", path.c_str());
+    exit(1);
+  }
+  if (!file.binary) {
+    if (fscanf(file.fin, "%ld", &file.total) != 1) {
+      printf("Cannot read the number of triples of %s.\n", path.c_str());
+      exit(1);
+    }
+    return file;
+  }
+
+  char header[64];
+  uint64_t total;
+  if (fread(header, sizeof(header), 1, file.fin) != 1 ||
+      memcmp(header, "IR2VTRP", 8)) {
+    printf("%s is not an IR2Vec triple file.\n", path.c_str());
+    exit(1);
+  }
+  memcpy(&total, header + 16, sizeof(total));
+  file.total = total;
+  return file;
+}
+
+// Reads the triples of an open training file into list and closes it
+void readTrainTriples(TrainFile &file, Triple *list) {
+  INT tmp;
+  if (file.binary) {
+    tmp = fread(list, sizeof(Triple), file.total, file.fin);
+  } else {
+    for (INT i = 0; i < file.total; i++) {
+      tmp = fscanf(file.fin, "%ld", &list[i].h);
+      tmp = fscanf(file.fin, "%ld", &list[i].t);
+      tmp = fscanf(file.fin, "%ld", &list[i].r);
+    }
+  }
+  fclose(file.fin);
+}
+
+// Distinct triples of a train2id.bin file sorted by cmp_head, cmp_tail and
+// cmp_rel, which importTrainFiles would otherwise sort on every import. They
+// are stored next to the file in <file>.sorted, after a header of 64 bytes,
+// and mapped in place of being read. The header records the size and
+// modification time of the file they were built from, so that they are built
+// again once it changes.
+struct SortedHeader {
+  char magic[8];
+  uint64_t sourceSize;
+  int64_t sourceTime;
+  uint64_t total;
+  uint64_t reserved[4];
+};
+
+static_assert(sizeof(SortedHeader) == 64, "Sorted triples start at byte 64");
+
+// Maps a whole file read-only; returns null if it cannot be mapped
+void *mapFile(const std::string &path, size_t &size) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    size = st.st_size;
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  return data == MAP_FAILED ? NULL : data;
+}
+
+bool sameTriple(const Triple &a, const Triple &b) {
+  return a.h == b.h && a.r == b.r && a.t == b.t;
+}
+
+// Sorts the triples of a train2id.bin file and writes them to sortedPath
+bool writeSortedTriples(const std::string &path, const std::string &sortedPath,
+                        const SortedHeader &header) {
+  size_t size = 0;
+  char *data = (char *)mapFile(path, size);
+  if (!data)
+    return false;
+  uint64_t total;
+  memcpy(&total, data + 16, sizeof(total));
+  if (size < 64 + total * sizeof(Triple)) {
+    munmap(data, size);
+    return false;
+  }
+  const Triple *triples = (const Triple *)(data + 64);
+  std::vector<Triple> byHead(triples, triples + total);
+  munmap(data, size);
+
+  std::sort(byHead.begin(), byHead.end(), Triple::cmp_head);
+  byHead.erase(std::unique(byHead.begin(), byHead.end(), sameTriple),
+               byHead.end());
+  std::vector<Triple> byTail = byHead, byRel = byHead;
+  std::sort(byTail.begin(), byTail.end(), Triple::cmp_tail);
+  std::sort(byRel.begin(), byRel.end(), Triple::cmp_rel);
+
+  SortedHeader sorted = header;
+  sorted.total = byHead.size();
+  std::string tmpPath = sortedPath + ".tmp";
+  FILE *fout = fopen(tmpPath.c_str(), "wb");
+  if (!fout)
+    return false;
+  bool written = fwrite(&sorted, sizeof(sorted), 1, fout) == 1;
+  for (auto *list : {&byHead, &byTail, &byRel})
+    written &= fwrite(list->data(), sizeof(Triple), list->size(), fout) ==
+               list->size();
+  written &= fclose(fout) == 0;
+  if (!written || rename(tmpPath.c_str(), sortedPath.c_str())) {
+    remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Maps the sorted triples of a train2id.bin file into trainHead, trainTail and
+// trainRel, building them first if they are missing or out of date. Returns
+// false if they cannot be built, e.g. in a read-only directory
+bool mapSortedTriples(const TrainFile &file) {
+  struct stat st;
+  if (stat(file.path.c_str(), &st))
+    return false;
+  SortedHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "IR2VSRT", 8);
+  header.sourceSize = st.st_size;
+  header.sourceTime = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+
+  std::string sortedPath = file.path + ".sorted";
+  for (int attempt = 0; attempt < 2; attempt++) {
+    size_t size = 0;
+    char *data = (char *)mapFile(sortedPath, size);
+    if (data) {
+      SortedHeader sorted;
+      memcpy(&sorted, data, sizeof(sorted));
+      if (!memcmp(sorted.magic, header.magic, 8) &&
+          sorted.sourceSize == header.sourceSize &&
+          sorted.sourceTime == header.sourceTime &&
+          size == sizeof(sorted) + 3 * sorted.total * sizeof(Triple)) {
+        madvise(data, size, MADV_WILLNEED);
+        trainTotal = sorted.total;
+        trainHead = (Triple *)(data + sizeof(sorted));
+        trainTail = trainHead + trainTotal;
+        trainRel = trainTail + trainTotal;
+        return true;
+      }
+      munmap(data, size);
+    }
+    if (attempt == 0) {
+      printf("Sorting the triples of %s into %s.\n", file.path.c_str(),
+             sortedPath.c_str());
+      if (!writeSortedTriples(file.path, sortedPath, header))
+        return false;
+    }
+  }
+  return false;
+}
+
 extern "C" void importProb(REAL temp) {
   if (prob != NULL)
     free(prob);
@@ -70,45 +267,43 @@ extern "C" void importTrainFiles() {
   printf("The total of entities is %ld.\n", entityTotal);
   fclose(fin);
 
-  if (train_file == "")
-    fin = fopen((inPath + "train2id.txt").c_str(), "r");
-  else
-    fin = fopen(train_file.c_str(), "r");
-  tmp = fscanf(fin, "%ld", &trainTotal);
-  trainList = (Triple *)calloc(trainTotal, sizeof(Triple));
-  trainHead = (Triple *)calloc(trainTotal, sizeof(Triple));
-  trainTail = (Triple *)calloc(trainTotal, sizeof(Triple));
-  trainRel = (Triple *)calloc(trainTotal, sizeof(Triple));
+  TrainFile train = openTrainFile();
+  if (train.binary && mapSortedTriples(train)) {
+    // Distinct triples in head order, which trainHead holds
+    trainList = trainHead;
+    fclose(train.fin);
+  } else {
+    trainTotal = train.total;
+    trainList = (Triple *)calloc(trainTotal, sizeof(Triple));
+    trainHead = (Triple *)calloc(trainTotal, sizeof(Triple));
+    trainTail = (Triple *)calloc(trainTotal, sizeof(Triple));
+    trainRel = (Triple *)calloc(trainTotal, sizeof(Triple));
+    readTrainTriples(train, trainList);
+    std::sort(trainList, trainList + trainTotal, Triple::cmp_head);
+    tmp = trainTotal;
+    trainTotal = 1;
+    trainHead[0] = trainTail[0] = trainRel[0] = trainList[0];
+    for (INT i = 1; i < tmp; i++)
+      if (trainList[i].h != trainList[i - 1].h ||
+          trainList[i].r != trainList[i - 1].r ||
+          trainList[i].t != trainList[i - 1].t) {
+        trainHead[trainTotal] = trainTail[trainTotal] = trainRel[trainTotal] =
+            trainList[trainTotal] = trainList[i];
+        trainTotal++;
+      }
+
+    std::sort(trainHead, trainHead + trainTotal, Triple::cmp_head);
+    std::sort(trainTail, trainTail + trainTotal, Triple::cmp_tail);
+    std::sort(trainRel, trainRel + trainTotal, Triple::cmp_rel);
+  }
+
   freqRel = (INT *)calloc(relationTotal, sizeof(INT));
   freqEnt = (INT *)calloc(entityTotal, sizeof(INT));
   for (INT i = 0; i < trainTotal; i++) {
-    tmp = fscanf(fin, "%ld", &trainList[i].h);
-    tmp = fscanf(fin, "%ld", &trainList[i].t);
-    tmp = fscanf(fin, "%ld", &trainList[i].r);
+    freqEnt[trainList[i].t]++;
+    freqEnt[trainList[i].h]++;
+    freqRel[trainList[i].r]++;
   }
-  fclose(fin);
-  std::sort(trainList, trainList + trainTotal, Triple::cmp_head);
-  tmp = trainTotal;
-  trainTotal = 1;
-  trainHead[0] = trainTail[0] = trainRel[0] = trainList[0];
-  freqEnt[trainList[0].t] += 1;
-  freqEnt[trainList[0].h] += 1;
-  freqRel[trainList[0].r] += 1;
-  for (INT i = 1; i < tmp; i++)
-    if (trainList[i].h != trainList[i - 1].h ||
-        trainList[i].r != trainList[i - 1].r ||
-        trainList[i].t != trainList[i - 1].t) {
-      trainHead[trainTotal] = trainTail[trainTotal] = trainRel[trainTotal] =
-          trainList[trainTotal] = trainList[i];
-      trainTotal++;
-      freqEnt[trainList[i].t]++;
-      freqEnt[trainList[i].h]++;
-      freqRel[trainList[i].r]++;
-    }
-
-  std::sort(trainHead, trainHead + trainTotal, Triple::cmp_head);
-  std::sort(trainTail, trainTail + trainTotal, Triple::cmp_tail);
-  std::sort(trainRel, trainRel + trainTotal, Triple::cmp_rel);
   printf("The total of train triples is %ld.\n", trainTotal);
 
   lefHead = (INT *)calloc(entityTotal, sizeof(INT));
@@ -164,6 +359,9 @@ extern "C" void importTrainFiles() {
 Triple *testList;
 Triple *validList;
 Triple *tripleList;
+// tripleList in the order of cmp_tail, where the heads that hold with a tail
+// and relation are contiguous and sorted
+Triple *tripleTail;
 
 extern "C" void importTestFiles() {
   FILE *fin;
@@ -183,11 +381,8 @@ extern "C" void importTestFiles() {
   tmp = fscanf(fin, "%ld", &entityTotal);
   fclose(fin);
 
-  FILE *f_kb1, *f_kb2, *f_kb3;
-  if (train_file == "")
-    f_kb2 = fopen((inPath + "train2id.txt").c_str(), "r");
-  else
-    f_kb2 = fopen(train_file.c_str(), "r");
+  FILE *f_kb1, *f_kb3;
+  TrainFile train = openTrainFile();
   if (test_file == "")
     f_kb1 = fopen((inPath + "test2id.txt").c_str(), "r");
   else
@@ -197,9 +392,11 @@ extern "C" void importTestFiles() {
   else
     f_kb3 = fopen(valid_file.c_str(), "r");
   tmp = fscanf(f_kb1, "%ld", &testTotal);
-  tmp = fscanf(f_kb2, "%ld", &trainTotal);
+  // Raw count of the training triples, duplicates included; trainTotal is
+  // left to the distinct triples that trainList spans
+  INT trainRaw = train.total;
   tmp = fscanf(f_kb3, "%ld", &validTotal);
-  tripleTotal = testTotal + trainTotal + validTotal;
+  tripleTotal = testTotal + trainRaw + validTotal;
   testList = (Triple *)calloc(testTotal, sizeof(Triple));
   validList = (Triple *)calloc(validTotal, sizeof(Triple));
   tripleList = (Triple *)calloc(tripleTotal, sizeof(Triple));
@@ -209,22 +406,20 @@ extern "C" void importTestFiles() {
     tmp = fscanf(f_kb1, "%ld", &testList[i].r);
     tripleList[i] = testList[i];
   }
-  for (INT i = 0; i < trainTotal; i++) {
-    tmp = fscanf(f_kb2, "%ld", &tripleList[i + testTotal].h);
-    tmp = fscanf(f_kb2, "%ld", &tripleList[i + testTotal].t);
-    tmp = fscanf(f_kb2, "%ld", &tripleList[i + testTotal].r);
-  }
+  readTrainTriples(train, tripleList + testTotal);
   for (INT i = 0; i < validTotal; i++) {
-    tmp = fscanf(f_kb3, "%ld", &tripleList[i + testTotal + trainTotal].h);
-    tmp = fscanf(f_kb3, "%ld", &tripleList[i + testTotal + trainTotal].t);
-    tmp = fscanf(f_kb3, "%ld", &tripleList[i + testTotal + trainTotal].r);
-    validList[i] = tripleList[i + testTotal + trainTotal];
+    tmp = fscanf(f_kb3, "%ld", &tripleList[i + testTotal + trainRaw].h);
+    tmp = fscanf(f_kb3, "%ld", &tripleList[i + testTotal + trainRaw].t);
+    tmp = fscanf(f_kb3, "%ld", &tripleList[i + testTotal + trainRaw].r);
+    validList[i] = tripleList[i + testTotal + trainRaw];
   }
   fclose(f_kb1);
-  fclose(f_kb2);
   fclose(f_kb3);
 
   std::sort(tripleList, tripleList + tripleTotal, Triple::cmp_head);
+  tripleTail = (Triple *)calloc(tripleTotal, sizeof(Triple));
+  memcpy(tripleTail, tripleList, tripleTotal * sizeof(Triple));
+  std::sort(tripleTail, tripleTail + tripleTotal, Triple::cmp_tail);
   std::sort(testList, testList + testTotal, Triple::cmp_rel2);
   std::sort(validList, validList + validTotal, Triple::cmp_rel2);
   printf("The total of test triples is %ld.\n", testTotal);
@@ -3,6 +3,7 @@
 #include "Corrupt.h"
 #include "Reader.h"
 #include "Setting.h"
+#include <pthread.h>
 
 /*=====================================================================================
 link prediction
@@ -82,157 +83,243 @@ extern "C" void getRelBatch(INT *ph, INT *pt, INT *pr) {
   }
 }
 
-extern "C" void testHead(REAL *con, INT lastHead, bool type_constrain = false) {
-  INT h = testList[lastHead].h;
-  INT t = testList[lastHead].t;
-  INT r = testList[lastHead].r;
-  INT lef, rig;
-  if (type_constrain) {
-    lef = head_lef[r];
-    rig = head_rig[r];
+// Hits and ranks of the answers of link prediction, summed over test triples
+struct LinkTotals {
+  REAL tot, tot3, tot1, filter_tot, filter3_tot, filter1_tot;
+  REAL rank, filter_rank, reci_rank, filter_reci_rank;
+
+  // adds an answer with s candidates scored below it, filter_s of which do
+  // not make a known triple
+  void add(INT s, INT filter_s) {
+    if (filter_s < 10)
+      filter_tot += 1;
+    if (s < 10)
+      tot += 1;
+    if (filter_s < 3)
+      filter3_tot += 1;
+    if (s < 3)
+      tot3 += 1;
+    if (filter_s < 1)
+      filter1_tot += 1;
+    if (s < 1)
+      tot1 += 1;
+
+    filter_rank += (filter_s + 1);
+    rank += (1 + s);
+    filter_reci_rank += 1.0 / (filter_s + 1);
+    reci_rank += 1.0 / (s + 1);
   }
-  REAL minimal = con[h];
-  INT l_s = 0;
-  INT l_filter_s = 0;
-  INT l_s_constrain = 0;
-  INT l_filter_s_constrain = 0;
-
-  for (INT j = 0; j < entityTotal; j++) {
-    if (j != h) {
-      REAL value = con[j];
-      if (value < minimal) {
-        l_s += 1;
-        if (not _find(j, t, r))
-          l_filter_s += 1;
-      }
-      if (type_constrain) {
-        while (lef < rig && head_type[lef] < j)
-          lef++;
-        if (lef < rig && j == head_type[lef]) {
-          if (value < minimal) {
-            l_s_constrain += 1;
-            if (not _find(j, t, r)) {
-              l_filter_s_constrain += 1;
-            }
-          }
-        }
-      }
-    }
+};
+
+// Totals of the head and tail predictions, without and with type constraint
+struct LinkTest {
+  LinkTotals l, r, l_constrain, r_constrain;
+};
+
+void addLinkTest(const LinkTest &test) {
+  l_tot += test.l.tot;
+  l3_tot += test.l.tot3;
+  l1_tot += test.l.tot1;
+  l_filter_tot += test.l.filter_tot;
+  l3_filter_tot += test.l.filter3_tot;
+  l1_filter_tot += test.l.filter1_tot;
+  l_rank += test.l.rank;
+  l_filter_rank += test.l.filter_rank;
+  l_reci_rank += test.l.reci_rank;
+  l_filter_reci_rank += test.l.filter_reci_rank;
+
+  r_tot += test.r.tot;
+  r3_tot += test.r.tot3;
+  r1_tot += test.r.tot1;
+  r_filter_tot += test.r.filter_tot;
+  r3_filter_tot += test.r.filter3_tot;
+  r1_filter_tot += test.r.filter1_tot;
+  r_rank += test.r.rank;
+  r_filter_rank += test.r.filter_rank;
+  r_reci_rank += test.r.reci_rank;
+  r_filter_reci_rank += test.r.filter_reci_rank;
+
+  l_tot_constrain += test.l_constrain.tot;
+  l3_tot_constrain += test.l_constrain.tot3;
+  l1_tot_constrain += test.l_constrain.tot1;
+  l_filter_tot_constrain += test.l_constrain.filter_tot;
+  l3_filter_tot_constrain += test.l_constrain.filter3_tot;
+  l1_filter_tot_constrain += test.l_constrain.filter1_tot;
+  l_rank_constrain += test.l_constrain.rank;
+  l_filter_rank_constrain += test.l_constrain.filter_rank;
+  l_reci_rank_constrain += test.l_constrain.reci_rank;
+  l_filter_reci_rank_constrain += test.l_constrain.filter_reci_rank;
+
+  r_tot_constrain += test.r_constrain.tot;
+  r3_tot_constrain += test.r_constrain.tot3;
+  r1_tot_constrain += test.r_constrain.tot1;
+  r_filter_tot_constrain += test.r_constrain.filter_tot;
+  r3_filter_tot_constrain += test.r_constrain.filter3_tot;
+  r1_filter_tot_constrain += test.r_constrain.filter1_tot;
+  r_rank_constrain += test.r_constrain.rank;
+  r_filter_rank_constrain += test.r_constrain.filter_rank;
+  r_reci_rank_constrain += test.r_constrain.reci_rank;
+  r_filter_reci_rank_constrain += test.r_constrain.filter_reci_rank;
+}
+
+// Ranks the candidate answer among the entities scored by con, and adds it
+// to totals and, with type, to constrain. The candidates field of
+// known[0, knownTotal) are the sorted ids of the entities that make a known
+// triple, which the filtered rank leaves out; type[0, typeTotal) are the
+// sorted ids allowed by the type constraint. Both lists are merged with the
+// candidates scored below the answer rather than searched for each of them.
+void rankLink(const REAL *con, INT answer, const Triple *known,
+              INT knownTotal, INT Triple::*candidate, const INT *type,
+              INT typeTotal, LinkTotals &totals, LinkTotals &constrain) {
+  REAL minimal = con[answer];
+  INT s = 0;
+  for (INT j = 0; j < entityTotal; j++)
+    s += con[j] < minimal;
+
+  INT filter_s = s;
+  for (INT i = 0; i < knownTotal; i++) {
+    INT j = known[i].*candidate;
+    if (i > 0 && known[i - 1].*candidate == j)
+      continue;
+    if (con[j] < minimal)
+      filter_s -= 1;
+  }
+  totals.add(s, filter_s);
+
+  if (type == NULL)
+    return;
+  INT s_constrain = 0;
+  INT filter_s_constrain = 0;
+  INT k = 0;
+  for (INT i = 0; i < typeTotal; i++) {
+    INT j = type[i];
+    if ((i > 0 && type[i - 1] == j) || not(con[j] < minimal))
+      continue;
+    s_constrain += 1;
+    while (k < knownTotal && known[k].*candidate < j)
+      k++;
+    if (not(k < knownTotal && known[k].*candidate == j))
+      filter_s_constrain += 1;
   }
+  constrain.add(s_constrain, filter_s_constrain);
+}
+
+// Known triples with the tail and relation of a test triple
+const Triple *knownHeads(const Triple &test, INT &total) {
+  auto lessTail = [](const Triple &a, const Triple &b) {
+    return (a.t < b.t) || (a.t == b.t && a.r < b.r);
+  };
+  const Triple *lef =
+      std::lower_bound(tripleTail, tripleTail + tripleTotal, test, lessTail);
+  const Triple *rig =
+      std::upper_bound(tripleTail, tripleTail + tripleTotal, test, lessTail);
+  total = rig - lef;
+  return lef;
+}
 
-  if (l_filter_s < 10)
-    l_filter_tot += 1;
-  if (l_s < 10)
-    l_tot += 1;
-  if (l_filter_s < 3)
-    l3_filter_tot += 1;
-  if (l_s < 3)
-    l3_tot += 1;
-  if (l_filter_s < 1)
-    l1_filter_tot += 1;
-  if (l_s < 1)
-    l1_tot += 1;
-
-  l_filter_rank += (l_filter_s + 1);
-  l_rank += (1 + l_s);
-  l_filter_reci_rank += 1.0 / (l_filter_s + 1);
-  l_reci_rank += 1.0 / (l_s + 1);
+// Known triples with the head and relation of a test triple
+const Triple *knownTails(const Triple &test, INT &total) {
+  auto lessHead = [](const Triple &a, const Triple &b) {
+    return (a.h < b.h) || (a.h == b.h && a.r < b.r);
+  };
+  const Triple *lef =
+      std::lower_bound(tripleList, tripleList + tripleTotal, test, lessHead);
+  const Triple *rig =
+      std::upper_bound(tripleList, tripleList + tripleTotal, test, lessHead);
+  total = rig - lef;
+  return lef;
+}
 
+void testHeadTotals(const REAL *con, INT index, bool type_constrain,
+                    LinkTest &totals) {
+  Triple test = testList[index];
+  INT knownTotal;
+  const Triple *known = knownHeads(test, knownTotal);
+  const INT *type = NULL;
+  INT typeTotal = 0;
   if (type_constrain) {
-    if (l_filter_s_constrain < 10)
-      l_filter_tot_constrain += 1;
-    if (l_s_constrain < 10)
-      l_tot_constrain += 1;
-    if (l_filter_s_constrain < 3)
-      l3_filter_tot_constrain += 1;
-    if (l_s_constrain < 3)
-      l3_tot_constrain += 1;
-    if (l_filter_s_constrain < 1)
-      l1_filter_tot_constrain += 1;
-    if (l_s_constrain < 1)
-      l1_tot_constrain += 1;
-
-    l_filter_rank_constrain += (l_filter_s_constrain + 1);
-    l_rank_constrain += (1 + l_s_constrain);
-    l_filter_reci_rank_constrain += 1.0 / (l_filter_s_constrain + 1);
-    l_reci_rank_constrain += 1.0 / (l_s_constrain + 1);
+    type = head_type + head_lef[test.r];
+    typeTotal = head_rig[test.r] - head_lef[test.r];
   }
+  rankLink(con, test.h, known, knownTotal, &Triple::h, type, typeTotal,
+           totals.l, totals.l_constrain);
 }
 
-extern "C" void testTail(REAL *con, INT lastTail, bool type_constrain = false) {
-  INT h = testList[lastTail].h;
-  INT t = testList[lastTail].t;
-  INT r = testList[lastTail].r;
-  INT lef, rig;
+void testTailTotals(const REAL *con, INT index, bool type_constrain,
+                    LinkTest &totals) {
+  Triple test = testList[index];
+  INT knownTotal;
+  const Triple *known = knownTails(test, knownTotal);
+  const INT *type = NULL;
+  INT typeTotal = 0;
   if (type_constrain) {
-    lef = tail_lef[r];
-    rig = tail_rig[r];
-  }
-  REAL minimal = con[t];
-  INT r_s = 0;
-  INT r_filter_s = 0;
-  INT r_s_constrain = 0;
-  INT r_filter_s_constrain = 0;
-  for (INT j = 0; j < entityTotal; j++) {
-    if (j != t) {
-      REAL value = con[j];
-      if (value < minimal) {
-        r_s += 1;
-        if (not _find(h, j, r))
-          r_filter_s += 1;
-      }
-      if (type_constrain) {
-        while (lef < rig && tail_type[lef] < j)
-          lef++;
-        if (lef < rig && j == tail_type[lef]) {
-          if (value < minimal) {
-            r_s_constrain += 1;
-            if (not _find(h, j, r)) {
-              r_filter_s_constrain += 1;
-            }
-          }
-        }
-      }
-    }
+    type = tail_type + tail_lef[test.r];
+    typeTotal = tail_rig[test.r] - tail_lef[test.r];
   }
+  rankLink(con, test.t, known, knownTotal, &Triple::t, type, typeTotal,
+           totals.r, totals.r_constrain);
+}
+
+extern "C" void testHead(REAL *con, INT lastHead, bool type_constrain = false) {
+  LinkTest totals = {};
+  testHeadTotals(con, lastHead, type_constrain, totals);
+  addLinkTest(totals);
+}
 
-  if (r_filter_s < 10)
-    r_filter_tot += 1;
-  if (r_s < 10)
-    r_tot += 1;
-  if (r_filter_s < 3)
-    r3_filter_tot += 1;
-  if (r_s < 3)
-    r3_tot += 1;
-  if (r_filter_s < 1)
-    r1_filter_tot += 1;
-  if (r_s < 1)
-    r1_tot += 1;
-
-  r_filter_rank += (1 + r_filter_s);
-  r_rank += (1 + r_s);
-  r_filter_reci_rank += 1.0 / (1 + r_filter_s);
-  r_reci_rank += 1.0 / (1 + r_s);
+extern "C" void testTail(REAL *con, INT lastTail, bool type_constrain = false) {
+  LinkTest totals = {};
+  testTailTotals(con, lastTail, type_constrain, totals);
+  addLinkTest(totals);
+}
 
-  if (type_constrain) {
-    if (r_filter_s_constrain < 10)
-      r_filter_tot_constrain += 1;
-    if (r_s_constrain < 10)
-      r_tot_constrain += 1;
-    if (r_filter_s_constrain < 3)
-      r3_filter_tot_constrain += 1;
-    if (r_s_constrain < 3)
-      r3_tot_constrain += 1;
-    if (r_filter_s_constrain < 1)
-      r1_filter_tot_constrain += 1;
-    if (r_s_constrain < 1)
-      r1_tot_constrain += 1;
-
-    r_filter_rank_constrain += (1 + r_filter_s_constrain);
-    r_rank_constrain += (1 + r_s_constrain);
-    r_filter_reci_rank_constrain += 1.0 / (1 + r_filter_s_constrain);
-    r_reci_rank_constrain += 1.0 / (1 + r_s_constrain);
+struct LinkBatch {
+  INT id;
+  INT threads;
+  REAL *headCon;
+  REAL *tailCon;
+  INT *index;
+  INT total;
+  bool type_constrain;
+  LinkTest totals;
+};
+
+void *testLinkSlice(void *con) {
+  LinkBatch *batch = (LinkBatch *)(con);
+  for (INT i = batch->id; i < batch->total; i += batch->threads) {
+    testHeadTotals(batch->headCon + i * entityTotal, batch->index[i],
+                   batch->type_constrain, batch->totals);
+    testTailTotals(batch->tailCon + i * entityTotal, batch->index[i],
+                   batch->type_constrain, batch->totals);
+  }
+  return NULL;
+}
+
+// testHead and testTail for total test triples, whose entityTotal scores are
+// the rows of headCon and tailCon. The triples are split across threads,
+// which sum their totals apart.
+extern "C" void testLinkBatch(REAL *headCon, REAL *tailCon, INT *index,
+                              INT total, bool type_constrain = false,
+                              INT threads = 1) {
+  if (threads < 1)
+    threads = 1;
+  pthread_t *pt = (pthread_t *)malloc(threads * sizeof(pthread_t));
+  LinkBatch *batch = (LinkBatch *)calloc(threads, sizeof(LinkBatch));
+  for (INT id = 0; id < threads; id++) {
+    batch[id].id = id;
+    batch[id].threads = threads;
+    batch[id].headCon = headCon;
+    batch[id].tailCon = tailCon;
+    batch[id].index = index;
+    batch[id].total = total;
+    batch[id].type_constrain = type_constrain;
+    pthread_create(&pt[id], NULL, testLinkSlice, (void *)(batch + id));
+  }
+  for (INT id = 0; id < threads; id++) {
+    pthread_join(pt[id], NULL);
+    addLinkTest(batch[id].totals);
   }
+  free(pt);
+  free(batch);
 }
 
 extern "C" void testRel(REAL *con) {
@@ -0,0 +1,295 @@
+#include "Corrupt.h"
+#include "Random.h"
+#include "Reader.h"
+#include "Setting.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <pthread.h>
+#include <vector>
+
+// Trains TransE on the training triples of an index directory and writes the
+// entity embeddings as a seed embedding vocabulary, without the PyTorch stack
+// of generate_embedding.py. The model is the one of module/model/TransE.py
+// with p_norm = 1 and norm_flag = true: a triple scores the L1 norm of
+// h/|h| + r/|r| - t/|t|, and each negative triple takes the margin loss of
+// module/loss/MarginLoss.py against its positive one. Negative triples are
+// sampled as by getBatch of Base.cpp in the normal mode.
+//
+// The threads run stochastic gradient descent on the shared embeddings
+// without locks (Hogwild): each samples its share of an epoch of positive
+// triples and updates the embeddings of the triples whose pairs violate the
+// margin in place.
+
+INT dim = 300;
+INT epochs = 1000;
+REAL margin = 1;
+REAL alpha = 0.01;
+INT negRate = 22;
+INT negRelRate = 1;
+std::string outFile = "";
+
+REAL *entityVec;
+REAL *relationVec;
+double *threadLoss;
+
+// Partial sums of the kernels are kept in Lanes lanes, so that -O3 can turn
+// the loops over a vector into SIMD operations without reassociating float
+// additions itself
+const INT Lanes = 16;
+
+REAL sumLanes(const REAL *lane, REAL sum) {
+  for (INT k = 0; k < Lanes; k++)
+    sum += lane[k];
+  return sum;
+}
+
+REAL norm(const REAL *a) {
+  REAL lane[Lanes] = {0};
+  INT i = 0;
+  for (; i + Lanes <= dim; i += Lanes)
+    for (INT k = 0; k < Lanes; k++)
+      lane[k] += a[i + k] * a[i + k];
+  REAL sum = 0;
+  for (; i < dim; i++)
+    sum += a[i] * a[i];
+  // the eps of F.normalize
+  return std::max((REAL)sqrt(sumLanes(lane, sum)), (REAL)1e-12);
+}
+
+// A triple with its normalized translation d = h/|h| + r/|r| - t/|t|
+struct Scored {
+  REAL *h, *r, *t;
+  REAL nh, nr, nt;
+  REAL *d;
+};
+
+// Scores a triple into s, returning the L1 norm of its translation
+REAL score(Scored &s, INT h, INT r, INT t) {
+  s.h = entityVec + h * dim;
+  s.r = relationVec + r * dim;
+  s.t = entityVec + t * dim;
+  s.nh = norm(s.h);
+  s.nr = norm(s.r);
+  s.nt = norm(s.t);
+  REAL ih = 1 / s.nh, ir = 1 / s.nr, it = 1 / s.nt;
+  REAL lane[Lanes] = {0};
+  INT i = 0;
+  for (; i + Lanes <= dim; i += Lanes)
+    for (INT k = 0; k < Lanes; k++) {
+      REAL d = s.h[i + k] * ih + s.r[i + k] * ir - s.t[i + k] * it;
+      s.d[i + k] = d;
+      lane[k] += fabsf(d);
+    }
+  REAL sum = 0;
+  for (; i < dim; i++) {
+    s.d[i] = s.h[i] * ih + s.r[i] * ir - s.t[i] * it;
+    sum += fabsf(s.d[i]);
+  }
+  return sumLanes(lane, sum);
+}
+
+REAL sign(REAL d) { return d > 0 ? 1 : (d < 0 ? -1 : 0); }
+
+// Moves x down the gradient g = sign(d) of the score through x/|x|, which is
+// (g - (g.u) u) / |x| for u = x/|x|, with step rate
+void descend(REAL *x, REAL nx, const REAL *d, REAL rate) {
+  REAL lane[Lanes] = {0};
+  INT i = 0;
+  for (; i + Lanes <= dim; i += Lanes)
+    for (INT k = 0; k < Lanes; k++)
+      lane[k] += sign(d[i + k]) * x[i + k];
+  REAL gu = 0;
+  for (; i < dim; i++)
+    gu += sign(d[i]) * x[i];
+  gu = sumLanes(lane, gu) / nx;
+
+  REAL step = rate / nx;
+  REAL project = gu / nx;
+  for (i = 0; i < dim; i++)
+    x[i] -= step * (sign(d[i]) - project * x[i]);
+}
+
+void descendTriple(Scored &s, REAL rate) {
+  descend(s.h, s.nh, s.d, rate);
+  descend(s.r, s.nr, s.d, rate);
+  descend(s.t, s.nt, s.d, -rate);
+}
+
+void *trainSlice(void *con) {
+  INT id = (INT)(con);
+  INT lef = id * (trainTotal / workThreads);
+  INT rig = id == workThreads - 1 ? trainTotal : lef + trainTotal / workThreads;
+  std::vector<REAL> positive(dim), negative(dim);
+  Scored p, n;
+  p.d = positive.data();
+  n.d = negative.data();
+  double loss = 0;
+
+  for (INT step = lef; step < rig; step++) {
+    Triple triple = trainList[rand_max(id, trainTotal)];
+    REAL positiveScore = score(p, triple.h, triple.r, triple.t);
+    INT violated = 0;
+    for (INT times = 0; times < negRate + negRelRate; times++) {
+      Triple corrupted = triple;
+      if (times >= negRate) {
+        corrupted.r = corrupt_rel(id, triple.h, triple.t, triple.r);
+      } else {
+        REAL prob = 500;
+        if (bernFlag)
+          prob = 1000 * right_mean[triple.r] /
+                 (right_mean[triple.r] + left_mean[triple.r]);
+        if (randd(id) % 1000 < prob)
+          corrupted.t = corrupt_head(id, triple.h, triple.r);
+        else
+          corrupted.h = corrupt_tail(id, triple.t, triple.r);
+      }
+      REAL gap = margin + positiveScore -
+                 score(n, corrupted.h, corrupted.r, corrupted.t);
+      if (gap <= 0)
+        continue;
+      loss += gap;
+      violated++;
+      descendTriple(n, -alpha);
+    }
+    if (violated > 0)
+      descendTriple(p, alpha * violated);
+  }
+  threadLoss[id] = loss;
+  return NULL;
+}
+
+void initEmbeddings(REAL *vec, INT total) {
+  // xavier_uniform_ of the nn.Embedding weights of TransE.py
+  REAL bound = sqrt(6.0 / (total + dim));
+  for (INT i = 0; i < total * dim; i++)
+    vec[i] = (2 * ((randd(0) >> 11) / 9007199254740992.0) - 1) * bound;
+}
+
+// Writes a value as str() of a float rounded to 8 decimals
+void writeValue(FILE *fout, REAL value) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.8f", value);
+  INT len = strlen(buffer);
+  while (len > 0 && buffer[len - 1] == '0' && buffer[len - 2] != '.')
+    len--;
+  buffer[len] = 0;
+  fputs(buffer, fout);
+}
+
+// Writes the entity embeddings in the format of findRep of
+// generate_embedding.py, one "name:[v0, v1, ...]" line per entity in the
+// order of entity2id.txt. The build of IR2Vec skips, with a warning, the
+// entities it does not look up
+void writeVocabulary() {
+  FILE *fin;
+  if (ent_file == "")
+    fin = fopen((inPath + "entity2id.txt").c_str(), "r");
+  else
+    fin = fopen(ent_file.c_str(), "r");
+  INT total;
+  if (fin == NULL || fscanf(fin, "%ld", &total) != 1) {
+    printf("Cannot read the entities of %s\n", inPath.c_str());
+    exit(1);
+  }
+  std::vector<std::string> names(entityTotal);
+  char name[1024];
+  INT id;
+  while (fscanf(fin, "%1023s %ld", name, &id) == 2)
+    if (id >= 0 && id < entityTotal)
+      names[id] = name;
+  fclose(fin);
+
+  FILE *fout = fopen(outFile.c_str(), "w");
+  if (fout == NULL) {
+    printf("Cannot write %s\n", outFile.c_str());
+    exit(1);
+  }
+  for (INT i = 0; i < entityTotal; i++) {
+    fprintf(fout, "%s:[", names[i].c_str());
+    for (INT j = 0; j < dim; j++) {
+      if (j > 0)
+        fputs(", ", fout);
+      writeValue(fout, entityVec[i * dim + j]);
+    }
+    fputs(i + 1 < entityTotal ? "],\n" : "]", fout);
+  }
+  fclose(fout);
+  printf("Seed embedding vocabulary : %s\n", outFile.c_str());
+}
+
+INT argPos(const char *name, int argc, char **argv) {
+  for (INT a = 1; a < argc; a++)
+    if (!strcmp(name, argv[a])) {
+      if (a == argc - 1) {
+        printf("Argument missing for %s\n", name);
+        exit(1);
+      }
+      return a;
+    }
+  return -1;
+}
+
+int main(int argc, char **argv) {
+  INT i;
+  std::string indexDir = "../preprocessed/";
+  if ((i = argPos("-index_dir", argc, argv)) > 0)
+    indexDir = argv[i + 1];
+  if (indexDir.back() != '/')
+    indexDir += '/';
+  if ((i = argPos("-dim", argc, argv)) > 0)
+    dim = atol(argv[i + 1]);
+  if ((i = argPos("-epoch", argc, argv)) > 0)
+    epochs = atol(argv[i + 1]);
+  if ((i = argPos("-margin", argc, argv)) > 0)
+    margin = atof(argv[i + 1]);
+  if ((i = argPos("-alpha", argc, argv)) > 0)
+    alpha = atof(argv[i + 1]);
+  if ((i = argPos("-neg_ent", argc, argv)) > 0)
+    negRate = atol(argv[i + 1]);
+  if ((i = argPos("-neg_rel", argc, argv)) > 0)
+    negRelRate = atol(argv[i + 1]);
+  if ((i = argPos("-bern", argc, argv)) > 0)
+    setBern(atol(argv[i + 1]));
+  if ((i = argPos("-threads", argc, argv)) > 0)
+    setWorkThreads(atol(argv[i + 1]));
+  outFile = indexDir + "seedEmbeddingVocab" + std::to_string(dim) + "D.txt";
+  if ((i = argPos("-output", argc, argv)) > 0)
+    outFile = argv[i + 1];
+  if (dim < 1 || workThreads < 1) {
+    printf("-dim and -threads must be positive\n");
+    exit(1);
+  }
+
+  setInPath((char *)indexDir.c_str());
+  randReset();
+  importTrainFiles();
+
+  entityVec = (REAL *)malloc(entityTotal * dim * sizeof(REAL));
+  relationVec = (REAL *)malloc(relationTotal * dim * sizeof(REAL));
+  threadLoss = (double *)calloc(workThreads, sizeof(double));
+  initEmbeddings(entityVec, entityTotal);
+  initEmbeddings(relationVec, relationTotal);
+
+  pthread_t *pt = (pthread_t *)malloc(workThreads * sizeof(pthread_t));
+  for (INT epoch = 0; epoch < epochs; epoch++) {
+    auto start = std::chrono::steady_clock::now();
+    for (INT threads = 0; threads < workThreads; threads++)
+      pthread_create(&pt[threads], NULL, trainSlice, (void *)threads);
+    double loss = 0;
+    for (INT threads = 0; threads < workThreads; threads++) {
+      pthread_join(pt[threads], NULL);
+      loss += threadLoss[threads];
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    // the mean margin loss of the pairs of the epoch
+    printf("Epoch %ld | loss: %f | %.2fs\n", epoch,
+           loss / (trainTotal * (negRate + negRelRate)), seconds);
+  }
+  free(pt);
+
+  writeVocabulary();
+  return 0;
+}
@@ -17,13 +17,21 @@ import random
 
 
 class Tester(object):
-    def __init__(self, model=None, data_loader=None, use_gpu=True):
+    def __init__(self, model=None, data_loader=None, use_gpu=True, threads=8):
         base_file = os.path.abspath(
             os.path.join(os.path.dirname(__file__), "../release/Base.so")
         )
         self.lib = ctypes.cdll.LoadLibrary(base_file)
         self.lib.testHead.argtypes = [ctypes.c_void_p, ctypes.c_int64, ctypes.c_int64]
         self.lib.testTail.argtypes = [ctypes.c_void_p, ctypes.c_int64, ctypes.c_int64]
+        self.lib.testLinkBatch.argtypes = [
+            ctypes.c_void_p,
+            ctypes.c_void_p,
+            ctypes.c_void_p,
+            ctypes.c_int64,
+            ctypes.c_int64,
+            ctypes.c_int64,
+        ]
         self.lib.test_link_prediction.argtypes = [ctypes.c_int64]
 
         self.lib.getTestLinkMRR.argtypes = [ctypes.c_int64]
@@ -41,6 +49,10 @@ class Tester(object):
         self.model = model
         self.data_loader = data_loader
         self.use_gpu = use_gpu
+        # threads ranking the answers of link prediction, batch_size test
+        # triples at a time
+        self.threads = threads
+        self.batch_size = 256
 
         if self.use_gpu:
             self.model.cuda()
@@ -73,17 +85,31 @@ class Tester(object):
         )
 
     def random_sample(self, data_loader, sample_size):
-
-        if sample_size:
-            reservoir = []
-            for i, batch in enumerate(data_loader):
-                if i < sample_size:
-                    reservoir.append(batch)
-                else:
-                    s = int(random.random() * (i + 1))
-                    if s < sample_size:
-                        reservoir[s] = batch
-            return iter(reservoir)
+        # batches with the index of their test triple
+        if not sample_size:
+            return enumerate(data_loader)
+        reservoir = []
+        for i, batch in enumerate(data_loader):
+            if i < sample_size:
+                reservoir.append((i, batch))
+            else:
+                s = int(random.random() * (i + 1))
+                if s < sample_size:
+                    reservoir[s] = (i, batch)
+        return iter(reservoir)
+
+    def test_link_batch(self, head_scores, tail_scores, indices, type_constrain):
+        head_scores = np.ascontiguousarray(np.stack(head_scores), dtype=np.float32)
+        tail_scores = np.ascontiguousarray(np.stack(tail_scores), dtype=np.float32)
+        indices = np.array(indices, dtype=np.int64)
+        self.lib.testLinkBatch(
+            head_scores.__array_interface__["data"][0],
+            tail_scores.__array_interface__["data"][0],
+            indices.__array_interface__["data"][0],
+            len(indices),
+            type_constrain,
+            self.threads,
+        )
 
     def run_link_prediction(
         self, type_constrain=False, sample_size=None, sample_per=None
@@ -104,15 +130,16 @@ class Tester(object):
 
         training_range = tqdm(data_iterator)
 
-        for index, [data_head, data_tail] in enumerate(training_range):
-            score = self.test_one_step(data_head)
-            self.lib.testHead(
-                score.__array_interface__["data"][0], index, type_constrain
-            )
-            score = self.test_one_step(data_tail)
-            self.lib.testTail(
-                score.__array_interface__["data"][0], index, type_constrain
-            )
+        head_scores, tail_scores, indices = [], [], []
+        for index, [data_head, data_tail] in training_range:
+            head_scores.append(self.test_one_step(data_head))
+            tail_scores.append(self.test_one_step(data_tail))
+            indices.append(index)
+            if len(indices) == self.batch_size:
+                self.test_link_batch(head_scores, tail_scores, indices, type_constrain)
+                head_scores, tail_scores, indices = [], [], []
+        if indices:
+            self.test_link_batch(head_scores, tail_scores, indices, type_constrain)
         self.lib.test_link_prediction(type_constrain)
 
         mrr = self.lib.getTestLinkMRR(type_constrain)
@@ -103,9 +103,9 @@ class TestDataLoader(object):
         self.lib.getTailBatch(self.test_h_addr, self.test_t_addr, self.test_r_addr)
         res.append(
             {
-                "batch_h": self.test_h[:1],
-                "batch_t": self.test_t,
-                "batch_r": self.test_r[:1],
+                "batch_h": self.test_h[:1].copy(),
+                "batch_t": self.test_t.copy(),
+                "batch_r": self.test_r[:1].copy(),
                 "mode": "tail_batch",
             }
         )
@@ -38,6 +38,7 @@ class TrainDataLoader(object):
         filter_flag=True,
         neg_ent=1,
         neg_rel=0,
+        prefetch=4,
     ):
 
         base_file = os.path.abspath(
@@ -76,9 +77,13 @@ class TrainDataLoader(object):
         self.negative_rel = neg_rel
         self.sampling_mode = sampling_mode
         self.cross_sampling_flag = 0
+        # batches sampled by Base.so while the previous one is trained on
+        self.prefetch = prefetch
         self.read()
 
     def read(self):
+        # the sampling threads of an earlier loader read the training set
+        self.lib.stopSampling()
         if self.in_path != None:
             self.lib.setInPath(
                 ctypes.create_string_buffer(
@@ -106,6 +111,7 @@ class TrainDataLoader(object):
         self.lib.setWorkThreads(self.work_threads)
         self.lib.randReset()
         self.lib.importTrainFiles()
+        self.lib.setPrefetch(self.prefetch)
         self.relTotal = self.lib.getRelationTotal()
         self.entTotal = self.lib.getEntityTotal()
         self.tripleTotal = self.lib.getTrainTotal()
@@ -228,6 +234,10 @@ class TrainDataLoader(object):
     def set_filter_flag(self, filter):
         self.filter = filter
 
+    def set_prefetch(self, prefetch):
+        self.prefetch = prefetch
+        self.lib.setPrefetch(self.prefetch)
+
     """interfaces to get essential parameters"""
 
     def get_batch_size(self):
@@ -23,7 +23,11 @@ os.environ["CUDA_VISIBLE_DEVICES"] = "0"
 def test_files(index_dir):
     entities = os.path.join(index_dir, "entity2id.txt")
     relations = os.path.join(index_dir, "relation2id.txt")
-    train = os.path.join(index_dir, "train2id.txt")
+    # Written by ir2vec -collectIR -format bin in place of train2id.txt, and
+    # read first, as by openTrainFile of base/Reader.h
+    train = os.path.join(index_dir, "train2id.bin")
+    if not os.path.exists(train):
+        train = os.path.join(index_dir, "train2id.txt")
 
     print(entities, relations, train)
 
@@ -32,7 +36,7 @@ def test_files(index_dir):
     if not os.path.exists(relations):
         raise Exception("relation2id.txt not found")
     if not os.path.exists(train):
-        raise Exception("train2id.txt not found")
+        raise Exception("train2id.txt or train2id.bin not found")
 
 
 # TODO :: alpha, lmda, bern, opt_method
@@ -1,2 +1,3 @@
 mkdir release
 g++ ./base/Base.cpp -fPIC -shared -o ./release/Base.so -pthread -O3 -march=native
+g++ ./base/TransE.cpp -o ./release/TransE -pthread -O3 -march=native
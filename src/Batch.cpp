@@ -0,0 +1,278 @@
+//===- Batch.cpp - Encoding a corpus of IR files in one process -*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "Batch.h"
+#include "CollectIR.h"
+#include "FlowAware.h"
+#include "Symbolic.h"
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+using namespace llvm;
+using namespace IR2Vec;
+
+// Collects the .ll and .bc files under a directory in sorted order, or the
+// paths listed one per line in a file
+static std::vector<std::string> listInputs(const std::string &batchPath) {
+  namespace fs = std::filesystem;
+  std::vector<std::string> paths;
+
+  if (fs::is_directory(batchPath)) {
+    for (auto &entry : fs::recursive_directory_iterator(batchPath)) {
+      auto ext = entry.path().extension();
+      if (entry.is_regular_file() && (ext == ".ll" || ext == ".bc"))
+        paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+  }
+
+  std::ifstream list(batchPath);
+  if (!list) {
+    errs() << "Cannot open batch input " << batchPath << "\n";
+    exit(1);
+  }
+  std::string line;
+  while (std::getline(list, line)) {
+    line.erase(line.find_last_not_of(" \t\r") + 1);
+    line.erase(0, line.find_first_not_of(" \t"));
+    if (!line.empty() && line[0] != '#')
+      paths.push_back(line);
+  }
+  return paths;
+}
+
+// Reads a file of the batch, or the error that prevented it
+static BatchInput readInput(size_t index, const std::string &path) {
+  BatchInput input{index, path, nullptr, ""};
+  auto buffer = MemoryBuffer::getFile(path);
+  if (buffer)
+    input.buffer = std::move(*buffer);
+  else
+    input.error = path + ": " + buffer.getError().message() + "\n";
+  return input;
+}
+
+// Parses a file read by readInput in context, which is replaced by a fresh
+// one every ModulesPerContext modules. Returns null with error set on failure
+static std::unique_ptr<Module>
+parseInput(const BatchInput &input, std::unique_ptr<LLVMContext> &context,
+           unsigned &parsed, std::string &error) {
+  if (!context || parsed == ModulesPerContext) {
+    context = std::make_unique<LLVMContext>();
+    parsed = 0;
+  }
+  parsed++;
+
+  SMDiagnostic err;
+  auto M = parseIR(input.buffer->getMemBufferRef(), err, *context);
+  if (!M) {
+    raw_string_ostream os(error);
+    err.print(input.path.c_str(), os);
+  }
+  return M;
+}
+
+// The threads of the configuration encode files; the functions of each file
+// are encoded serially
+static Config getFileConfig(Config config) {
+  config.threads = 1;
+  return config;
+}
+
+BatchEncoder::BatchEncoder(const std::string &batchPath,
+                           const VocabularyBase &vocab, const Config &config,
+                           EmbeddingWriter *writer,
+                           const EmbeddingCache *cache)
+    : vocabulary{vocab}, config{getFileConfig(config)},
+      workers{std::max(config.threads, 1u)}, writer{writer}, cache{cache},
+      paths{listInputs(batchPath)}, inputs{2 * this->workers},
+      results{2 * this->workers}, window{8 * this->workers} {
+  for (unsigned i = 0; i < 8 * this->workers; i++)
+    window.push(0);
+}
+
+// First stage: reads the files so that I/O overlaps with encoding
+void BatchEncoder::readInputs() {
+  for (size_t i = 0; i < paths.size(); i++) {
+    char token;
+    window.pop(token);
+    inputs.push(readInput(i, paths[i]));
+  }
+  inputs.close();
+}
+
+// Second stage: parses and encodes the files on a worker
+void BatchEncoder::encodeInputs() {
+  std::unique_ptr<LLVMContext> context;
+  unsigned parsed = 0;
+
+  BatchInput input;
+  while (inputs.pop(input)) {
+    Result result{input.index, "", "", "", {}, input.error};
+    if (input.buffer) {
+      if (auto M = parseInput(input, context, parsed, result.error))
+        encode(*M, result);
+    }
+    results.push(std::move(result));
+  }
+}
+
+void BatchEncoder::encode(Module &M, Result &result) {
+  std::ostringstream o, missCount, cyclicCount;
+  auto *table = writer ? &result.table : nullptr;
+  if (fa) {
+    IR2Vec_FA FA(M, vocabulary, config);
+    FA.setEmbeddingTable(table);
+    FA.setEmbeddingCache(cache);
+    if (config.funcName.empty())
+      FA.generateFlowAwareEncodings(&o, &missCount, &cyclicCount);
+    else
+      FA.generateFlowAwareEncodingsForFunction(&o, config.funcName,
+                                               &missCount, &cyclicCount);
+  } else {
+    IR2Vec_Symbolic SYM(M, vocabulary, config);
+    SYM.setEmbeddingTable(table);
+    SYM.setEmbeddingCache(cache);
+    if (config.funcName.empty())
+      SYM.generateSymbolicEncodings(&o);
+    else
+      SYM.generateSymbolicEncodingsForFunction(&o, config.funcName);
+  }
+  result.out = o.str();
+  result.missCount = missCount.str();
+  result.cyclicCount = cyclicCount.str();
+}
+
+// Last stage runs on the calling thread: writes the results in input order
+unsigned BatchEncoder::run() {
+  std::thread reader(&BatchEncoder::readInputs, this);
+
+  std::atomic<unsigned> running{workers};
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < workers; i++)
+    pool.emplace_back([this, &running]() {
+      encodeInputs();
+      if (--running == 0)
+        results.close();
+    });
+
+  std::ofstream o, missCount, cyclicCount;
+  if (!writer)
+    o.open(oname, std::ios_base::app);
+  if (fa) {
+    missCount.open("missCount_" + oname, std::ios_base::app);
+    cyclicCount.open("cyclicCount_" + oname, std::ios_base::app);
+  }
+
+  unsigned failed = 0;
+  size_t next = 0;
+  std::map<size_t, Result> pending;
+  Result result;
+  while (results.pop(result)) {
+    pending.emplace(result.index, std::move(result));
+    for (auto It = pending.begin();
+         It != pending.end() && It->first == next;
+         It = pending.erase(It), next++) {
+      if (!It->second.error.empty()) {
+        errs() << It->second.error;
+        failed++;
+      }
+      if (writer)
+        writer->write(It->second.table);
+      else
+        o << It->second.out;
+      if (fa) {
+        missCount << It->second.missCount;
+        cyclicCount << It->second.cyclicCount;
+      }
+      window.push(0);
+    }
+  }
+
+  reader.join();
+  for (auto &t : pool)
+    t.join();
+  return failed;
+}
+
+BatchCollector::BatchCollector(const std::string &batchPath,
+                               const Config &config, TripleIndex *index)
+    : config{config}, workers{std::max(config.threads, 1u)}, index{index},
+      paths{listInputs(batchPath)}, inputs{2 * this->workers} {}
+
+// Streams the triplets of the files taken by a worker to its shard, or to the
+// index, one module at a time
+unsigned BatchCollector::collectInputs(const std::string &shard,
+                                       std::string &errors) {
+  std::ofstream out;
+  std::unique_ptr<TripleStream> triples;
+  if (index)
+    triples = std::make_unique<TripleStream>(*index);
+  else
+    out.open(shard, std::ios_base::app);
+  std::unique_ptr<LLVMContext> context;
+  unsigned parsed = 0;
+  unsigned failed = 0;
+
+  BatchInput input;
+  while (inputs.pop(input)) {
+    std::string error = input.error;
+    if (input.buffer) {
+      if (auto M = parseInput(input, context, parsed, error)) {
+        if (triples)
+          CollectIR(*M, config).generateTriplets(*triples);
+        else
+          CollectIR(*M, config).generateTriplets(out);
+      }
+    }
+    if (!error.empty()) {
+      errors += error;
+      failed++;
+    }
+  }
+  return failed;
+}
+
+unsigned BatchCollector::run(const std::string &output) {
+  std::thread reader([this]() {
+    for (size_t i = 0; i < paths.size(); i++)
+      inputs.push(readInput(i, paths[i]));
+    inputs.close();
+  });
+
+  std::vector<unsigned> failed(workers);
+  std::vector<std::string> errors(workers);
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < workers; i++) {
+    auto shard = workers == 1 ? output : output + "." + std::to_string(i);
+    pool.emplace_back([this, shard, i, &failed, &errors]() {
+      failed[i] = collectInputs(shard, errors[i]);
+    });
+  }
+
+  reader.join();
+  for (auto &t : pool)
+    t.join();
+  unsigned failedFiles = 0;
+  for (unsigned i = 0; i < workers; i++) {
+    errs() << errors[i];
+    failedFiles += failed[i];
+  }
+  return failedFiles;
+}
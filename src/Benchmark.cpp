@@ -0,0 +1,409 @@
+//===- Benchmark.cpp - Timing the encoders on the test suite ----*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+// Parses the modules of a set of suites once, then times the encoders and
+// their phases on copies of them in process, so that parsing and process
+// start-up do not blur the measurements as they do in TimeBenchmarks.py. The
+// results are written as JSON, which -baseline compares a later run against.
+
+#include "FlowAware.h"
+#include "PhaseTimer.h"
+#include "Symbolic.h"
+#include "Vocabulary.h"
+#include "version.h"
+
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <map>
+
+using namespace llvm;
+using namespace IR2Vec;
+
+cl::OptionCategory category("IR2Vec Benchmark Options");
+
+cl::list<std::string> cl_inputs(
+    cl::Positional, cl::ZeroOrMore,
+    cl::desc("Suites to time, each a .ll/.bc file or a directory of them "
+             "(default: the PE-benchmarks and sqlite3.ll of the test suite)"),
+    cl::cat(category));
+cl::opt<std::string> cl_oname("o", cl::Optional, cl::init("-"),
+                              cl::desc("Output file path of the JSON report"),
+                              cl::cat(category));
+cl::opt<std::string>
+    cl_baseline("baseline", cl::Optional, cl::init(""),
+                cl::desc("JSON report of an earlier run to compare with"),
+                cl::cat(category));
+cl::opt<unsigned> cl_warmup("warmup", cl::Optional, cl::init(1),
+                            cl::desc("Untimed runs before the repetitions"),
+                            cl::cat(category));
+cl::opt<unsigned> cl_repeat("repeat", cl::Optional, cl::init(5),
+                            cl::desc("Timed runs of each benchmark"),
+                            cl::cat(category));
+cl::opt<unsigned> cl_dim("dim", cl::Optional, cl::init(300),
+                         cl::desc("Dimension of the embeddings"),
+                         cl::cat(category));
+cl::opt<char>
+    cl_level("level", cl::Optional, cl::init('p'),
+             cl::desc("Level of encoding - p = Program; f = Function"),
+             cl::cat(category));
+cl::opt<unsigned> cl_threads(
+    "threads", cl::Optional, cl::init(1),
+    cl::desc("Number of threads to encode functions with in flow-aware mode"),
+    cl::cat(category));
+
+using Clock = std::chrono::steady_clock;
+
+static const char *phaseNames[PhaseTimes::Count] = {"reachingDefs",
+                                                    "solveInsts", "bb2Vec"};
+
+// Modules of a suite, parsed once for all the benchmarks
+struct Suite {
+  std::string name;
+  std::string path;
+  LLVMContext context;
+  std::vector<std::unique_ptr<Module>> modules;
+  uint64_t functions = 0;
+  uint64_t instructions = 0;
+};
+
+// Modules a run encodes: copies of the ones of a suite, since the flow-aware
+// encoder changes the IR it encodes, removing unreachable blocks among others
+using Modules = std::vector<std::unique_ptr<Module>>;
+
+static Modules cloneModules(const Suite &suite) {
+  Modules modules;
+  for (auto &M : suite.modules)
+    modules.push_back(CloneModule(*M));
+  return modules;
+}
+
+// Milliseconds of the repetitions of a benchmark; calls of a phase
+struct Result {
+  std::string name;
+  std::vector<double> samples;
+  uint64_t calls = 0;
+};
+
+static void fail(const std::string &path, const std::string &message) {
+  errs() << path << ": " << message << "\n";
+  exit(1);
+}
+
+static std::unique_ptr<Suite> loadSuite(const std::string &path) {
+  namespace fs = std::filesystem;
+  auto suite = std::make_unique<Suite>();
+  suite->path = path;
+  suite->name = fs::path(path).filename().stem().string();
+
+  std::vector<std::string> files;
+  if (fs::is_directory(path)) {
+    for (auto &entry : fs::recursive_directory_iterator(path)) {
+      auto ext = entry.path().extension();
+      if (entry.is_regular_file() && (ext == ".ll" || ext == ".bc"))
+        files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+  } else {
+    files.push_back(path);
+  }
+
+  for (auto &file : files) {
+    SMDiagnostic err;
+    auto M = parseIRFile(file, err, suite->context);
+    if (!M) {
+      err.print(file.c_str(), errs());
+      exit(1);
+    }
+    for (auto &F : *M)
+      if (!F.isDeclaration()) {
+        suite->functions++;
+        suite->instructions += F.getInstructionCount();
+      }
+    suite->modules.push_back(std::move(M));
+  }
+  if (suite->modules.empty())
+    fail(path, "holds no .ll or .bc files");
+  return suite;
+}
+
+static double milliseconds(Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Runs body -warmup times, then times it -repeat times, each time on a fresh
+// copy of the modules of suite made before the clock starts
+static Result measure(std::string name, const Suite &suite,
+                      const std::function<void(Modules &)> &body) {
+  for (unsigned i = 0; i < cl_warmup; i++) {
+    auto modules = cloneModules(suite);
+    body(modules);
+  }
+  Result result{std::move(name), {}};
+  for (unsigned i = 0; i < cl_repeat; i++) {
+    auto modules = cloneModules(suite);
+    auto start = Clock::now();
+    body(modules);
+    result.samples.push_back(milliseconds(Clock::now() - start));
+  }
+  return result;
+}
+
+// Runs an encoder as measure does, and returns the self times of the phases
+// it goes through, named after prefix
+static std::vector<Result>
+measurePhases(const std::string &prefix, const Suite &suite,
+              const std::function<void(Modules &, PhaseTimes *)> &encode) {
+  PhaseTimes times;
+  for (unsigned i = 0; i < cl_warmup; i++) {
+    auto modules = cloneModules(suite);
+    encode(modules, &times);
+  }
+  std::vector<Result> results(PhaseTimes::Count);
+  for (unsigned i = 0; i < cl_repeat; i++) {
+    auto modules = cloneModules(suite);
+    times.clear();
+    encode(modules, &times);
+    for (unsigned p = 0; p < PhaseTimes::Count; p++) {
+      results[p].samples.push_back(times.nanoseconds[p] / 1e6);
+      results[p].calls = times.calls[p];
+    }
+  }
+  for (unsigned p = 0; p < PhaseTimes::Count; p++)
+    results[p].name = prefix + "/" + phaseNames[p];
+  results.erase(std::remove_if(results.begin(), results.end(),
+                               [](const Result &R) { return R.calls == 0; }),
+                results.end());
+  return results;
+}
+
+static void encodeFA(Modules &modules, const VocabularyBase &vocab,
+                     const Config &config, PhaseTimes *times) {
+  for (auto &M : modules) {
+    IR2Vec_FA FA(*M, vocab, config);
+    FA.setPhaseTimes(times);
+    FA.generateFlowAwareEncodings();
+  }
+}
+
+static void encodeSym(Modules &modules, const VocabularyBase &vocab,
+                      const Config &config, PhaseTimes *times) {
+  for (auto &M : modules) {
+    IR2Vec_Symbolic SYM(*M, vocab, config);
+    SYM.setPhaseTimes(times);
+    SYM.generateSymbolicEncodings();
+  }
+}
+
+// Looks up the opcode and type rows of every instruction, as getValue of the
+// encoders does, without their arithmetic
+static void lookupVocabulary(Modules &modules, const VocabularyBase &vocab) {
+  double sink = 0;
+  for (auto &M : modules)
+    for (auto &F : *M)
+      for (auto &I : instructions(F)) {
+        unsigned opcode = getOpcodeEntity(I.getOpcode());
+        unsigned type = getTypeEntity(I.getType());
+        if (vocab.hasEntity(opcode))
+          sink += vocab.getRow(opcode)[0];
+        if (vocab.hasEntity(type))
+          sink += vocab.getRow(type)[0];
+      }
+  volatile double keep = sink;
+  (void)keep;
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const std::vector<double> &sorted, double p) {
+  size_t rank = std::ceil(p / 100 * sorted.size());
+  return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+// Medians of the benchmarks of a report, keyed by suite/benchmark
+static std::map<std::string, double> readBaseline(const std::string &path) {
+  auto buffer = MemoryBuffer::getFile(path);
+  if (!buffer)
+    fail(path, "cannot be read: " + buffer.getError().message());
+  auto report = json::parse((*buffer)->getBuffer());
+  if (!report)
+    fail(path, "is not JSON: " + toString(report.takeError()));
+
+  std::map<std::string, double> medians;
+  auto *root = report->getAsObject();
+  auto *suites = root ? root->getArray("suites") : nullptr;
+  if (!suites)
+    fail(path, "is not a report of ir2vec-bench");
+  for (auto &S : *suites) {
+    auto *suite = S.getAsObject();
+    if (!suite)
+      continue;
+    auto *benchmarks = suite->getArray("benchmarks");
+    auto name = suite->getString("name");
+    if (!benchmarks || !name)
+      continue;
+    for (auto &B : *benchmarks) {
+      auto *benchmark = B.getAsObject();
+      if (!benchmark)
+        continue;
+      auto bench = benchmark->getString("name");
+      auto p50 = benchmark->getNumber("p50");
+      if (bench && p50)
+        medians[(*name + "/" + *bench).str()] = *p50;
+    }
+  }
+  return medians;
+}
+
+int main(int argc, char **argv) {
+  cl::HideUnrelatedOptions(category);
+  cl::ParseCommandLineOptions(argc, argv);
+
+  if (cl_level != 'p' && cl_level != 'f')
+    fail("-level", "use either p or f");
+  if (cl_repeat == 0)
+    fail("-repeat", "must be positive");
+
+  Config config;
+  config.level = cl_level;
+  config.dim = cl_dim;
+  config.threads = cl_threads;
+  auto vocabulary = VocabularyFactory::createVocabulary(config.dim);
+
+  std::vector<std::string> paths(cl_inputs.begin(), cl_inputs.end());
+  if (paths.empty()) {
+    // sqlite3.ll is only there once the CMake of the test suite generated it
+    for (auto path : {IR2VEC_TEST_SUITE_DIR "/PE-benchmarks-llfiles-llvm20",
+                      IR2VEC_TEST_SUITE_DIR "/sqlite3.ll"})
+      if (std::filesystem::exists(path))
+        paths.push_back(path);
+      else
+        errs() << "[WARNING] skipping " << path << ", which does not exist\n";
+  }
+  if (paths.empty())
+    fail("ir2vec-bench", "no suites to time");
+
+  std::map<std::string, double> baseline;
+  if (!cl_baseline.empty())
+    baseline = readBaseline(cl_baseline);
+
+  std::error_code EC;
+  raw_fd_ostream out(cl_oname, EC);
+  if (EC)
+    fail(cl_oname, "cannot be opened for writing: " + EC.message());
+
+  json::OStream J(out, 2);
+  J.objectBegin();
+  J.attribute("version", IR2VEC_VERSION);
+  J.attribute("dim", config.dim);
+  J.attribute("level", std::string(1, config.level));
+  J.attribute("threads", config.threads);
+  J.attribute("warmup", cl_warmup.getValue());
+  J.attribute("repeat", cl_repeat.getValue());
+  J.attributeBegin("suites");
+  J.arrayBegin();
+
+  for (auto &path : paths) {
+    auto start = Clock::now();
+    auto suite = loadSuite(path);
+    double parse = milliseconds(Clock::now() - start);
+    errs() << suite->name << ": " << suite->modules.size() << " modules, "
+           << suite->functions << " functions, " << suite->instructions
+           << " instructions, parsed in " << format("%.1f", parse) << " ms\n";
+
+    std::vector<Result> results;
+    results.push_back(measure("fa", *suite, [&](Modules &modules) {
+      encodeFA(modules, *vocabulary, config, nullptr);
+    }));
+    for (auto &R :
+         measurePhases("fa", *suite, [&](Modules &modules, PhaseTimes *times) {
+           encodeFA(modules, *vocabulary, config, times);
+         }))
+      results.push_back(std::move(R));
+    results.push_back(measure("sym", *suite, [&](Modules &modules) {
+      encodeSym(modules, *vocabulary, config, nullptr);
+    }));
+    for (auto &R : measurePhases(
+             "sym", *suite, [&](Modules &modules, PhaseTimes *times) {
+               encodeSym(modules, *vocabulary, config, times);
+             }))
+      results.push_back(std::move(R));
+    results.push_back(measure("vocabulary", *suite, [&](Modules &modules) {
+      lookupVocabulary(modules, *vocabulary);
+    }));
+
+    J.objectBegin();
+    J.attribute("name", suite->name);
+    J.attribute("path", suite->path);
+    J.attribute("modules", uint64_t(suite->modules.size()));
+    J.attribute("functions", suite->functions);
+    J.attribute("instructions", suite->instructions);
+    J.attribute("parse", parse);
+    J.attributeBegin("benchmarks");
+    J.arrayBegin();
+
+    errs() << "  benchmark (ms)              min        p50"
+              "        p90        max   baseline\n";
+    for (auto &R : results) {
+      auto sorted = R.samples;
+      std::sort(sorted.begin(), sorted.end());
+      double mean = 0;
+      for (double sample : sorted)
+        mean += sample;
+      mean /= sorted.size();
+
+      J.objectBegin();
+      J.attribute("name", R.name);
+      if (R.calls)
+        J.attribute("calls", R.calls);
+      J.attribute("unit", "ms");
+      J.attribute("min", sorted.front());
+      J.attribute("mean", mean);
+      J.attribute("p50", percentile(sorted, 50));
+      J.attribute("p90", percentile(sorted, 90));
+      J.attribute("p99", percentile(sorted, 99));
+      J.attribute("max", sorted.back());
+      J.attributeArray("samples", [&] {
+        for (double sample : R.samples)
+          J.value(sample);
+      });
+      J.objectEnd();
+
+      errs() << format("  %-20s %10.2f %10.2f %10.2f %10.2f",
+                       R.name.c_str(), sorted.front(), percentile(sorted, 50),
+                       percentile(sorted, 90), sorted.back());
+      // Ratio of the medians; below 1 if this run is faster
+      auto It = baseline.find(suite->name + "/" + R.name);
+      if (It != baseline.end() && It->second > 0)
+        errs() << format(" %9.3fx", percentile(sorted, 50) / It->second);
+      errs() << "\n";
+    }
+
+    J.arrayEnd();
+    J.attributeEnd();
+    J.objectEnd();
+  }
+
+  J.arrayEnd();
+  J.attributeEnd();
+  J.objectEnd();
+  out << "\n";
+  return 0;
+}
@@ -20,84 +20,103 @@ using namespace llvm;
 
 void CollectIR::generateTriplets(std::ostream &out) {
   for (Function &F : M)
-    for (BasicBlock &B : F)
+    for (BasicBlock &B : F) {
       traverseBasicBlock(B);
+      if (res.size() >= BufferSize) {
+        out << res;
+        res.clear();
+      }
+    }
   out << res;
+  res.clear();
+}
+
+void CollectIR::generateTriplets(IR2Vec::TripleStream &out) {
+  SmallVector<StringRef, 8> tokens;
+  for (Function &F : M)
+    for (BasicBlock &B : F)
+      for (Instruction &I : B) {
+        getTokens(I, tokens);
+        out.add(tokens);
+      }
 }
 
 void CollectIR::traverseBasicBlock(BasicBlock &B) {
+  SmallVector<StringRef, 8> tokens;
   for (Instruction &I : B) {
-    res += "\n" + std::string(I.getOpcodeName()) + " ";
-    auto type = I.getType();
-    IR2VEC_DEBUG(I.print(outs()); outs() << "\n";);
-    IR2VEC_DEBUG(I.getType()->print(outs()); outs() << " Type\n";);
+    getTokens(I, tokens);
+    res += "\n";
+    res += tokens[0];
+    res += " ";
+    for (auto token : ArrayRef<StringRef>(tokens).drop_front()) {
+      res += " ";
+      res += token;
+      res += " ";
+    }
+  }
+}
 
-    std::string stype;
+// Opcode of I, followed by the kind of its type and of each of its operands
+void CollectIR::getTokens(Instruction &I, SmallVectorImpl<StringRef> &tokens) {
+  tokens.clear();
+  tokens.push_back(I.getOpcodeName());
+  auto type = I.getType();
+  IR2VEC_DEBUG(I.print(outs()); outs() << "\n";);
+  IR2VEC_DEBUG(I.getType()->print(outs()); outs() << " Type\n";);
 
-    if (type->isVoidTy()) {
-      stype = " voidTy ";
-      res += stype;
-    } else if (type->isFloatingPointTy()) {
-      stype = " floatTy ";
-      res += stype;
-    } else if (type->isIntegerTy()) {
-      stype = " integerTy ";
-      res += stype;
-    } else if (type->isFunctionTy()) {
-      stype = " functionTy ";
-      res += stype;
-    } else if (type->isStructTy()) {
-      stype = " structTy ";
-      res += stype;
-    } else if (type->isArrayTy()) {
-      stype = " arrayTy ";
-      res += stype;
-    } else if (type->isPointerTy()) {
-      stype = " pointerTy ";
-      res += stype;
-    } else if (type->isVectorTy()) {
-      stype = " vectorTy ";
-      res += stype;
-    } else if (type->isEmptyTy()) {
-      stype = " emptyTy ";
-      res += stype;
-    } else if (type->isLabelTy()) {
-      stype = " labelTy ";
-      res += stype;
-    } else if (type->isTokenTy()) {
-      stype = " tokenTy ";
-      res += stype;
-    } else if (type->isMetadataTy()) {
-      stype = " metadataTy ";
-      res += stype;
-    } else {
-      stype = " unknownTy ";
-      res += stype;
-    }
+  StringRef stype;
 
-    IR2VEC_DEBUG(errs() << "Type taken : " << stype << "\n";);
+  if (type->isVoidTy()) {
+    stype = "voidTy";
+  } else if (type->isFloatingPointTy()) {
+    stype = "floatTy";
+  } else if (type->isIntegerTy()) {
+    stype = "integerTy";
+  } else if (type->isFunctionTy()) {
+    stype = "functionTy";
+  } else if (type->isStructTy()) {
+    stype = "structTy";
+  } else if (type->isArrayTy()) {
+    stype = "arrayTy";
+  } else if (type->isPointerTy()) {
+    stype = "pointerTy";
+  } else if (type->isVectorTy()) {
+    stype = "vectorTy";
+  } else if (type->isEmptyTy()) {
+    stype = "emptyTy";
+  } else if (type->isLabelTy()) {
+    stype = "labelTy";
+  } else if (type->isTokenTy()) {
+    stype = "tokenTy";
+  } else if (type->isMetadataTy()) {
+    stype = "metadataTy";
+  } else {
+    stype = "unknownTy";
+  }
+  tokens.push_back(stype);
 
-    for (unsigned i = 0; i < I.getNumOperands(); i++) {
-      IR2VEC_DEBUG(I.print(outs()); outs() << "\n";);
-      IR2VEC_DEBUG(outs() << i << "\n");
-      IR2VEC_DEBUG(I.getOperand(i)->print(outs()); outs() << "\n";);
+  IR2VEC_DEBUG(errs() << "Type taken : " << stype << "\n";);
 
-      if (isa<Function>(I.getOperand(i))) {
-        res += " function ";
-        IR2VEC_DEBUG(outs() << "Function\n");
-      } else if (isa<PointerType>(I.getOperand(i)->getType())) {
-        res += " pointer ";
-        IR2VEC_DEBUG(outs() << "pointer\n");
-      } else if (isa<Constant>(I.getOperand(i))) {
-        res += " constant ";
-        IR2VEC_DEBUG(outs() << "constant\n");
-      } else if (isa<BasicBlock>(I.getOperand(i))) {
-        res += " label ";
-        IR2VEC_DEBUG(outs() << "label\n");
-      } else {
-        res += " variable ";
-        IR2VEC_DEBUG(outs() << "variable2\n");
-      }
+  for (unsigned i = 0; i < I.getNumOperands(); i++) {
+    IR2VEC_DEBUG(I.print(outs()); outs() << "\n";);
+    IR2VEC_DEBUG(outs() << i << "\n");
+    IR2VEC_DEBUG(I.getOperand(i)->print(outs()); outs() << "\n";);
+
+    if (isa<Function>(I.getOperand(i))) {
+      tokens.push_back("function");
+      IR2VEC_DEBUG(outs() << "Function\n");
+    } else if (isa<PointerType>(I.getOperand(i)->getType())) {
+      tokens.push_back("pointer");
+      IR2VEC_DEBUG(outs() << "pointer\n");
+    } else if (isa<Constant>(I.getOperand(i))) {
+      tokens.push_back("constant");
+      IR2VEC_DEBUG(outs() << "constant\n");
+    } else if (isa<BasicBlock>(I.getOperand(i))) {
+      tokens.push_back("label");
+      IR2VEC_DEBUG(outs() << "label\n");
+    } else {
+      tokens.push_back("variable");
+      IR2VEC_DEBUG(outs() << "variable2\n");
     }
   }
 }
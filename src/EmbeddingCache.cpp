@@ -0,0 +1,256 @@
+//===- EmbeddingCache.cpp - Cache of function embeddings --------*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "EmbeddingCache.h"
+#include "EmbeddingWriter.h"
+#include "utils.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
+#include <chrono>
+#include <cstring>
+
+using namespace llvm;
+using namespace IR2Vec;
+
+// Bumped whenever the encoding of a function or the entries change, so that
+// the entries of older versions are never hit
+static constexpr char cacheVersion[] = "IR2Vec embedding cache 1";
+static constexpr char entryMagic[8] = {'I', 'R', '2', 'V', 'E', 'C', 'C', 0};
+
+namespace {
+
+struct EntryHeader {
+  char magic[8];
+  uint32_t dim;
+  uint32_t missCount;
+  uint32_t cyclicCount;
+  uint32_t reserved;
+};
+
+// Feeds the structure of a function to a hash: the opcode, type and operands
+// of every instruction, with the arguments, blocks and instructions of the
+// function numbered in order. Names of local values do not matter; the ones
+// of functions and globals do, as well as whether a callee is defined.
+class FunctionHasher {
+  MD5 &Hash;
+  DenseMap<const Value *, uint64_t> numbers;
+  DenseMap<const Type *, std::string> typeNames;
+
+  void add(uint64_t value) {
+    uint8_t bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    Hash.update(ArrayRef<uint8_t>(bytes, sizeof(bytes)));
+  }
+
+  // Strings are preceded by their size, so that no two sequences of them
+  // hash the same bytes
+  void add(StringRef string) {
+    add(string.size());
+    Hash.update(string);
+  }
+
+  void addType(Type *type) {
+    auto &name = typeNames[type];
+    if (name.empty()) {
+      raw_string_ostream OS(name);
+      type->print(OS);
+      OS.flush();
+    }
+    add(name);
+  }
+
+  void addValue(const Value *V) {
+    auto It = numbers.find(V);
+    if (It != numbers.end()) {
+      add('l');
+      add(It->second);
+      return;
+    }
+
+    add('v');
+    add(V->getValueID());
+    addType(V->getType());
+    if (auto F = dyn_cast<Function>(V)) {
+      add(F->getName());
+      add(F->isDeclaration());
+    } else if (auto GV = dyn_cast<GlobalValue>(V)) {
+      add(GV->getName());
+    } else if (auto CI = dyn_cast<ConstantInt>(V)) {
+      SmallString<32> value;
+      CI->getValue().toStringUnsigned(value, 16);
+      add(value);
+    } else if (auto CF = dyn_cast<ConstantFP>(V)) {
+      SmallString<32> value;
+      CF->getValueAPF().bitcastToAPInt().toStringUnsigned(value, 16);
+      add(value);
+    } else if (auto CE = dyn_cast<ConstantExpr>(V)) {
+      add(CE->getOpcode());
+      add(CE->getNumOperands());
+      for (auto &Op : CE->operands())
+        addValue(Op);
+    }
+  }
+
+public:
+  explicit FunctionHasher(MD5 &Hash) : Hash{Hash} {}
+
+  void hash(const Function &F) {
+    add(F.getName());
+    addType(F.getFunctionType());
+
+    uint64_t next = 0;
+    for (auto &Arg : F.args())
+      numbers[&Arg] = next++;
+    for (auto &BB : F) {
+      numbers[&BB] = next++;
+      for (auto &I : BB)
+        numbers[&I] = next++;
+    }
+
+    for (auto &BB : F) {
+      add(BB.size());
+      for (auto &I : BB) {
+        add(I.getOpcode());
+        addType(I.getType());
+        if (auto Cmp = dyn_cast<CmpInst>(&I))
+          add(Cmp->getPredicate());
+        add(I.getNumOperands());
+        for (auto &Op : I.operands())
+          addValue(Op);
+      }
+    }
+  }
+};
+
+} // namespace
+
+EmbeddingCache::EmbeddingCache(const std::string &dir, char mode,
+                               const VocabularyBase &vocabulary,
+                               const Config &config, uint64_t maxSizeBytes)
+    : dir{dir}, dim{vocabulary.getDimension()}, maxSizeBytes{maxSizeBytes} {
+  // Weights are written exactly, as hexadecimal floating point
+  raw_string_ostream OS(prefix);
+  OS << cacheVersion << '\0' << mode << '\0' << dim << '\0'
+     << format("%a", config.WO) << '\0' << format("%a", config.WA) << '\0'
+     << format("%a", config.WT) << '\0' << getVocabularyHash(vocabulary)
+     << '\0';
+  OS.flush();
+}
+
+Expected<std::unique_ptr<EmbeddingCache>>
+EmbeddingCache::create(const std::string &dir, char mode,
+                       const VocabularyBase &vocabulary, const Config &config,
+                       uint64_t maxSizeBytes) {
+  if (auto EC = sys::fs::create_directories(dir))
+    return createStringError(EC, dir + ": cannot create the cache directory: " +
+                                     EC.message());
+  return std::unique_ptr<EmbeddingCache>(
+      new EmbeddingCache(dir, mode, vocabulary, config, maxSizeBytes));
+}
+
+EmbeddingCache::~EmbeddingCache() {
+  CachePruningPolicy policy;
+  // Entries are only evicted to keep the size of the directory under the
+  // limit, least recently used first; other processes sharing the directory
+  // skip the scan if it was done in the last minute
+  policy.Interval = std::chrono::seconds(60);
+  policy.Expiration = std::chrono::seconds(0);
+  policy.MaxSizeBytes = maxSizeBytes;
+  pruneCache(dir, policy);
+}
+
+// Files are named after the prefix that the pruning of LLVM expects
+std::string EmbeddingCache::getPath(const std::string &key) const {
+  return dir + "/llvmcache-" + key;
+}
+
+std::string EmbeddingCache::getKey(const Function &F) const {
+  MD5 Hash;
+  Hash.update(prefix);
+  FunctionHasher(Hash).hash(F);
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  return Result.digest().str().str();
+}
+
+bool EmbeddingCache::lookup(const std::string &key, Entry &entry) const {
+  auto path = getPath(key);
+  int FD;
+  if (sys::fs::openFileForRead(path, FD))
+    return false;
+  auto buffer = MemoryBuffer::getOpenFile(sys::fs::convertFDToNativeFile(FD),
+                                          path, -1, false);
+  // Marks the entry as recently used for the pruning
+  sys::fs::setLastAccessAndModificationTime(FD,
+                                            std::chrono::system_clock::now());
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  if (!buffer)
+    return false;
+
+  auto data = (*buffer)->getBuffer();
+  EntryHeader header;
+  if (data.size() != sizeof(header) + dim * sizeof(double))
+    return false;
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (std::memcmp(header.magic, entryMagic, sizeof(entryMagic)) ||
+      header.dim != dim)
+    return false;
+
+  entry.vector.resize(dim);
+  std::memcpy(entry.vector.data(), data.data() + sizeof(header),
+              dim * sizeof(double));
+  entry.missCount = header.missCount;
+  entry.cyclicCount = header.cyclicCount;
+  return true;
+}
+
+// A failure to write an entry only costs a recomputation later, so it is not
+// reported
+void EmbeddingCache::insert(const std::string &key, const Entry &entry) const {
+  assert(entry.vector.size() == dim && "Vector of another dimension");
+  auto temp = sys::fs::TempFile::create(dir + "/llvmcache-%%%%%%%%%%%%.tmp");
+  if (!temp) {
+    consumeError(temp.takeError());
+    return;
+  }
+
+  EntryHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, entryMagic, sizeof(entryMagic));
+  header.dim = dim;
+  header.missCount = entry.missCount;
+  header.cyclicCount = entry.cyclicCount;
+
+  bool written;
+  {
+    raw_fd_ostream OS(temp->FD, /*shouldClose=*/false);
+    OS.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    OS.write(reinterpret_cast<const char *>(entry.vector.data()),
+             dim * sizeof(double));
+    OS.flush();
+    written = !OS.has_error();
+    OS.clear_error();
+  }
+
+  // The rename replaces an entry written concurrently for the same key,
+  // which has the same contents
+  if (!written)
+    consumeError(temp->discard());
+  else
+    consumeError(temp->keep(getPath(key)));
+}
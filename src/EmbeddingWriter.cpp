@@ -0,0 +1,392 @@
+//===- EmbeddingWriter.cpp - Binary output of embeddings --------*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "EmbeddingWriter.h"
+#include "utils.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/SwapByteOrder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+using namespace llvm;
+using namespace IR2Vec;
+
+static constexpr char binaryMagic[8] = {'I', 'R', '2', 'V', 'E', 'C', 'B', 0};
+static constexpr char npyMagic[6] = {'\x93', 'N', 'U', 'M', 'P', 'Y'};
+// Size of the .npy preamble and header, which is rewritten on close
+static constexpr uint64_t npyHeaderSize = 128;
+
+static uint64_t alignTo64(uint64_t offset) { return (offset + 63) & ~63ull; }
+
+// The files are little-endian whatever the byte order of the host; swapping
+// converts a value both ways
+template <typename T> static T littleEndian(T value) {
+  return support::endian::byte_swap<T, llvm::endianness::little>(value);
+}
+
+template <typename T>
+static void writeLittleEndian(std::ofstream &out, const T *data, size_t count) {
+  if (!sys::IsBigEndianHost) {
+    out.write(reinterpret_cast<const char *>(data), count * sizeof(T));
+    return;
+  }
+  std::vector<T> swapped(data, data + count);
+  for (auto &value : swapped)
+    value = littleEndian(value);
+  out.write(reinterpret_cast<const char *>(swapped.data()),
+            swapped.size() * sizeof(T));
+}
+
+template <typename T>
+static void readLittleEndian(std::ifstream &in, T *data, size_t count) {
+  in.read(reinterpret_cast<char *>(data), count * sizeof(T));
+  if (sys::IsBigEndianHost)
+    for (size_t i = 0; i < count; i++)
+      data[i] = littleEndian(data[i]);
+}
+
+// Converts the numeric fields of header between host and file byte order
+static BinaryHeader swapHeader(BinaryHeader header) {
+  if (!sys::IsBigEndianHost)
+    return header;
+  header.version = littleEndian(header.version);
+  header.dim = littleEndian(header.dim);
+  header.rows = littleEndian(header.rows);
+  header.WO = littleEndian(header.WO);
+  header.WA = littleEndian(header.WA);
+  header.WT = littleEndian(header.WT);
+  header.vocabularyHash = littleEndian(header.vocabularyHash);
+  header.matrixOffset = littleEndian(header.matrixOffset);
+  header.labelsOffset = littleEndian(header.labelsOffset);
+  header.keyOffsetsOffset = littleEndian(header.keyOffsetsOffset);
+  header.keysOffset = littleEndian(header.keysOffset);
+  header.fileSize = littleEndian(header.fileSize);
+  return header;
+}
+
+static Error fail(const std::string &path, const std::string &message) {
+  return createStringError(inconvertibleErrorCode(), path + ": " + message);
+}
+
+// Keys are escaped in the .keys file, so that the tab before the label and
+// the newline after it are the only ones of a line
+static std::string escapeKey(const std::string &key) {
+  std::string escaped;
+  for (char c : key) {
+    if (c == '\\')
+      escaped += "\\\\";
+    else if (c == '\t')
+      escaped += "\\t";
+    else if (c == '\n')
+      escaped += "\\n";
+    else
+      escaped += c;
+  }
+  return escaped;
+}
+
+static bool unescapeKey(StringRef escaped, std::string &key) {
+  key.clear();
+  for (size_t i = 0; i < escaped.size(); i++) {
+    if (escaped[i] != '\\') {
+      key += escaped[i];
+      continue;
+    }
+    if (++i == escaped.size())
+      return false;
+    if (escaped[i] == '\\')
+      key += '\\';
+    else if (escaped[i] == 't')
+      key += '\t';
+    else if (escaped[i] == 'n')
+      key += '\n';
+    else
+      return false;
+  }
+  return true;
+}
+
+uint64_t IR2Vec::getVocabularyHash(const VocabularyBase &vocabulary) {
+  auto bytes = reinterpret_cast<const unsigned char *>(vocabulary.getRow(0));
+  size_t size = sizeof(double) * NUM_VOCAB_ENTITIES * vocabulary.getDimension();
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+EmbeddingWriter::EmbeddingWriter(const std::string &path, OutputFormat format,
+                                 char mode, const VocabularyBase &vocabulary,
+                                 const Config &config, bool singlePrecision)
+    : path{path}, tmpPath{path + ".tmp"}, format{format} {
+  assert(format != OutputFormat::Text && "Text output is written by engines");
+
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+  header.version = 1;
+  header.dim = vocabulary.getDimension();
+  header.mode = mode;
+  header.level = config.level;
+  header.elementSize = singlePrecision ? sizeof(float) : sizeof(double);
+  header.WO = config.WO;
+  header.WA = config.WA;
+  header.WT = config.WT;
+  header.vocabularyHash = getVocabularyHash(vocabulary);
+  header.matrixOffset = format == OutputFormat::Bin
+                            ? alignTo64(sizeof(BinaryHeader))
+                            : npyHeaderSize;
+}
+
+Expected<std::unique_ptr<EmbeddingWriter>>
+EmbeddingWriter::create(const std::string &path, OutputFormat format,
+                        char mode, const VocabularyBase &vocabulary,
+                        const Config &config, bool singlePrecision) {
+  std::unique_ptr<EmbeddingWriter> writer(new EmbeddingWriter(
+      path, format, mode, vocabulary, config, singlePrecision));
+  if (auto E = writer->open())
+    return std::move(E);
+  return std::move(writer);
+}
+
+Error EmbeddingWriter::open() {
+  out.open(tmpPath, std::ios_base::binary | std::ios_base::trunc);
+  if (!out)
+    return fail(tmpPath, "cannot be opened for writing");
+  std::string placeholder(header.matrixOffset, '\0');
+  out.write(placeholder.data(), placeholder.size());
+
+  return readExisting();
+}
+
+EmbeddingWriter::~EmbeddingWriter() {
+  if (out.is_open()) {
+    out.close();
+    std::remove(tmpPath.c_str());
+    std::remove((tmpPath + ".keys").c_str());
+  }
+}
+
+// Copies the rows of an existing output file, so that new ones are appended
+// like in the text output
+Error EmbeddingWriter::readExisting() {
+  std::ifstream in(path, std::ios_base::binary);
+  if (!in || in.peek() == std::ifstream::traits_type::eof())
+    return Error::success();
+
+  unsigned long long rows = 0;
+  uint64_t dataOffset = 0;
+  if (format == OutputFormat::Bin) {
+    BinaryHeader existing;
+    bool read =
+        bool(in.read(reinterpret_cast<char *>(&existing), sizeof(existing)));
+    existing = swapHeader(existing);
+    if (!read ||
+        std::memcmp(existing.magic, binaryMagic, sizeof(binaryMagic)) ||
+        existing.version != header.version)
+      return fail(path, "is not an IR2Vec binary embedding file");
+    if (existing.dim != header.dim || existing.mode != header.mode ||
+        existing.level != header.level ||
+        existing.elementSize != header.elementSize ||
+        existing.WO != header.WO || existing.WA != header.WA ||
+        existing.WT != header.WT ||
+        existing.vocabularyHash != header.vocabularyHash)
+      return fail(path,
+                  "was written with another configuration; cannot append");
+
+    // The sections are checked to lie in order within the file before
+    // anything is allocated by their sizes
+    in.seekg(0, std::ios_base::end);
+    uint64_t fileSize = in.tellg();
+    auto fits = [](uint64_t offset, uint64_t count, uint64_t size,
+                   uint64_t end) {
+      return offset <= end && count <= (end - offset) / size;
+    };
+    rows = existing.rows;
+    if (existing.fileSize != fileSize ||
+        existing.matrixOffset < sizeof(BinaryHeader) ||
+        !fits(existing.matrixOffset, rows,
+              uint64_t(header.dim) * header.elementSize,
+              existing.labelsOffset) ||
+        !fits(existing.labelsOffset, rows, sizeof(int32_t),
+              existing.keyOffsetsOffset) ||
+        !fits(existing.keyOffsetsOffset, rows + 1, sizeof(uint64_t),
+              existing.keysOffset) ||
+        existing.keysOffset > fileSize)
+      return fail(path, "is truncated or corrupt");
+    dataOffset = existing.matrixOffset;
+
+    labels.resize(rows);
+    in.seekg(existing.labelsOffset);
+    readLittleEndian(in, labels.data(), rows);
+    std::vector<uint64_t> offsets(rows + 1);
+    in.seekg(existing.keyOffsetsOffset);
+    readLittleEndian(in, offsets.data(), offsets.size());
+    if (!in || offsets.front() != 0 ||
+        !std::is_sorted(offsets.begin(), offsets.end()) ||
+        offsets.back() > fileSize - existing.keysOffset)
+      return fail(path, "is truncated or corrupt");
+    std::string bytes(offsets.back(), '\0');
+    in.seekg(existing.keysOffset);
+    in.read(&bytes[0], bytes.size());
+    for (uint64_t i = 0; i < rows; i++)
+      keys.push_back(bytes.substr(offsets[i], offsets[i + 1] - offsets[i]));
+  } else {
+    char preamble[10];
+    in.read(preamble, sizeof(preamble));
+    uint16_t headerLength = uint8_t(preamble[8]) | uint8_t(preamble[9]) << 8;
+    std::string dict(headerLength, '\0');
+    in.read(&dict[0], dict.size());
+    if (!in || std::memcmp(preamble, npyMagic, sizeof(npyMagic)))
+      return fail(path, "is not a .npy file");
+
+    std::string descr = header.elementSize == sizeof(float) ? "'<f4'" : "'<f8'";
+    unsigned dim = 0;
+    auto shape = dict.find("'shape': (");
+    if (dict.find("'descr': " + descr) == std::string::npos ||
+        shape == std::string::npos ||
+        sscanf(dict.c_str() + shape, "'shape': (%llu, %u)", &rows, &dim) != 2 ||
+        dim != header.dim)
+      return fail(path,
+                  "has another element type or dimension; cannot append");
+    dataOffset = sizeof(preamble) + headerLength;
+
+    std::ifstream keysIn(path + ".keys");
+    std::string line, key;
+    for (size_t lineNo = 1; std::getline(keysIn, line); lineNo++) {
+      auto [escaped, label] = StringRef(line).split('\t');
+      int32_t value = -1;
+      if ((escaped.size() != line.size() && label.getAsInteger(10, value)) ||
+          !unescapeKey(escaped, key))
+        return fail(path + ".keys",
+                    "has a malformed line " + std::to_string(lineNo));
+      keys.push_back(key);
+      labels.push_back(value);
+    }
+    if (keys.size() != rows)
+      return fail(path + ".keys", "does not match the rows of " + path);
+  }
+
+  // The rows are copied as they are, already in file byte order
+  std::vector<char> buffer(1 << 20);
+  uint64_t remaining = rows * header.dim * header.elementSize;
+  in.seekg(dataOffset);
+  while (remaining && in) {
+    auto chunk = std::min<uint64_t>(remaining, buffer.size());
+    in.read(buffer.data(), chunk);
+    out.write(buffer.data(), in.gcount());
+    remaining -= in.gcount();
+  }
+  if (remaining)
+    return fail(path, "is truncated");
+  return Error::success();
+}
+
+void EmbeddingWriter::write(const EmbeddingTable &table) {
+  if (header.elementSize == sizeof(float)) {
+    std::vector<float> values(table.values.begin(), table.values.end());
+    writeLittleEndian(out, values.data(), values.size());
+  } else {
+    writeLittleEndian(out, table.values.data(), table.values.size());
+  }
+  keys.insert(keys.end(), table.keys.begin(), table.keys.end());
+  labels.insert(labels.end(), table.labels.begin(), table.labels.end());
+}
+
+void EmbeddingWriter::writeNpyHeader() {
+  std::ostringstream dict;
+  dict << "{'descr': '<f" << unsigned(header.elementSize)
+       << "', 'fortran_order': False, 'shape': (" << header.rows << ", "
+       << header.dim << "), }";
+  std::string text = dict.str();
+  text.resize(npyHeaderSize - 10 - 1, ' ');
+  text += '\n';
+
+  uint16_t headerLength = text.size();
+  char preamble[10];
+  std::memcpy(preamble, npyMagic, sizeof(npyMagic));
+  preamble[6] = 1;
+  preamble[7] = 0;
+  preamble[8] = headerLength & 0xff;
+  preamble[9] = headerLength >> 8;
+  out.write(preamble, sizeof(preamble));
+  out.write(text.data(), text.size());
+}
+
+Error EmbeddingWriter::close() {
+  header.rows = keys.size();
+
+  if (format == OutputFormat::Bin) {
+    auto pad = [this]() {
+      uint64_t offset = out.tellp();
+      std::string padding(alignTo64(offset) - offset, '\0');
+      out.write(padding.data(), padding.size());
+      return alignTo64(offset);
+    };
+
+    header.labelsOffset = pad();
+    writeLittleEndian(out, labels.data(), labels.size());
+
+    header.keyOffsetsOffset = pad();
+    std::vector<uint64_t> offsets(1, 0);
+    for (auto &key : keys)
+      offsets.push_back(offsets.back() + key.size());
+    writeLittleEndian(out, offsets.data(), offsets.size());
+
+    header.keysOffset = pad();
+    for (auto &key : keys)
+      out.write(key.data(), key.size());
+    header.fileSize = out.tellp();
+
+    out.seekp(0);
+    BinaryHeader fileHeader = swapHeader(header);
+    out.write(reinterpret_cast<const char *>(&fileHeader), sizeof(fileHeader));
+  } else {
+    out.seekp(0);
+    writeNpyHeader();
+
+    std::ofstream keysOut(tmpPath + ".keys", std::ios_base::trunc);
+    for (size_t i = 0; i < keys.size(); i++) {
+      keysOut << escapeKey(keys[i]);
+      if (labels[i] != -1)
+        keysOut << "\t" << labels[i];
+      keysOut << "\n";
+    }
+    keysOut.close();
+    if (!keysOut) {
+      out.close();
+      std::remove(tmpPath.c_str());
+      std::remove((tmpPath + ".keys").c_str());
+      return fail(path + ".keys", "cannot be written");
+    }
+  }
+
+  // The matrix is closed and moved in place before its keys; if only the
+  // keys fail to move, the row count of the stale keys no longer matches and
+  // a later append reports it
+  out.close();
+  if (!out || std::rename(tmpPath.c_str(), path.c_str())) {
+    std::remove(tmpPath.c_str());
+    if (format == OutputFormat::Npy)
+      std::remove((tmpPath + ".keys").c_str());
+    return fail(path, "cannot be written");
+  }
+  if (format == OutputFormat::Npy &&
+      std::rename((tmpPath + ".keys").c_str(), (path + ".keys").c_str())) {
+    std::remove((tmpPath + ".keys").c_str());
+    return fail(path + ".keys", "cannot be written");
+  }
+  return Error::success();
+}
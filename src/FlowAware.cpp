@@ -18,8 +18,8 @@
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Analysis/CFG.h"
-#include "llvm/Analysis/CallGraph.h"
 
+#include "llvm/IR/AbstractCallSite.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/DebugInfoMetadata.h"
@@ -29,66 +29,68 @@
 
 #include <algorithm> // for transform
 
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <regex>
 #include <string>
+#include <thread>
 
 using namespace llvm;
 using namespace IR2Vec;
 
+// Collects the writes through root, or through the loads and GEPs derived
+// from it, in the order of a depth-first walk of the users
 void IR2Vec_FA::getTransitiveUse(
-    const Instruction *root, const Instruction *def,
-    SmallVector<const Instruction *, 100> &visitedList,
-    SmallVector<const Instruction *, 10> toAppend) {
-  unsigned operandNum = 0;
-  visitedList.push_back(def);
-
-  for (auto U : def->users()) {
-    if (auto use = dyn_cast<Instruction>(U)) {
-      if (std::find(visitedList.begin(), visitedList.end(), use) ==
-          visitedList.end()) {
-        IR2VEC_DEBUG(outs() << "\nDef " << /* def << */ " ";
-                     def->print(outs(), true); outs() << "\n";);
-        IR2VEC_DEBUG(outs() << "Use " << /* use << */ " ";
-                     use->print(outs(), true); outs() << "\n";);
-        if (isMemOp(use->getOpcodeName(), operandNum, memWriteOps) &&
-            use->getOperand(operandNum) == def) {
-          writeDefsMap[root].push_back(use);
-        } else if (isMemOp(use->getOpcodeName(), operandNum, memAccessOps) &&
-                   use->getOperand(operandNum) == def) {
-          getTransitiveUse(root, use, visitedList, toAppend);
-        }
-      }
+    const Instruction *root,
+    SmallPtrSetImpl<const Instruction *> &visitedSet) {
+  SmallVector<std::pair<const Instruction *, Value::const_user_iterator>, 16>
+      stack;
+  visitedSet.insert(root);
+  stack.push_back({root, root->user_begin()});
+
+  while (!stack.empty()) {
+    auto &top = stack.back();
+    const Instruction *def = top.first;
+    if (top.second == def->user_end()) {
+      stack.pop_back();
+      continue;
+    }
+    auto use = dyn_cast<Instruction>(*top.second++);
+    if (!use || visitedSet.count(use))
+      continue;
+
+    IR2VEC_DEBUG(outs() << "\nDef " << /* def << */ " ";
+                 def->print(outs(), true); outs() << "\n";);
+    IR2VEC_DEBUG(outs() << "Use " << /* use << */ " ";
+                 use->print(outs(), true); outs() << "\n";);
+    unsigned operandNum = 0;
+    if (isMemOp(use->getOpcode(), operandNum, memWriteOps) &&
+        use->getOperand(operandNum) == def) {
+      writeDefsMap[root].push_back(use);
+    } else if (isMemOp(use->getOpcode(), operandNum, memAccessOps) &&
+               use->getOperand(operandNum) == def) {
+      visitedSet.insert(use);
+      stack.push_back({use, use->user_begin()});
     }
   }
-  return;
 }
 
-void IR2Vec_FA::collectWriteDefsMap(Module &M) {
-  SmallVector<const Instruction *, 100> visitedList;
-  for (auto &F : M) {
-    if (!F.isDeclaration()) {
-      EliminateUnreachableBlocks(F);
-      for (auto &BB : F) {
-        for (auto &I : BB) {
-          unsigned operandNum = 0;
-          if ((isMemOp(I.getOpcodeName(), operandNum, memAccessOps) ||
-               isMemOp(I.getOpcodeName(), operandNum, memWriteOps) ||
-               strcmp(I.getOpcodeName(), "alloca") == 0) &&
-              std::find(visitedList.begin(), visitedList.end(), &I) ==
-                  visitedList.end()) {
-            if (I.getNumOperands() > 0) {
-              IR2VEC_DEBUG(I.print(outs()); outs() << "\n");
-              IR2VEC_DEBUG(outs() << "operandnum = " << operandNum << "\n");
-              if (auto parent =
-                      dyn_cast<Instruction>(I.getOperand(operandNum))) {
-                if (std::find(visitedList.begin(), visitedList.end(), parent) ==
-                    visitedList.end()) {
-                  visitedList.push_back(parent);
-                  getTransitiveUse(parent, parent, visitedList);
-                }
-              }
-            }
+void IR2Vec_FA::collectWriteDefs(Function &F) {
+  SmallPtrSet<const Instruction *, 32> visitedSet;
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      unsigned operandNum = 0;
+      if ((isMemOp(I.getOpcode(), operandNum, memAccessOps) ||
+           isMemOp(I.getOpcode(), operandNum, memWriteOps) ||
+           I.getOpcode() == Instruction::Alloca) &&
+          !visitedSet.count(&I)) {
+        if (I.getNumOperands() > 0) {
+          IR2VEC_DEBUG(I.print(outs()); outs() << "\n");
+          IR2VEC_DEBUG(outs() << "operandnum = " << operandNum << "\n");
+          if (auto parent = dyn_cast<Instruction>(I.getOperand(operandNum))) {
+            if (!visitedSet.count(parent))
+              getTransitiveUse(parent, visitedSet);
           }
         }
       }
@@ -96,14 +98,42 @@ void IR2Vec_FA::collectWriteDefsMap(Module &M) {
   }
 }
 
-Vector IR2Vec_FA::getValue(std::string key) {
-  Vector vec(DIM, 0);
-  if (vocabulary.find(key) == vocabulary.end()) {
-    IR2VEC_DEBUG(errs() << "cannot find key in map : " << key << "\n");
+// Collects the defined functions called by F, once per call site, as the
+// edges of the call graph of the module would give them: the callee of each
+// call, then the functions it calls back through its !callback metadata, like
+// the start routine of pthread_create
+void IR2Vec_FA::collectCallees(Function &F) {
+  auto addCallee = [&](Function *callee) {
+    if (callee && !callee->isDeclaration()) {
+      funcCallMap[&F].push_back(callee);
+      callerMap[callee].push_back(&F);
+    }
+  };
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      if (auto call = dyn_cast<CallBase>(&I)) {
+        addCallee(call->getCalledFunction());
+        forEachCallbackFunction(*call, addCallee);
+      }
+    }
+  }
+}
+
+void IR2Vec_FA::analyzeFunction(Function &F) {
+  if (F.isDeclaration() || !analyzedFunctions.insert(&F).second)
+    return;
+  EliminateUnreachableBlocks(F);
+  collectWriteDefs(F);
+  collectCallees(F);
+}
+
+const double *IR2Vec_FA::getValue(unsigned entity) {
+  if (!vocabulary.hasEntity(entity)) {
+    IR2VEC_DEBUG(errs() << "cannot find entity in vocabulary : " << entity
+                        << "\n");
     dataMissCounter++;
-  } else
-    vec = vocabulary[key];
-  return vec;
+  }
+  return vocabulary.getRow(entity);
 }
 
 // Function to update funcVecMap of function with vectors of it's callee list
@@ -111,19 +141,45 @@ void IR2Vec_FA::updateFuncVecMapWithCallee(const llvm::Function *function) {
   if (funcCallMap.find(function) != funcCallMap.end()) {
 
     auto calleelist = funcCallMap[function];
-    Vector calleeVector(DIM, 0);
-    for (auto funcs : calleelist) {
+    Vector calleeVector(config.dim, 0);
+    for (auto funcs : calleelist)
+      kernels.add(calleeVector, funcVecMap[funcs]);
 
-      auto tmp = funcVecMap[funcs];
-      std::transform(tmp.begin(), tmp.end(), calleeVector.begin(),
-                     calleeVector.begin(), std::plus<double>());
-    }
+    kernels.addScaled(funcVecMap[function], config.WA, calleeVector);
+  }
+}
 
-    scaleVector(calleeVector, WA);
-    auto tmpParent = funcVecMap[function];
-    std::transform(calleeVector.begin(), calleeVector.end(), tmpParent.begin(),
-                   tmpParent.begin(), std::plus<double>());
-    funcVecMap[function] = tmpParent;
+// Encodes each function in a context of its own on IR2Vec::threads workers.
+// Results are merged in the order of functions, which is the order the serial
+// encoding inserts them in, to keep the output identical
+void IR2Vec_FA::encodeFunctions(SmallVectorImpl<Function *> &functions) {
+  std::vector<std::unique_ptr<IR2Vec_FA>> contexts(functions.size());
+  std::atomic<unsigned> next{0};
+
+  auto worker = [&]() {
+    for (unsigned i = next++; i < functions.size(); i = next++)
+      contexts[i].reset(new IR2Vec_FA(*this, *functions[i]));
+  };
+
+  unsigned numWorkers = std::min<unsigned>(config.threads, functions.size());
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < numWorkers; i++)
+    workers.emplace_back(worker);
+  worker();
+  for (auto &t : workers)
+    t.join();
+
+  for (unsigned i = 0; i < functions.size(); i++) {
+    auto &context = *contexts[i];
+    for (auto &It : context.instVecMap)
+      instVecMap.insert({It.first, std::move(It.second)});
+    for (auto &It : context.bbVecMap)
+      bbVecMap.insert({It.first, std::move(It.second)});
+    funcVecMap[functions[i]] = context.funcVecMap[functions[i]];
+
+    dataMissCounter += context.dataMissCounter;
+    cyclicCounter += context.cyclicCounter;
+    contexts[i].reset();
   }
 }
 
@@ -133,14 +189,29 @@ void IR2Vec_FA::generateFlowAwareEncodings(std::ostream *o,
 
   int noOfFunc = 0;
 
-  for (auto &f : M) {
-    if (!f.isDeclaration()) {
-      SmallVector<Function *, 15> funcStack;
-      auto tmp = func2Vec(f, funcStack);
-      funcVecMap[&f] = tmp;
+  for (auto &f : M)
+    analyzeFunction(f);
+
+  if (config.threads > 1) {
+    SmallVector<Function *, 16> functions;
+    for (auto &f : M) {
+      if (!f.isDeclaration())
+        functions.push_back(&f);
+    }
+    encodeFunctions(functions);
+  } else {
+    for (auto &f : M) {
+      if (!f.isDeclaration()) {
+        SmallVector<Function *, 15> funcStack;
+        auto tmp = func2Vec(f, funcStack);
+        funcVecMap[&f] = tmp;
+      }
     }
   }
 
+  for (auto &It : funcVecMap)
+    funcBodyVecMap[It.first] = It.second;
+
   for (auto funcit : funcVecMap) {
     updateFuncVecMapWithCallee(funcit.first);
   }
@@ -151,29 +222,32 @@ void IR2Vec_FA::generateFlowAwareEncodings(std::ostream *o,
       SmallVector<Function *, 15> funcStack;
       tmp = funcVecMap[&f];
 
-      if (level == 'f') {
-        res += updatedRes(tmp, &f, &M);
-        res += "\n";
+      if (config.level == 'f') {
+        if (table) {
+          table->add(getFunctionKey(&f, &M), tmp);
+        } else {
+          res += updatedRes(tmp, &f, &M);
+          res += "\n";
+        }
         noOfFunc++;
       }
 
       // else if (level == 'p') {
-      std::transform(pgmVector.begin(), pgmVector.end(), tmp.begin(),
-                     pgmVector.begin(), std::plus<double>());
+      kernels.add(pgmVector, tmp);
       // }
     }
   }
 
-  if (level == 'p') {
-    if (cls != -1)
-      res += std::to_string(cls) + "\t";
+  if (config.level == 'p' && table) {
+    table->add(M.getSourceFileName(), pgmVector, config.cls);
+  } else if (config.level == 'p') {
+    if (config.cls != -1)
+      res += std::to_string(config.cls) + "\t";
 
-    for (auto i : pgmVector) {
-      if ((i <= 0.0001 && i > 0) || (i < 0 && i >= -0.0001)) {
-        i = 0;
-      }
+    auto printedVector = pgmVector;
+    kernels.clamp(printedVector);
+    for (auto i : printedVector)
       res += std::to_string(i) + "\t";
-    }
     res += "\n";
   }
 
@@ -191,12 +265,158 @@ void IR2Vec_FA::generateFlowAwareEncodings(std::ostream *o,
                      std::to_string(cyclicCounter) + "\n");
 }
 
+Vector IR2Vec_FA::generateFunctionBodyEncoding(Function &F) {
+  analyzeFunction(F);
+  SmallVector<Function *, 15> funcStack;
+  return func2Vec(F, funcStack);
+}
+
+// Vector of function along with the ones of its callees, as
+// updateFuncVecMapWithCallee gives it when the functions are updated in module
+// order: callees that come before function add their updated vector, the
+// others the vector of their body
+Vector IR2Vec_FA::getVectorWithCallees(
+    const Function *function,
+    const DenseMap<const Function *, unsigned> &positions) {
+  Vector vec = funcBodyVecMap[function];
+  auto It = funcCallMap.find(function);
+  if (It == funcCallMap.end() || It->second.empty())
+    return vec;
+
+  unsigned position = positions.lookup(function);
+  Vector calleeVector(config.dim, 0);
+  for (auto callee : It->second) {
+    if (positions.lookup(callee) < position)
+      kernels.add(calleeVector, funcVecMap[callee]);
+    else
+      kernels.add(calleeVector, funcBodyVecMap[callee]);
+  }
+  kernels.addScaled(vec, config.WA, calleeVector);
+  return vec;
+}
+
+// Drops function from the call graph, along with its callees
+void IR2Vec_FA::forgetFunction(const Function *function) {
+  auto It = funcCallMap.find(function);
+  if (It == funcCallMap.end())
+    return;
+  for (auto callee : It->second) {
+    auto &callers = callerMap[callee];
+    callers.erase(std::remove(callers.begin(), callers.end(), function),
+                  callers.end());
+  }
+  It->second.clear();
+}
+
+void IR2Vec_FA::updateFlowAwareEncodings(
+    ArrayRef<Function *> changed, ArrayRef<const Function *> removed,
+    SmallMapVector<const Function *, Vector, 16> &updated) {
+  // The analysis of the functions encoded before is stale
+  instVecMap.clear();
+  bbVecMap.clear();
+  clearAnalysis();
+
+  SmallPtrSet<const Function *, 16> encoded;
+  SmallVector<Function *, 16> functions;
+  for (auto F : changed) {
+    forgetFunction(F);
+    if (!F->isDeclaration() && encoded.insert(F).second)
+      functions.push_back(F);
+  }
+
+  SmallPtrSet<const Function *, 16> dropped;
+  for (auto F : removed) {
+    forgetFunction(F);
+    dropped.insert(F);
+  }
+  for (auto F : changed) {
+    if (F->isDeclaration())
+      dropped.insert(F);
+  }
+  for (auto F : dropped) {
+    funcCallMap.erase(F);
+    callerMap.erase(F);
+    funcBodyVecMap.erase(F);
+  }
+  funcVecMap.remove_if([&](const auto &It) {
+    return dropped.count(It.first) || encoded.count(It.first);
+  });
+
+  for (auto F : functions)
+    analyzeFunction(*F);
+
+  if (config.threads > 1) {
+    encodeFunctions(functions);
+  } else {
+    for (auto F : functions) {
+      SmallVector<Function *, 15> funcStack;
+      func2Vec(*F, funcStack);
+    }
+  }
+  for (auto F : functions)
+    funcBodyVecMap[F] = funcVecMap[F];
+
+  // A caller adds the vector of the body of a callee that comes after it, and
+  // the updated vector of one that comes before it
+  DenseMap<const Function *, unsigned> positions;
+  unsigned position = 0;
+  for (auto &f : M) {
+    if (!f.isDeclaration())
+      positions[&f] = position++;
+  }
+
+  SmallPtrSet<const Function *, 16> affected(encoded.begin(), encoded.end());
+  SmallVector<const Function *, 16> worklist(functions.begin(),
+                                             functions.end());
+  while (!worklist.empty()) {
+    auto callee = worklist.pop_back_val();
+    auto It = callerMap.find(callee);
+    if (It == callerMap.end())
+      continue;
+    for (auto caller : It->second) {
+      if ((encoded.count(callee) ||
+           positions.lookup(callee) < positions.lookup(caller)) &&
+          affected.insert(caller).second)
+        worklist.push_back(caller);
+    }
+  }
+
+  SmallVector<const Function *, 16> order(affected.begin(), affected.end());
+  llvm::sort(order, [&](const Function *A, const Function *B) {
+    return positions.lookup(A) < positions.lookup(B);
+  });
+  for (auto F : order) {
+    auto vec = getVectorWithCallees(F, positions);
+    funcVecMap[F] = vec;
+    updated[F] = std::move(vec);
+  }
+}
+
+void IR2Vec_FA::takeVecMaps(
+    SmallMapVector<const Instruction *, Vector, 128> &instVecs,
+    SmallMapVector<const BasicBlock *, Vector, 16> &bbVecs) {
+  instVecs = std::move(instVecMap);
+  bbVecs = std::move(bbVecMap);
+  instVecMap.clear();
+  bbVecMap.clear();
+  clearAnalysis();
+}
+
+void IR2Vec_FA::clearAnalysis() {
+  livelinessMap.clear();
+  killMap.clear();
+  writeDefsMap.clear();
+  reachability.clear();
+  analyzedFunctions.clear();
+}
+
 // This function will update funcVecMap by doing DFS starting from parent
 // function
 void IR2Vec_FA::updateFuncVecMap(
     llvm::Function *function,
     llvm::SmallSet<const llvm::Function *, 16> &visitedFunctions) {
   visitedFunctions.insert(function);
+  analyzeFunction(*function);
   SmallVector<Function *, 15> funcStack;
   funcStack.clear();
   auto tmpParent = func2Vec(*function, funcStack);
@@ -220,15 +440,17 @@ void IR2Vec_FA::generateFlowAwareEncodingsForFunction(
     std::ostream *cyclicCount) {
 
   int noOfFunc = 0;
+  SmallVector<Function *, 4> requested;
   for (auto &f : M) {
+    if (!f.isDeclaration() && getActualName(&f) == name)
+      requested.push_back(&f);
+  }
 
-    auto Result = getActualName(&f);
-    if (!f.isDeclaration() && Result == name) {
-      // If funcName is matched with one of the functions in module, we
-      // will update funcVecMap of it and it's child functions recursively
-      llvm::SmallSet<const Function *, 16> visitedFunctions;
-      updateFuncVecMap(&f, visitedFunctions);
-    }
+  // If funcName is matched with one of the functions in module, we will
+  // update funcVecMap of it and it's child functions recursively
+  for (auto f : requested) {
+    llvm::SmallSet<const Function *, 16> visitedFunctions;
+    updateFuncVecMap(f, visitedFunctions);
   }
   // iterating over all functions in module instead of funcVecMap to preserve
   // order
@@ -239,18 +461,17 @@ void IR2Vec_FA::generateFlowAwareEncodingsForFunction(
     }
   }
 
-  for (auto &f : M) {
-    auto Result = getActualName(&f);
-    if (!f.isDeclaration() && Result == name) {
-      Vector tmp;
-      SmallVector<Function *, 15> funcStack;
-      tmp = funcVecMap[&f];
+  for (auto f : requested) {
+    Vector tmp = funcVecMap[f];
 
-      if (level == 'f') {
-        res += updatedRes(tmp, &f, &M);
+    if (config.level == 'f') {
+      if (table) {
+        table->add(getFunctionKey(f, &M), tmp);
+      } else {
+        res += updatedRes(tmp, f, &M);
         res += "\n";
-        noOfFunc++;
       }
+      noOfFunc++;
     }
   }
 
@@ -300,7 +521,7 @@ void IR2Vec_FA::TransitiveReads(SmallVector<Instruction *, 16> &Killlist,
                                 Instruction *Inst, BasicBlock *ParentBB) {
   assert(Inst != nullptr);
   unsigned operandNum;
-  bool isMemAccess = isMemOp(Inst->getOpcodeName(), operandNum, memAccessOps);
+  bool isMemAccess = isMemOp(Inst->getOpcode(), operandNum, memAccessOps);
 
   if (!isMemAccess)
     return;
@@ -323,7 +544,7 @@ IR2Vec_FA::createKilllist(Instruction *Arg, Instruction *writeInst) {
 
   for (User *U : Arg->users()) {
     if (Instruction *UseInst = dyn_cast<Instruction>(U)) {
-      if (isMemOp(UseInst->getOpcodeName(), opnum, memWriteOps)) {
+      if (isMemOp(UseInst->getOpcode(), opnum, memWriteOps)) {
         Instruction *OpInst = dyn_cast<Instruction>(UseInst->getOperand(opnum));
         if (OpInst && OpInst == Arg)
           tempList.push_back(UseInst);
@@ -348,6 +569,20 @@ Vector IR2Vec_FA::func2Vec(Function &F,
     return It->second;
   }
 
+  std::string cacheKey;
+  if (cache) {
+    cacheKey = cache->getKey(F);
+    EmbeddingCache::Entry entry;
+    if (cache->lookup(cacheKey, entry)) {
+      dataMissCounter += entry.missCount;
+      cyclicCounter += entry.cyclicCount;
+      funcVecMap[&F] = entry.vector;
+      return entry.vector;
+    }
+  }
+  unsigned missCountBefore = dataMissCounter;
+  unsigned cyclicCountBefore = cyclicCounter;
+
   funcStack.push_back(&F);
 
   instReachingDefsMap.clear();
@@ -355,7 +590,7 @@ Vector IR2Vec_FA::func2Vec(Function &F,
   reverseReachingDefsMap.clear();
   SCCAdjList.clear();
 
-  Vector funcVector(DIM, 0);
+  Vector funcVector(config.dim, 0);
 
   ReversePostOrderTraversal<Function *> RPOT(&F);
 
@@ -364,7 +599,7 @@ Vector IR2Vec_FA::func2Vec(Function &F,
     SmallVector<Instruction *, 16> lists;
     for (auto &I : *b) {
       lists.clear();
-      if (isMemOp(I.getOpcodeName(), opnum, memWriteOps) &&
+      if (isMemOp(I.getOpcode(), opnum, memWriteOps) &&
           dyn_cast<Instruction>(I.getOperand(opnum))) {
         Instruction *argI = cast<Instruction>(I.getOperand(opnum));
         lists = createKilllist(argI, &I);
@@ -523,192 +758,41 @@ Vector IR2Vec_FA::func2Vec(Function &F,
 
   for (auto *b : RPOT) {
     bb2Vec(*b, funcStack);
-    Vector bbVector(DIM, 0);
+    Vector bbVector(config.dim, 0);
     IR2VEC_DEBUG(outs() << "-------------------------------------------\n");
     for (auto &I : *b) {
       auto It1 = livelinessMap.find(&I);
       if (It1->second == true) {
         IR2VEC_DEBUG(I.print(outs()); outs() << "\n");
-        auto vec = instVecMap.find(&I)->second;
+        auto &vec = instVecMap.find(&I)->second;
         IR2VEC_DEBUG(outs() << vec[0] << "\n\n");
-        std::transform(bbVector.begin(), bbVector.end(), vec.begin(),
-                       bbVector.begin(), std::plus<double>());
+        kernels.add(bbVector, vec);
       }
     }
     bbVecMap[b] = bbVector;
     IR2VEC_DEBUG(outs() << "-------------------------------------------\n");
-    for (auto i : bbVector) {
-      if ((i <= 0.0001 && i > 0) || (i < 0 && i >= -0.0001)) {
-        i = 0;
-      }
-    }
 
-    std::transform(funcVector.begin(), funcVector.end(), bbVector.begin(),
-                   funcVector.begin(), std::plus<double>());
+    kernels.add(funcVector, bbVector);
   }
 
   funcStack.pop_back();
   funcVecMap[&F] = funcVector;
+  if (cache)
+    cache->insert(cacheKey, {funcVector, dataMissCounter - missCountBefore,
+                             cyclicCounter - cyclicCountBefore});
   return funcVector;
 }
 
-// LoopInfo contains a mapping from basic block to the innermost loop. Find
-// the outermost loop in the loop nest that contains BB.
-static const Loop *getOutermostLoop(const LoopInfo *LI, const BasicBlock *BB) {
-  const Loop *L = LI->getLoopFor(BB);
-  if (L) {
-    while (const Loop *Parent = L->getParentLoop())
-      L = Parent;
-  }
-  return L;
-}
-
-bool isPotentiallyReachableFromMany(
-    SmallVectorImpl<BasicBlock *> &Worklist, BasicBlock *StopBB,
-    const SmallPtrSetImpl<const BasicBlock *> *ExclusionSet,
-    const DominatorTree *DT, const LoopInfo *LI) {
-  // When the stop block is unreachable, it's dominated from everywhere,
-  // regardless of whether there's a path between the two blocks.
-  if (DT && !DT->isReachableFromEntry(StopBB))
-    DT = nullptr;
-
-  // We can't skip directly from a block that dominates the stop block if the
-  // exclusion block is potentially in between.
-  if (ExclusionSet && !ExclusionSet->empty())
-    DT = nullptr;
-
-  // Normally any block in a loop is reachable from any other block in a loop,
-  // however excluded blocks might partition the body of a loop to make that
-  // untrue.
-
-  SmallPtrSet<const Loop *, 8> LoopsWithHoles;
-  if (LI && ExclusionSet) {
-    for (auto BB : *ExclusionSet) {
-      if (const Loop *L = getOutermostLoop(LI, BB))
-        LoopsWithHoles.insert(L);
-    }
-  }
-
-  const Loop *StopLoop = LI ? getOutermostLoop(LI, StopBB) : nullptr;
-
-  // Limit the number of blocks we visit. The goal is to avoid run-away
-  // compile times on large CFGs without hampering sensible code. Arbitrarily
-  // chosen.
-  unsigned Limit = 32;
-
-  SmallPtrSet<const BasicBlock *, 32> Visited;
-  do {
-    BasicBlock *BB = Worklist.pop_back_val();
-    if (!Visited.insert(BB).second)
-      continue;
-    if (BB == StopBB)
-      return true;
-    if (ExclusionSet && ExclusionSet->count(BB))
-      continue;
-    if (DT && DT->dominates(BB, StopBB))
-      return true;
-
-    const Loop *Outer = nullptr;
-    if (LI) {
-      Outer = getOutermostLoop(LI, BB);
-      // If we're in a loop with a hole, not all blocks in the loop are
-      // reachable from all other blocks. That implies we can't simply
-      // jump to the loop's exit blocks, as that exit might need to pass
-      // through an excluded block. Clear Outer so we process BB's
-      // successors.
-      if (LoopsWithHoles.count(Outer))
-        Outer = nullptr;
-      if (StopLoop && Outer == StopLoop)
-        return true;
-    }
-
-    if (!--Limit) {
-      // We haven't been able to prove it one way or the other.
-      // Conservatively answer true -- that there is potentially a path.
-      return true;
-    }
-
-    if (Outer) {
-      // All blocks in a single loop are reachable from all other blocks.
-      // From any of these blocks, we can skip directly to the exits of
-      // the loop, ignoring any other blocks inside the loop body.
-      Outer->getExitBlocks(Worklist);
-    } else {
-      Worklist.append(succ_begin(BB), succ_end(BB));
-    }
-  } while (!Worklist.empty());
-
-  // We have exhausted all possible paths and are certain that 'To' can not be
-  // reached from 'From'.
-  return false;
-}
-
-bool isPotentiallyReachable(
-    const Instruction *A, const Instruction *B,
-    const SmallPtrSetImpl<const BasicBlock *> *ExclusionSet,
-    const DominatorTree *DT, const LoopInfo *LI) {
-  assert(A->getParent()->getParent() == B->getParent()->getParent() &&
-         "This analysis is function-local!");
-
-  SmallVector<BasicBlock *, 32> Worklist;
-
-  if (A->getParent() == B->getParent()) {
-    // The same block case is special because it's the only time we're
-    // looking within a single block to see which instruction comes first.
-    // Once we start looking at multiple blocks, the first instruction of
-    // the block is reachable, so we only need to determine reachability
-    // between whole blocks.
-    BasicBlock *BB = const_cast<BasicBlock *>(A->getParent());
-
-    // If the block is in a loop then we can reach any instruction in the
-    // block from any other instruction in the block by going around a
-    // backedge.
-    if (LI && LI->getLoopFor(BB) != nullptr)
-      return true;
-
-    // Linear scan, start at 'A', see whether we hit 'B' or the end first.
-    for (BasicBlock::const_iterator I = A->getIterator(), E = BB->end(); I != E;
-         ++I) {
-      if (&*I == B)
-        return true;
-    }
-
-    // Can't be in a loop if it's the entry block -- the entry block may not
-    // have predecessors.
-    if (BB == &BB->getParent()->getEntryBlock())
-      return false;
-
-    // Otherwise, continue doing the normal per-BB CFG walk.
-    Worklist.append(succ_begin(BB), succ_end(BB));
-
-    if (Worklist.empty()) {
-      // We've proven that there's no path!
-      return false;
-    }
-  } else {
-    Worklist.push_back(const_cast<BasicBlock *>(A->getParent()));
-  }
-
-  if (DT) {
-    if (DT->isReachableFromEntry(A->getParent()) &&
-        !DT->isReachableFromEntry(B->getParent()))
-      return false;
-    if (!ExclusionSet || ExclusionSet->empty()) {
-      if (A->getParent() == &A->getParent()->getParent()->getEntryBlock() &&
-          DT->isReachableFromEntry(B->getParent()))
-        return true;
-      if (B->getParent() == &A->getParent()->getParent()->getEntryBlock() &&
-          DT->isReachableFromEntry(A->getParent()))
-        return false;
-    }
-  }
-
-  return isPotentiallyReachableFromMany(
-      Worklist, const_cast<BasicBlock *>(B->getParent()), ExclusionSet, DT, LI);
+ReachabilityIndex &IR2Vec_FA::getReachability(const Function &F) {
+  auto &Index = reachability[&F];
+  if (!Index)
+    Index = std::make_unique<ReachabilityIndex>(F);
+  return *Index;
 }
 
 SmallVector<const Instruction *, 10>
 IR2Vec_FA::getReachingDefs(const Instruction *I, unsigned loc) {
+  PhaseScope scope(phaseTimes, Phase::ReachingDefs);
   IR2VEC_DEBUG(
       outs()
       << "Call to getReachingDefs Started****************************\n");
@@ -720,17 +804,19 @@ IR2Vec_FA::getReachingDefs(const Instruction *I, unsigned loc) {
   IR2VEC_DEBUG(outs() << "Inside RD for : ");
   IR2VEC_DEBUG(I->print(outs()); outs() << "\n");
 
-  if (writeDefsMap[parent].empty()) {
+  auto WD = moduleWriteDefsMap->find(parent);
+  if (WD == moduleWriteDefsMap->end() || WD->second.empty()) {
     RD.push_back(parent);
     return RD;
   }
 
-  if (writeDefsMap[parent].size() >= 1) {
+  if (WD->second.size() >= 1) {
     SmallMapVector<const BasicBlock *, SmallVector<const Instruction *, 10>, 16>
         bbInstMap;
+    auto &reachability = getReachability(*I->getFunction());
     // Remove definitions which don't reach I
-    for (auto it : writeDefsMap[parent]) {
-      if (it != I && isPotentiallyReachable(it, I)) {
+    for (auto it : WD->second) {
+      if (it != I && reachability.isPotentiallyReachable(it, I)) {
 
         probableRD.push_back(it);
       }
@@ -816,10 +902,9 @@ IR2Vec_FA::getReachingDefs(const Instruction *I, unsigned loc) {
     }
     for (auto i : bbSet) {
       IR2VEC_DEBUG(i->print(outs()); outs() << "\n");
-      auto exclusionSet = bbSet;
-      exclusionSet.erase(i);
-      if (isPotentiallyReachable(refBBInstMap[i], I, &exclusionSet, nullptr,
-                                 nullptr)) {
+      // Reaches I without going through the block of another definition
+      if (reachability.isPotentiallyReachableAvoiding(refBBInstMap[i], I,
+                                                      bbSet)) {
         RD.push_back(refBBInstMap[i]);
         IR2VEC_DEBUG(outs() << "refBBInstMap : ";
                      refBBInstMap[i]->print(outs()); outs() << "\n");
@@ -840,15 +925,12 @@ IR2Vec_FA::getReachingDefs(const Instruction *I, unsigned loc) {
   return {};
 }
 
-bool IR2Vec_FA::isMemOp(StringRef opcode, unsigned &operand,
-                        SmallDenseMap<StringRef, unsigned> map) {
-  bool isMemOperand = false;
-  auto It = map.find(opcode);
-  if (It != map.end()) {
-    isMemOperand = true;
-    operand = It->second;
-  }
-  return isMemOperand;
+bool IR2Vec_FA::isMemOp(unsigned opcode, unsigned &operand,
+                        const MemOpTable &table) {
+  if (opcode >= table.size() || table[opcode] < 0)
+    return false;
+  operand = table[opcode];
+  return true;
 }
 
 /*----------------------------------------------------------------------------------
@@ -864,13 +946,12 @@ void IR2Vec_FA::getPartialVec(
     return;
   }
 
-  Vector instVector(DIM, 0);
-  StringRef opcodeName = I.getOpcodeName();
-  auto vec = getValue(opcodeName.str());
+  // Computed in place in the map, which keeps its storage if I was there
+  auto &instVector = partialInstValMap[&I];
+  instVector.assign(config.dim, 0);
+  auto vec = getValue(getOpcodeEntity(I.getOpcode()));
   IR2VEC_DEBUG(I.print(outs()); outs() << "\n");
-  std::transform(instVector.begin(), instVector.end(), vec.begin(),
-                 instVector.begin(), std::plus<double>());
-  partialInstValMap[&I] = instVector;
+  kernels.add(instVector, vec);
 
   IR2VEC_DEBUG(outs() << "contents of partialInstValMap:\n";
                for (auto i
@@ -878,41 +959,9 @@ void IR2Vec_FA::getPartialVec(
                  i.first->print(outs());
                  outs() << "\n";
                });
-  auto type = I.getType();
-
-  if (type->isVoidTy()) {
-    vec = getValue("voidTy");
-  } else if (type->isFloatingPointTy()) {
-    vec = getValue("floatTy");
-  } else if (type->isIntegerTy()) {
-    vec = getValue("integerTy");
-  } else if (type->isFunctionTy()) {
-    vec = getValue("functionTy");
-  } else if (type->isStructTy()) {
-    vec = getValue("structTy");
-  } else if (type->isArrayTy()) {
-    vec = getValue("arrayTy");
-  } else if (type->isPointerTy()) {
-    vec = getValue("pointerTy");
-  } else if (type->isVectorTy()) {
-    vec = getValue("vectorTy");
-  } else if (type->isEmptyTy()) {
-    vec = getValue("emptyTy");
-  } else if (type->isLabelTy()) {
-    vec = getValue("labelTy");
-  } else if (type->isTokenTy()) {
-    vec = getValue("tokenTy");
-  } else if (type->isMetadataTy()) {
-    vec = getValue("metadataTy");
-  } else {
-    vec = getValue("unknownTy");
-  }
+  vec = getValue(getTypeEntity(I.getType()));
 
-  scaleVector(vec, WT);
-  std::transform(instVector.begin(), instVector.end(), vec.begin(),
-                 instVector.begin(), std::plus<double>());
-
-  partialInstValMap[&I] = instVector;
+  kernels.addScaled(instVector, config.WT, vec);
 }
 /*----------------------------------------------------------------------------------
   Function to solve circular dependencies in Instructions
@@ -921,75 +970,51 @@ void IR2Vec_FA::getPartialVec(
 void IR2Vec_FA::solveInsts(
     llvm::SmallMapVector<const llvm::Instruction *, IR2Vec::Vector, 16>
         &partialInstValMap) {
+  PhaseScope scope(phaseTimes, Phase::SolveInsts);
   std::map<unsigned, const Instruction *> xI;
   std::map<const Instruction *, unsigned> Ix;
-  std::vector<std::vector<double>> A, B;
+  // Rows of the right-hand side, whose storage is kept across the calls
+  auto &B = solverRows;
+  unsigned rows = 0;
+  for (auto &It : partialInstValMap)
+    rows += instVecMap.find(It.first) == instVecMap.end();
+  B.resize(rows);
   SmallMapVector<const Instruction *,
                  SmallMapVector<const Instruction *, double, 16>, 16>
       RDValMap;
   unsigned pos = 0;
-  for (auto It : partialInstValMap) {
+  // Adds the operand vector scaled by WA to the row of the latest instruction
+  auto addToLastRow = [this, &pos](matrix &B, const double *vec) {
+    kernels.addScaled(B[pos - 1], config.WA, vec);
+  };
+  for (auto &It : partialInstValMap) {
     auto inst = It.first;
     if (instVecMap.find(inst) == instVecMap.end()) {
       Ix[inst] = pos;
-      xI[pos++] = inst;
-      std::vector<double> tmp;
-      for (auto i : It.second) {
-        tmp.push_back((int)(i * 10) / 10.0);
-      }
-      B.push_back(tmp);
+      xI[pos] = inst;
+      auto &row = B[pos++];
+      row.resize(It.second.size());
+      for (unsigned i = 0; i < It.second.size(); i++)
+        row[i] = (int)(It.second[i] * 10) / 10.0;
       for (unsigned i = 0; i < inst->getNumOperands(); i++) {
         if (isa<Function>(inst->getOperand(i))) {
-          auto f = getValue("function");
+          auto f = getValue(VOCAB_function);
           if (isa<CallInst>(inst)) {
             auto ci = dyn_cast<CallInst>(inst);
             Function *func = ci->getCalledFunction();
             if (func) {
               if (!func->isDeclaration()) {
                 // Will be dealt with later
-                Vector tempCall(DIM, 0);
-                f = tempCall;
+                f = vocabulary.getRow(NUM_VOCAB_ENTITIES);
               }
             }
           }
-          auto svtmp = f;
-          scaleVector(svtmp, WA);
-          std::vector<double> vtmp(svtmp.begin(), svtmp.end());
-          std::vector<double> vec = B.back();
-          IR2VEC_DEBUG(outs() << vec.back() << "\n");
-          IR2VEC_DEBUG(outs() << vtmp.back() << "\n");
-          B.pop_back();
-          std::transform(vtmp.begin(), vtmp.end(), vec.begin(), vec.begin(),
-                         std::plus<double>());
-          IR2VEC_DEBUG(outs() << vec.back() << "\n");
-          B.push_back(vec);
+          addToLastRow(B, f);
         } else if (isa<Constant>(inst->getOperand(i)) &&
                    !isa<PointerType>(inst->getOperand(i)->getType())) {
-          auto c = getValue("constant");
-          auto svtmp = c;
-          scaleVector(svtmp, WA);
-          std::vector<double> vtmp(svtmp.begin(), svtmp.end());
-          std::vector<double> vec = B.back();
-          IR2VEC_DEBUG(outs() << vec.back() << "\n");
-          IR2VEC_DEBUG(outs() << vtmp.back() << "\n");
-          B.pop_back();
-          std::transform(vtmp.begin(), vtmp.end(), vec.begin(), vec.begin(),
-                         std::plus<double>());
-          IR2VEC_DEBUG(outs() << vec.back() << "\n");
-          B.push_back(vec);
+          addToLastRow(B, getValue(VOCAB_constant));
         } else if (isa<BasicBlock>(inst->getOperand(i))) {
-          auto l = getValue("label");
-          auto svtmp = l;
-          scaleVector(svtmp, WA);
-          std::vector<double> vtmp(svtmp.begin(), svtmp.end());
-          std::vector<double> vec = B.back();
-          IR2VEC_DEBUG(outs() << vec.back() << "\n");
-          IR2VEC_DEBUG(outs() << vtmp.back() << "\n");
-          B.pop_back();
-          std::transform(vtmp.begin(), vtmp.end(), vec.begin(), vec.begin(),
-                         std::plus<double>());
-          IR2VEC_DEBUG(outs() << vec.back() << "\n");
-          B.push_back(vec);
+          addToLastRow(B, getValue(VOCAB_label));
         } else {
           if (isa<Instruction>(inst->getOperand(i))) {
             auto RD = getReachingDefs(inst, i);
@@ -1002,89 +1027,69 @@ void IR2Vec_FA::solveInsts(
                 }
                 if (RDValMap.find(inst) == RDValMap.end()) {
                   SmallMapVector<const Instruction *, double, 16> tmp;
-                  tmp[i] = WA;
+                  tmp[i] = config.WA;
                   RDValMap[inst] = tmp;
                 } else {
-                  RDValMap[inst][i] = WA;
+                  RDValMap[inst][i] = config.WA;
                 }
               } else {
-                auto svtmp = instVecMap[i];
-                scaleVector(svtmp, WA);
-                std::vector<double> vtmp(svtmp.begin(), svtmp.end());
-                std::vector<double> vec = B.back();
-                IR2VEC_DEBUG(outs() << vec.back() << "\n");
-                IR2VEC_DEBUG(outs() << vtmp.back() << "\n");
-                B.pop_back();
-                std::transform(vtmp.begin(), vtmp.end(), vec.begin(),
-                               vec.begin(), std::plus<double>());
-                IR2VEC_DEBUG(outs() << vec.back() << "\n");
-                B.push_back(vec);
+                IR2VEC_DEBUG(outs() << B[pos - 1].back() << "\n");
+                addToLastRow(B, instVecMap[i].data());
+                IR2VEC_DEBUG(outs() << B[pos - 1].back() << "\n");
               }
             }
           } else if (isa<PointerType>(inst->getOperand(i)->getType())) {
-            auto l = getValue("pointer");
-            auto svtmp = l;
-            scaleVector(svtmp, WA);
-            std::vector<double> vtmp(svtmp.begin(), svtmp.end());
-            std::vector<double> vec = B.back();
-            IR2VEC_DEBUG(outs() << vec.back() << "\n");
-            IR2VEC_DEBUG(outs() << vtmp.back() << "\n");
-            B.pop_back();
-            std::transform(vtmp.begin(), vtmp.end(), vec.begin(), vec.begin(),
-                           std::plus<double>());
-            IR2VEC_DEBUG(outs() << vec.back() << "\n");
-            B.push_back(vec);
+            addToLastRow(B, getValue(VOCAB_pointer));
           } else {
-            auto l = getValue("variable");
-            auto svtmp = l;
-            scaleVector(svtmp, WA);
-            std::vector<double> vtmp(svtmp.begin(), svtmp.end());
-            std::vector<double> vec = B.back();
-            IR2VEC_DEBUG(outs() << vec.back() << "\n");
-            IR2VEC_DEBUG(outs() << vtmp.back() << "\n");
-            B.pop_back();
-            std::transform(vtmp.begin(), vtmp.end(), vec.begin(), vec.begin(),
-                           std::plus<double>());
-            IR2VEC_DEBUG(outs() << vec.back() << "\n");
-            B.push_back(vec);
+            addToLastRow(B, getValue(VOCAB_variable));
           }
         }
       }
     }
   }
 
+  // Rows of A = I - WA * (reaching definitions within the component)
+  sparseMatrix A(xI.size());
   for (unsigned i = 0; i < xI.size(); i++) {
-    std::vector<double> tmp(xI.size(), 0);
-    A.push_back(tmp);
-  }
-
-  for (unsigned i = 0; i < xI.size(); i++) {
-    A[i][i] = 1;
-    auto tmp = A[i];
-    auto instRDVal = RDValMap[xI[i]];
-    for (auto j : instRDVal) {
-      A[i][Ix[j.first]] = (int)((A[i][Ix[j.first]] - j.second) * 10) / 10.0;
+    A[i].emplace_back(i, 1);
+    auto instRDVal = RDValMap.find(xI[i]);
+    if (instRDVal == RDValMap.end())
+      continue;
+    for (auto j : instRDVal->second) {
+      unsigned col = Ix[j.first];
+      if (col == i)
+        A[i][0].second = (int)((1 - j.second) * 10) / 10.0;
+      else
+        A[i].emplace_back(col, (int)((0 - j.second) * 10) / 10.0);
     }
+    std::sort(A[i].begin(), A[i].end());
   }
 
   for (unsigned i = 0; i < B.size(); i++) {
-    auto Bvec = B[i];
     for (unsigned j = 0; j < B[i].size(); j++) {
       B[i][j] = (int)(B[i][j] * 10) / 10.0;
     }
   }
 
-  auto C = solve(A, B);
+  matrix C;
+  if (xI.size() > sparseSolverThreshold) {
+    C = solveSparse(A, B);
+  } else {
+    matrix denseA(xI.size(), std::vector<double>(xI.size(), 0));
+    for (unsigned i = 0; i < xI.size(); i++)
+      for (auto &entry : A[i])
+        denseA[i][entry.first] = entry.second;
+    C = solve(denseA, B);
+  }
   SmallMapVector<const BasicBlock *, SmallVector<const Instruction *, 10>, 16>
       bbInstMap;
 
   for (unsigned i = 0; i < C.size(); i++) {
-    Vector tmp(C[i].begin(), C[i].end());
     IR2VEC_DEBUG(outs() << "inst:"
                         << "\t";
-                 xI[i]->print(outs()); outs() << "\nVAL: " << tmp[0] << "\n");
+                 xI[i]->print(outs()); outs() << "\nVAL: " << C[i][0] << "\n");
 
-    instVecMap[xI[i]] = tmp;
+    instVecMap[xI[i]] = std::move(C[i]);
     livelinessMap.try_emplace(xI[i], true);
 
     instSolvedBySolver.push_back(xI[i]);
@@ -1123,31 +1128,26 @@ void IR2Vec_FA::solveSingleComponent(
     return;
   }
 
-  Vector instVector(DIM, 0);
-  StringRef opcodeName = I.getOpcodeName();
-
-  instVector = partialInstValMap[&I];
-
   unsigned operandNum;
-  bool isMemWrite = isMemOp(opcodeName, operandNum, memWriteOps);
+  bool isMemWrite = isMemOp(I.getOpcode(), operandNum, memWriteOps);
   bool isCyclic = false;
-  Vector VecArgs(DIM, 0);
+  auto &VecArgs = argsVector;
+  std::fill(VecArgs.begin(), VecArgs.end(), 0);
 
   SmallVector<const Instruction *, 10> RDList;
   RDList.clear();
 
   for (unsigned i = 0; i < I.getNumOperands() /*&& !isCyclic*/; i++) {
-    Vector vecOp(DIM, 0);
+    const double *vecOp = vocabulary.getRow(NUM_VOCAB_ENTITIES);
     if (isa<Function>(I.getOperand(i))) {
-      vecOp = getValue("function");
+      vecOp = getValue(VOCAB_function);
       if (isa<CallInst>(I)) {
         auto ci = dyn_cast<CallInst>(&I);
         Function *func = ci->getCalledFunction();
         if (func) {
           if (!func->isDeclaration()) {
             // Will be dealt with later
-            Vector tempCall(DIM, 0);
-            vecOp = tempCall;
+            vecOp = vocabulary.getRow(NUM_VOCAB_ENTITIES);
           }
         }
       }
@@ -1156,24 +1156,24 @@ void IR2Vec_FA::solveSingleComponent(
     // non-numeric/alphabetic constants are also caught as pointer types
     else if (isa<Constant>(I.getOperand(i)) &&
              !isa<PointerType>(I.getOperand(i)->getType())) {
-      vecOp = getValue("constant");
+      vecOp = getValue(VOCAB_constant);
     } else if (isa<BasicBlock>(I.getOperand(i))) {
-      vecOp = getValue("label");
+      vecOp = getValue(VOCAB_label);
     } else {
       if (isa<Instruction>(I.getOperand(i))) {
         auto RD = getReachingDefs(&I, i);
         RDList.insert(RDList.end(), RD.begin(), RD.end());
       } else if (isa<PointerType>(I.getOperand(i)->getType())) {
-        vecOp = getValue("pointer");
+        vecOp = getValue(VOCAB_pointer);
       } else
-        vecOp = getValue("variable");
+        vecOp = getValue(VOCAB_variable);
     }
 
-    std::transform(VecArgs.begin(), VecArgs.end(), vecOp.begin(),
-                   VecArgs.begin(), std::plus<double>());
+    kernels.add(VecArgs, vecOp);
   }
 
-  Vector vecInst = Vector(DIM, 0);
+  auto &vecInst = rdsVector;
+  std::fill(vecInst.begin(), vecInst.end(), 0);
 
   if (!RDList.empty()) {
     for (auto i : RDList) {
@@ -1188,25 +1188,23 @@ void IR2Vec_FA::solveSingleComponent(
                  "Should have been in instvecmap or partialmap");
         }
       } else {
-        std::transform(instVecMap[i].begin(), instVecMap[i].end(),
-                       vecInst.begin(), vecInst.begin(), std::plus<double>());
+        kernels.add(vecInst, instVecMap[i]);
       }
     }
   }
 
   if (!isCyclic) {
-    std::transform(VecArgs.begin(), VecArgs.end(), vecInst.begin(),
-                   VecArgs.begin(), std::plus<double>());
+    kernels.add(VecArgs, vecInst);
 
     IR2VEC_DEBUG(outs() << VecArgs[0]);
 
-    scaleVector(VecArgs, WA);
-    IR2VEC_DEBUG(outs() << VecArgs.front());
-    std::transform(instVector.begin(), instVector.end(), VecArgs.begin(),
-                   instVector.begin(), std::plus<double>());
+    // The partial vector, which the caller drops after this, is moved into
+    // the map of the instruction vectors and completed there
+    auto &instVector = instVecMap[&I];
+    instVector = std::move(partialInstValMap[&I]);
+    kernels.addScaled(instVector, config.WA, VecArgs);
     IR2VEC_DEBUG(outs() << instVector.front());
 
-    instVecMap[&I] = instVector;
     livelinessMap.try_emplace(&I, true);
 
     if (killMap.find(&I) != killMap.end()) {
@@ -1237,75 +1235,28 @@ void IR2Vec_FA::inst2Vec(
     return;
   }
 
-  Vector instVector(DIM, 0);
-  StringRef opcodeName = I.getOpcodeName();
-  auto vec = getValue(opcodeName.str());
-  IR2VEC_DEBUG(I.print(outs()); outs() << "\n");
-  std::transform(instVector.begin(), instVector.end(), vec.begin(),
-                 instVector.begin(), std::plus<double>());
-  partialInstValMap[&I] = instVector;
-
-  IR2VEC_DEBUG(outs() << "contents of partialInstValMap:\n";
-               for (auto i
-                    : partialInstValMap) {
-                 i.first->print(outs());
-                 outs() << "\n";
-               });
-
-  auto type = I.getType();
-
-  if (type->isVoidTy()) {
-    vec = getValue("voidTy");
-  } else if (type->isFloatingPointTy()) {
-    vec = getValue("floatTy");
-  } else if (type->isIntegerTy()) {
-    vec = getValue("integerTy");
-  } else if (type->isFunctionTy()) {
-    vec = getValue("functionTy");
-  } else if (type->isStructTy()) {
-    vec = getValue("structTy");
-  } else if (type->isArrayTy()) {
-    vec = getValue("arrayTy");
-  } else if (type->isPointerTy()) {
-    vec = getValue("pointerTy");
-  } else if (type->isVectorTy()) {
-    vec = getValue("vectorTy");
-  } else if (type->isEmptyTy()) {
-    vec = getValue("emptyTy");
-  } else if (type->isLabelTy()) {
-    vec = getValue("labelTy");
-  } else if (type->isTokenTy()) {
-    vec = getValue("tokenTy");
-  } else if (type->isMetadataTy()) {
-    vec = getValue("metadataTy");
-  } else {
-    vec = getValue("unknownTy");
-  }
-  scaleVector(vec, WT);
-  std::transform(instVector.begin(), instVector.end(), vec.begin(),
-                 instVector.begin(), std::plus<double>());
-  partialInstValMap[&I] = instVector;
+  getPartialVec(I, partialInstValMap);
 
   unsigned operandNum;
-  bool isMemWrite = isMemOp(opcodeName, operandNum, memWriteOps);
+  bool isMemWrite = isMemOp(I.getOpcode(), operandNum, memWriteOps);
   bool isCyclic = false;
-  Vector VecArgs(DIM, 0);
+  auto &VecArgs = argsVector;
+  std::fill(VecArgs.begin(), VecArgs.end(), 0);
 
   SmallVector<const Instruction *, 10> RDList;
   RDList.clear();
 
   for (unsigned i = 0; i < I.getNumOperands() /*&& !isCyclic*/; i++) {
-    Vector vecOp(DIM, 0);
+    const double *vecOp = vocabulary.getRow(NUM_VOCAB_ENTITIES);
     if (isa<Function>(I.getOperand(i))) {
-      vecOp = getValue("function");
+      vecOp = getValue(VOCAB_function);
       if (isa<CallInst>(I)) {
         auto ci = dyn_cast<CallInst>(&I);
         Function *func = ci->getCalledFunction();
         if (func) {
           if (!func->isDeclaration()) {
             // Will be dealt with later
-            Vector tempCall(DIM, 0);
-            vecOp = tempCall;
+            vecOp = vocabulary.getRow(NUM_VOCAB_ENTITIES);
           }
         }
       }
@@ -1314,24 +1265,24 @@ void IR2Vec_FA::inst2Vec(
     // non-numeric/alphabetic constants are also caught as pointer types
     else if (isa<Constant>(I.getOperand(i)) &&
              !isa<PointerType>(I.getOperand(i)->getType())) {
-      vecOp = getValue("constant");
+      vecOp = getValue(VOCAB_constant);
     } else if (isa<BasicBlock>(I.getOperand(i))) {
-      vecOp = getValue("label");
+      vecOp = getValue(VOCAB_label);
     } else {
       if (isa<Instruction>(I.getOperand(i))) {
         auto RD = getReachingDefs(&I, i);
         RDList.insert(RDList.end(), RD.begin(), RD.end());
       } else if (isa<PointerType>(I.getOperand(i)->getType()))
-        vecOp = getValue("pointer");
+        vecOp = getValue(VOCAB_pointer);
       else
-        vecOp = getValue("variable");
+        vecOp = getValue(VOCAB_variable);
     }
 
-    std::transform(VecArgs.begin(), VecArgs.end(), vecOp.begin(),
-                   VecArgs.begin(), std::plus<double>());
+    kernels.add(VecArgs, vecOp);
   }
 
-  Vector vecInst = Vector(DIM, 0);
+  auto &vecInst = rdsVector;
+  std::fill(vecInst.begin(), vecInst.end(), 0);
 
   if (!RDList.empty()) {
     for (auto i : RDList) {
@@ -1340,24 +1291,20 @@ void IR2Vec_FA::inst2Vec(
         assert(instVecMap.find(i) != instVecMap.end() &&
                "All RDs should have been solved by Topo Order!");
       } else {
-        std::transform(instVecMap[i].begin(), instVecMap[i].end(),
-                       vecInst.begin(), vecInst.begin(), std::plus<double>());
+        kernels.add(vecInst, instVecMap[i]);
       }
     }
   }
 
   if (!isCyclic) {
-    std::transform(VecArgs.begin(), VecArgs.end(), vecInst.begin(),
-                   VecArgs.begin(), std::plus<double>());
+    kernels.add(VecArgs, vecInst);
 
     IR2VEC_DEBUG(outs() << VecArgs[0]);
 
-    scaleVector(VecArgs, WA);
-    IR2VEC_DEBUG(outs() << VecArgs.front());
-    std::transform(instVector.begin(), instVector.end(), VecArgs.begin(),
-                   instVector.begin(), std::plus<double>());
+    auto &instVector = instVecMap[&I];
+    instVector = std::move(partialInstValMap[&I]);
+    kernels.addScaled(instVector, config.WA, VecArgs);
     IR2VEC_DEBUG(outs() << instVector.front());
-    instVecMap[&I] = instVector;
     livelinessMap.try_emplace(&I, true);
 
     if (killMap.find(&I) != killMap.end()) {
@@ -1453,6 +1400,7 @@ void IR2Vec_FA::getAllSCC() {
 }
 
 void IR2Vec_FA::bb2Vec(BasicBlock &B, SmallVector<Function *, 15> &funcStack) {
+  PhaseScope scope(phaseTimes, Phase::BB2Vec);
   SmallMapVector<const Instruction *, Vector, 16> partialInstValMap;
 
   for (auto &I : B) {
@@ -6,13 +6,19 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "Batch.h"
 #include "CollectIR.h"
+#include "EmbeddingCache.h"
+#include "EmbeddingWriter.h"
 #include "FlowAware.h"
 #include "Symbolic.h"
+#include "TripleIndex.h"
 #include "Vocabulary.h"
 #include "version.h"
 
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include <chrono>
 #include <stdio.h>
 #include <time.h>
 
@@ -36,7 +42,12 @@ cl::opt<bool> cl_collectIR(
     cl::desc("Generate triplets for training seed embedding vocabulary"),
     cl::init(false), cl::cat(category));
 cl::opt<std::string> cl_iname(cl::Positional, cl::desc("Input file path"),
-                              cl::Required, cl::cat(category));
+                              cl::Optional, cl::cat(category));
+cl::opt<std::string> cl_batch(
+    "batch", cl::Optional, cl::init(""),
+    cl::desc("Directory of .ll/.bc files or file listing one input path per "
+             "line, to be encoded in a single run"),
+    cl::cat(category));
 cl::opt<unsigned> cl_dim("dim", cl::Optional, cl::init(300),
                          cl::desc("Dimension of the embeddings"),
                          cl::cat(category));
@@ -46,6 +57,38 @@ cl::opt<std::string> cl_oname("o", cl::Required, cl::desc("Output file path"),
 cl::opt<std::string> cl_funcName("funcName", cl::Optional, cl::init(""),
                                  cl::desc("Function name"), cl::cat(category));
 
+cl::opt<unsigned> cl_threads(
+    "threads", cl::Optional, cl::init(1),
+    cl::desc("Number of threads to encode functions with in flow-aware mode, "
+             "or files with in batch mode"),
+    cl::cat(category));
+
+cl::opt<OutputFormat> cl_format(
+    "format", cl::Optional, cl::init(OutputFormat::Text),
+    cl::desc("Format of the output file"),
+    cl::values(clEnumValN(OutputFormat::Text, "txt",
+                          "Tab separated text (default)"),
+               clEnumValN(OutputFormat::Bin, "bin",
+                          "Binary file of header, matrix and keys; OpenKE "
+                          "index directory in collectIR mode"),
+               clEnumValN(OutputFormat::Npy, "npy",
+                          "NumPy matrix, with keys in <output-file>.keys")),
+    cl::cat(category));
+cl::opt<bool> cl_float32(
+    "float32", cl::Optional, cl::init(false),
+    cl::desc("Store embeddings in single precision in bin/npy formats"),
+    cl::cat(category));
+
+cl::opt<std::string> cl_cacheDir(
+    "cache-dir", cl::Optional, cl::init(""),
+    cl::desc("Directory caching the embeddings of functions across runs"),
+    cl::cat(category));
+cl::opt<unsigned> cl_cacheSize(
+    "cache-size", cl::Optional, cl::init(1024),
+    cl::desc("Size in MB over which least recently used cache entries are "
+             "removed"),
+    cl::cat(category));
+
 cl::opt<char>
     cl_level("level", cl::Optional, cl::init(0),
              cl::desc("Level of encoding - p = Program; f = Function"),
@@ -83,16 +126,19 @@ int main(int argc, char **argv) {
   collectIR = cl_collectIR;
   iname = cl_iname;
   oname = cl_oname;
-  DIM = cl_dim;
-  funcName = cl_funcName;
-  level = cl_level;
-  cls = cl_cls;
-  WO = cl_WO;
-  WA = cl_WA;
-  WT = cl_WT;
-  debug = cl_debug;
   printTime = cl_printTime;
 
+  Config config;
+  config.level = cl_level;
+  config.cls = cl_cls;
+  config.funcName = cl_funcName;
+  config.dim = cl_dim;
+  config.WO = cl_WO;
+  config.WA = cl_WA;
+  config.WT = cl_WT;
+  config.threads = cl_threads;
+  config.debug = cl_debug;
+
   bool failed = false;
   if (!((sym ^ fa) ^ collectIR)) {
     errs() << "Either of sym, fa or collectIR should be specified\n";
@@ -100,7 +146,7 @@ int main(int argc, char **argv) {
   }
 
   if (sym || fa) {
-    if (level != 'p' && level != 'f') {
+    if (config.level != 'p' && config.level != 'f') {
       errs() << "Invalid level specified: Use either p or f\n";
       failed = true;
     }
@@ -108,24 +154,112 @@ int main(int argc, char **argv) {
     if (!collectIR) {
       errs() << "Either of sym, fa or collectIR should be specified\n";
       failed = true;
-    } else if (level)
+    } else if (config.level)
       errs() << "[WARNING] level would not be used in collectIR mode\n";
   }
 
+  if (cl_batch.empty() == iname.empty()) {
+    errs() << "Either of an input file or batch should be specified\n";
+    failed = true;
+  }
+
+  if (collectIR && cl_format == OutputFormat::Npy) {
+    errs() << "npy format is not supported in collectIR mode\n";
+    failed = true;
+  }
+
+  if (collectIR && !cl_cacheDir.empty()) {
+    errs() << "cache-dir is not supported in collectIR mode\n";
+    failed = true;
+  }
+
   if (failed)
     exit(1);
 
+  // Errors of the output and the cache end the run
+  ExitOnError exitOnErr;
+
+  // Removes the least recently used entries when destroyed, after the run
+  std::unique_ptr<EmbeddingCache> cache;
+  auto createCache = [&](const VocabularyBase &vocabulary) {
+    if (!cl_cacheDir.empty())
+      cache = exitOnErr(EmbeddingCache::create(cl_cacheDir, fa ? 'f' : 's',
+                                               vocabulary, config,
+                                               uint64_t(cl_cacheSize) << 20));
+  };
+
+  if (!cl_batch.empty() && collectIR) {
+    // -format=bin builds the OpenKE index in the directory of -o
+    std::unique_ptr<TripleIndex> index;
+    if (cl_format == OutputFormat::Bin)
+      index = std::make_unique<TripleIndex>(oname);
+    BatchCollector batch(cl_batch, config, index.get());
+    auto start = std::chrono::steady_clock::now();
+    unsigned failedFiles = batch.run(oname);
+    if (index)
+      index->close();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (printTime)
+      printf("Time taken by batch collection of triplets of %zu files is: "
+             "%.6f seconds.\n",
+             batch.size(), elapsed.count());
+    if (failedFiles) {
+      errs() << failedFiles << " of " << batch.size()
+             << " files could not be collected\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  if (!cl_batch.empty()) {
+    auto vocabulary = VocabularyFactory::createVocabulary(config.dim);
+    createCache(*vocabulary);
+    std::unique_ptr<EmbeddingWriter> writer;
+    if (cl_format != OutputFormat::Text)
+      writer = exitOnErr(EmbeddingWriter::create(
+          oname, cl_format, fa ? 'f' : 's', *vocabulary, config, cl_float32));
+    BatchEncoder batch(cl_batch, *vocabulary, config, writer.get(),
+                       cache.get());
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned failedFiles = batch.run();
+    if (writer)
+      exitOnErr(writer->close());
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (printTime)
+      printf("Time taken by batch generation of %s encodings of %zu files "
+             "is: %.6f seconds.\n",
+             fa ? "flow-aware" : "symbolic", batch.size(), elapsed.count());
+    if (failedFiles) {
+      errs() << failedFiles << " of " << batch.size()
+             << " files could not be encoded\n";
+      return 1;
+    }
+    return 0;
+  }
+
   auto M = getLLVMIR();
-  auto vocabulary = VocabularyFactory::createVocabulary(DIM)->getVocabulary();
+  auto vocabulary = VocabularyFactory::createVocabulary(config.dim);
+  createCache(*vocabulary);
 
-  // newly added
-  if (sym && !(funcName.empty())) {
-    IR2Vec_Symbolic SYM(*M, vocabulary);
-    std::ofstream o;
+  // Binary formats collect the embeddings in table instead of text in o
+  bool binary = cl_format != OutputFormat::Text;
+  EmbeddingTable table;
+  std::ofstream o;
+  if (!binary)
     o.open(oname, std::ios_base::app);
+  std::ostream *out = binary ? nullptr : &o;
+
+  // newly added
+  if (sym && !(config.funcName.empty())) {
+    IR2Vec_Symbolic SYM(*M, *vocabulary, config);
+    SYM.setEmbeddingTable(binary ? &table : nullptr);
+    SYM.setEmbeddingCache(cache.get());
     if (printTime) {
       clock_t start = clock();
-      SYM.generateSymbolicEncodingsForFunction(&o, funcName);
+      SYM.generateSymbolicEncodingsForFunction(out, config.funcName);
       clock_t end = clock();
       double elapsed = double(end - start) / CLOCKS_PER_SEC;
       printf("Time taken by on-demand generation of symbolic encodings "
@@ -133,19 +267,19 @@ int main(int argc, char **argv) {
              "seconds.\n",
              elapsed);
     } else {
-      SYM.generateSymbolicEncodingsForFunction(&o, funcName);
+      SYM.generateSymbolicEncodingsForFunction(out, config.funcName);
     }
-    o.close();
-  } else if (fa && !(funcName.empty())) {
-    IR2Vec_FA FA(*M, vocabulary);
-    std::ofstream o, missCount, cyclicCount;
-    o.open(oname, std::ios_base::app);
+  } else if (fa && !(config.funcName.empty())) {
+    IR2Vec_FA FA(*M, *vocabulary, config);
+    FA.setEmbeddingTable(binary ? &table : nullptr);
+    FA.setEmbeddingCache(cache.get());
+    std::ofstream missCount, cyclicCount;
     missCount.open("missCount_" + oname, std::ios_base::app);
     cyclicCount.open("cyclicCount_" + oname, std::ios_base::app);
     if (printTime) {
       clock_t start = clock();
-      FA.generateFlowAwareEncodingsForFunction(&o, funcName, &missCount,
-                                               &cyclicCount);
+      FA.generateFlowAwareEncodingsForFunction(out, config.funcName,
+                                               &missCount, &cyclicCount);
       clock_t end = clock();
       double elapsed = double(end - start) / CLOCKS_PER_SEC;
       printf("Time taken by on-demand generation of flow-aware encodings "
@@ -153,19 +287,19 @@ int main(int argc, char **argv) {
              "seconds.\n",
              elapsed);
     } else {
-      FA.generateFlowAwareEncodingsForFunction(&o, funcName, &missCount,
-                                               &cyclicCount);
+      FA.generateFlowAwareEncodingsForFunction(out, config.funcName,
+                                               &missCount, &cyclicCount);
     }
-    o.close();
   } else if (fa) {
-    IR2Vec_FA FA(*M, vocabulary);
-    std::ofstream o, missCount, cyclicCount;
-    o.open(oname, std::ios_base::app);
+    IR2Vec_FA FA(*M, *vocabulary, config);
+    FA.setEmbeddingTable(binary ? &table : nullptr);
+    FA.setEmbeddingCache(cache.get());
+    std::ofstream missCount, cyclicCount;
     missCount.open("missCount_" + oname, std::ios_base::app);
     cyclicCount.open("cyclicCount_" + oname, std::ios_base::app);
     if (printTime) {
       clock_t start = clock();
-      FA.generateFlowAwareEncodings(&o, &missCount, &cyclicCount);
+      FA.generateFlowAwareEncodings(out, &missCount, &cyclicCount);
       clock_t end = clock();
       double elapsed = double(end - start) / CLOCKS_PER_SEC;
       printf("Time taken by normal generation of flow-aware encodings "
@@ -173,16 +307,15 @@ int main(int argc, char **argv) {
              "seconds.\n",
              elapsed);
     } else {
-      FA.generateFlowAwareEncodings(&o, &missCount, &cyclicCount);
+      FA.generateFlowAwareEncodings(out, &missCount, &cyclicCount);
     }
-    o.close();
   } else if (sym) {
-    IR2Vec_Symbolic SYM(*M, vocabulary);
-    std::ofstream o;
-    o.open(oname, std::ios_base::app);
+    IR2Vec_Symbolic SYM(*M, *vocabulary, config);
+    SYM.setEmbeddingTable(binary ? &table : nullptr);
+    SYM.setEmbeddingCache(cache.get());
     if (printTime) {
       clock_t start = clock();
-      SYM.generateSymbolicEncodings(&o);
+      SYM.generateSymbolicEncodings(out);
       clock_t end = clock();
       double elapsed = double(end - start) / CLOCKS_PER_SEC;
       printf("Time taken by normal generation of symbolic encodings is: "
@@ -190,15 +323,27 @@ int main(int argc, char **argv) {
              "seconds.\n",
              elapsed);
     } else {
-      SYM.generateSymbolicEncodings(&o);
+      SYM.generateSymbolicEncodings(out);
     }
-    o.close();
   } else if (collectIR) {
-    CollectIR cir(M);
-    std::ofstream o;
-    o.open(oname, std::ios_base::app);
-    cir.generateTriplets(o);
-    o.close();
+    CollectIR cir(*M, config);
+    if (binary) {
+      TripleIndex index(oname);
+      TripleStream triples(index);
+      cir.generateTriplets(triples);
+      triples.flush();
+      index.close();
+    } else {
+      cir.generateTriplets(o);
+    }
+  }
+  o.close();
+
+  if (binary && !collectIR) {
+    auto writer = exitOnErr(EmbeddingWriter::create(
+        oname, cl_format, fa ? 'f' : 's', *vocabulary, config, cl_float32));
+    writer->write(table);
+    exitOnErr(writer->close());
   }
   return 0;
 }
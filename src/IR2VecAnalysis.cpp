@@ -0,0 +1,200 @@
+//===- IR2VecAnalysis.cpp - IR2Vec analyses of the pass manager -*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "IR2VecAnalysis.h"
+#include "FlowAware.h"
+#include "Symbolic.h"
+#include "utils.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/IR/AbstractCallSite.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+using namespace llvm;
+using namespace IR2Vec;
+
+AnalysisKey IR2VecFunctionAnalysis::Key;
+AnalysisKey IR2VecModuleAnalysis::Key;
+
+static Config getEngineConfig(const AnalysisConfig &config) {
+  Config engineConfig;
+  engineConfig.dim = config.dim;
+  engineConfig.WO = config.WO;
+  engineConfig.WA = config.WA;
+  engineConfig.WT = config.WT;
+  return engineConfig;
+}
+
+static bool hasUnreachableBlocks(Function &F) {
+  df_iterator_default_set<BasicBlock *> reachable;
+  for (auto BB : depth_first_ext(&F, reachable))
+    (void)BB;
+  return reachable.size() != F.size();
+}
+
+IR2VecFunctionAnalysis::IR2VecFunctionAnalysis(AnalysisConfig config)
+    : config{config},
+      vocabulary{VocabularyFactory::createVocabulary(config.dim)} {}
+
+IR2VecFunctionAnalysis::Result
+IR2VecFunctionAnalysis::run(Function &F, FunctionAnalysisManager &FAM) {
+  Result result;
+  if (F.isDeclaration()) {
+    result.funcVector = Vector(config.dim, 0);
+    return result;
+  }
+
+  // The flow-aware encoding removes the unreachable blocks of the function,
+  // which an analysis may not do; a copy of the function in a module of its
+  // own is encoded instead
+  Function *encoded = &F;
+  std::unique_ptr<Module> scratch;
+  ValueToValueMapTy VMap;
+  if (config.mode == FlowAware && hasUnreachableBlocks(F)) {
+    scratch = std::make_unique<Module>(F.getName(), F.getContext());
+    encoded = Function::Create(F.getFunctionType(), F.getLinkage(),
+                               F.getName(), scratch.get());
+    auto arg = encoded->arg_begin();
+    for (auto &Arg : F.args())
+      VMap[&Arg] = &*arg++;
+    SmallVector<ReturnInst *, 8> returns;
+    CloneFunctionInto(encoded, &F, VMap,
+                      CloneFunctionChangeType::DifferentModule, returns);
+  }
+
+  SmallMapVector<const Instruction *, Vector, 128> instVecs;
+  SmallMapVector<const BasicBlock *, Vector, 16> bbVecs;
+  if (config.mode == FlowAware) {
+    IR2Vec_FA FA(*encoded->getParent(), *vocabulary, getEngineConfig(config));
+    result.funcVector = FA.generateFunctionBodyEncoding(*encoded);
+    FA.takeVecMaps(instVecs, bbVecs);
+  } else {
+    IR2Vec_Symbolic SYM(*encoded->getParent(), *vocabulary,
+                        getEngineConfig(config));
+    result.funcVector = SYM.generateFunctionEncoding(*encoded);
+    SYM.takeVecMaps(instVecs, bbVecs);
+  }
+
+  // Calls of the blocks that were removed do not count
+  for (auto &BB : *encoded) {
+    for (auto &I : BB) {
+      if (auto call = dyn_cast<CallBase>(&I)) {
+        auto addCallee = [&](Function *callee) {
+          if (callee)
+            result.callees.push_back({callee, !callee->isDeclaration()});
+        };
+        addCallee(call->getCalledFunction());
+        forEachCallbackFunction(*call, addCallee);
+      }
+    }
+  }
+
+  if (!scratch) {
+    result.instVecMap = std::move(instVecs);
+    result.bbVecMap = std::move(bbVecs);
+    return result;
+  }
+
+  // Vectors of the copy are given to the values of the function
+  for (auto &BB : F) {
+    // Values of the blocks removed from the copy are null
+    auto It = VMap.find(&BB);
+    if (It == VMap.end() || !It->second)
+      continue;
+    auto bbVec = bbVecs.find(cast<BasicBlock>(It->second));
+    if (bbVec != bbVecs.end())
+      result.bbVecMap[&BB] = std::move(bbVec->second);
+
+    for (auto &I : BB) {
+      auto It = VMap.find(&I);
+      if (It == VMap.end() || !It->second)
+        continue;
+      auto instVec = instVecs.find(cast<Instruction>(It->second));
+      if (instVec != instVecs.end())
+        result.instVecMap[&I] = std::move(instVec->second);
+    }
+  }
+  return result;
+}
+
+IR2VecModuleAnalysis::Result
+IR2VecModuleAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  auto &FAM = MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  const auto &kernels = getVectorKernels(config.dim);
+
+  Result result;
+  result.pgmVector = Vector(config.dim, 0);
+  SmallVector<const IR2VecFunctionAnalysis::Result *, 16> functions;
+  DenseMap<const Function *, unsigned> positions;
+  for (auto &F : M) {
+    if (F.isDeclaration())
+      continue;
+    auto *FR = &FAM.getResult<IR2VecFunctionAnalysis>(F);
+    // The flow-aware vector of a function depends on whether its callees are
+    // defined, which may change while the function does not
+    if (config.mode == FlowAware &&
+        any_of(FR->callees, [](const std::pair<const Function *, bool> &It) {
+          return It.first->isDeclaration() == It.second;
+        })) {
+      PreservedAnalyses PA = PreservedAnalyses::all();
+      PA.abandon<IR2VecFunctionAnalysis>();
+      FAM.invalidate(F, PA);
+      FR = &FAM.getResult<IR2VecFunctionAnalysis>(F);
+    }
+    positions[&F] = functions.size();
+    functions.push_back(FR);
+    result.funcVecMap[&F] = FR->funcVector;
+  }
+
+  // Callees add the vector they have at that point to the ones of their
+  // callers, in module order, as IR2Vec_FA does
+  if (config.mode == FlowAware) {
+    unsigned position = 0;
+    for (auto &It : result.funcVecMap) {
+      auto &vec = It.second;
+      Vector calleeVector(config.dim, 0);
+      bool hasCallees = false;
+      for (auto &callee : functions[position]->callees) {
+        if (!callee.second)
+          continue;
+        auto calleePosition = positions.lookup(callee.first);
+        kernels.add(calleeVector,
+                    calleePosition < position
+                        ? result.funcVecMap.find(callee.first)->second
+                        : functions[calleePosition]->funcVector);
+        hasCallees = true;
+      }
+      if (hasCallees)
+        kernels.addScaled(vec, config.WA, calleeVector);
+      position++;
+    }
+  }
+
+  for (auto &It : result.funcVecMap)
+    kernels.add(result.pgmVector, It.second);
+  return result;
+}
+
+PreservedAnalyses IR2VecPrinterPass::run(Module &M,
+                                         ModuleAnalysisManager &MAM) {
+  auto &result = MAM.getResult<IR2VecModuleAnalysis>(M);
+  const auto &kernels = getVectorKernels(result.pgmVector.size());
+  for (auto &It : result.funcVecMap)
+    OS << updatedRes(It.second, const_cast<Function *>(It.first), &M) << "\n";
+
+  auto printedVector = result.pgmVector;
+  kernels.clamp(printedVector);
+  for (auto i : printedVector)
+    OS << std::to_string(i) << "\t";
+  OS << "\n";
+  return PreservedAnalyses::all();
+}
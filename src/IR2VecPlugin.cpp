@@ -0,0 +1,74 @@
+//===- IR2VecPlugin.cpp - Pass plugin of IR2Vec -----------------*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "IR2VecAnalysis.h"
+#include "version.h"
+
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
+
+using namespace llvm;
+using namespace IR2Vec;
+
+static cl::OptionCategory category("IR2Vec Plugin Options");
+
+static cl::opt<bool> cl_sym("ir2vec-sym", cl::Optional,
+                            cl::desc("Generate Symbolic Encodings"),
+                            cl::init(false), cl::cat(category));
+
+static cl::opt<unsigned> cl_dim("ir2vec-dim", cl::Optional, cl::init(300),
+                                cl::desc("Dimension of the embeddings"),
+                                cl::cat(category));
+
+static cl::opt<float> cl_WO("ir2vec-wo", cl::Optional, cl::init(1),
+                            cl::desc("Weight of Opcode"), cl::cat(category));
+
+static cl::opt<float> cl_WA("ir2vec-wa", cl::Optional, cl::init(0.2),
+                            cl::desc("Weight of arguments"),
+                            cl::cat(category));
+
+static cl::opt<float> cl_WT("ir2vec-wt", cl::Optional, cl::init(0.5),
+                            cl::desc("Weight of types"), cl::cat(category));
+
+static AnalysisConfig getConfig() {
+  AnalysisConfig config;
+  config.mode = cl_sym ? Symbolic : FlowAware;
+  config.dim = cl_dim;
+  config.WO = cl_WO;
+  config.WA = cl_WA;
+  config.WT = cl_WT;
+  return config;
+}
+
+// Registers the analyses, and print<ir2vec> which prints the embeddings of
+// the module, e.g.
+//   opt -load-pass-plugin=libIR2VecPlugin.so -passes='print<ir2vec>' x.ll
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "IR2Vec", IR2VEC_VERSION,
+          [](PassBuilder &PB) {
+            PB.registerAnalysisRegistrationCallback(
+                [](FunctionAnalysisManager &FAM) {
+                  FAM.registerPass(
+                      [] { return IR2VecFunctionAnalysis(getConfig()); });
+                });
+            PB.registerAnalysisRegistrationCallback(
+                [](ModuleAnalysisManager &MAM) {
+                  MAM.registerPass(
+                      [] { return IR2VecModuleAnalysis(getConfig()); });
+                });
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, ModulePassManager &MPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name != "print<ir2vec>")
+                    return false;
+                  MPM.addPass(IR2VecPrinterPass(outs()));
+                  return true;
+                });
+          }};
+}
@@ -0,0 +1,144 @@
+//===- Reachability.cpp - Reachability within a function --------*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "Reachability.h"
+
+#include "llvm/IR/CFG.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace IR2Vec;
+
+ReachabilityIndex::ReachabilityIndex(const Function &F) : F{F} {
+  for (auto &BB : F) {
+    blockNumbers[&BB] = blocks.size();
+    blocks.push_back(&BB);
+  }
+
+  successors.resize(blocks.size());
+  for (unsigned i = 0; i < blocks.size(); i++)
+    for (auto *Succ : llvm::successors(blocks[i]))
+      successors[i].push_back(blockNumbers[Succ]);
+
+  stamps.assign(blocks.size(), 0);
+  reachable.resize(blocks.size());
+  large.assign(blocks.size(), false);
+
+  // The walks are bounded like the ones they stand for, which keeps building
+  // the index linear in the number of blocks
+  for (unsigned i = 0; i < blocks.size(); i++) {
+    ++epoch;
+    worklist.assign(successors[i].begin(), successors[i].end());
+    auto &Reachable = reachable[i];
+    while (!worklist.empty()) {
+      unsigned BB = worklist.pop_back_val();
+      if (stamps[BB] == epoch)
+        continue;
+      stamps[BB] = epoch;
+      Reachable.push_back(BB);
+      if (Reachable.size() == MaxBlocksToExplore) {
+        large[i] = true;
+        break;
+      }
+      worklist.append(successors[BB].begin(), successors[BB].end());
+    }
+    if (large[i])
+      Reachable.clear();
+    else
+      std::sort(Reachable.begin(), Reachable.end());
+  }
+}
+
+// Whether the walk from block From reaches block To, or gives up, when From
+// is not To
+bool ReachabilityIndex::reaches(unsigned From, unsigned To) const {
+  if (large[From])
+    return true;
+  auto &Reachable = reachable[From];
+  if (std::binary_search(Reachable.begin(), Reachable.end(), To))
+    return true;
+  // The walk also counts From unless it is reachable from itself
+  unsigned Explored =
+      Reachable.size() +
+      !std::binary_search(Reachable.begin(), Reachable.end(), From);
+  return Explored >= MaxBlocksToExplore;
+}
+
+// Answers the queries within a block that need no walk; Result is set if
+// true is returned
+bool ReachabilityIndex::isSameBlockQuery(const Instruction *A,
+                                         const Instruction *B,
+                                         bool &Result) const {
+  if (A->getParent() != B->getParent())
+    return false;
+  if (A == B || A->comesBefore(B))
+    Result = true;
+  else if (A->getParent() == &F.getEntryBlock())
+    Result = false;
+  else {
+    // The walk starts from the successors of the block and is done once it
+    // comes back to the block or gives up
+    unsigned BB = blockNumbers.lookup(A->getParent());
+    Result = large[BB] || std::binary_search(reachable[BB].begin(),
+                                             reachable[BB].end(), BB);
+  }
+  return true;
+}
+
+bool ReachabilityIndex::isPotentiallyReachable(const Instruction *A,
+                                               const Instruction *B) const {
+  assert(A->getFunction() == &F && B->getFunction() == &F &&
+         "Instructions of another function");
+  bool Result;
+  if (isSameBlockQuery(A, B, Result))
+    return Result;
+  return reaches(blockNumbers.lookup(A->getParent()),
+                 blockNumbers.lookup(B->getParent()));
+}
+
+bool ReachabilityIndex::isPotentiallyReachableAvoiding(
+    const Instruction *A, const Instruction *B,
+    const SmallPtrSetImpl<const BasicBlock *> &Blocks) {
+  // Excluding blocks only takes blocks out of the walk, so it cannot reach
+  // more than the walk without exclusions
+  if (!isPotentiallyReachable(A, B))
+    return false;
+
+  unsigned From = blockNumbers.lookup(A->getParent());
+  unsigned To = blockNumbers.lookup(B->getParent());
+  if (From == To && (A == B || A->comesBefore(B)))
+    return true;
+  // Nothing to avoid on the way; the walk is the one without exclusions
+  if (!large[From] &&
+      std::none_of(reachable[From].begin(), reachable[From].end(),
+                   [&](unsigned BB) {
+                     return BB != From && Blocks.count(blocks[BB]);
+                   }))
+    return true;
+
+  ++epoch;
+  if (From == To)
+    worklist.assign(successors[From].begin(), successors[From].end());
+  else
+    worklist.assign(1, From);
+  unsigned Limit = MaxBlocksToExplore;
+  while (!worklist.empty()) {
+    unsigned BB = worklist.pop_back_val();
+    if (stamps[BB] == epoch)
+      continue;
+    stamps[BB] = epoch;
+    if (BB == To)
+      return true;
+    if (BB != From && Blocks.count(blocks[BB]))
+      continue;
+    if (!--Limit)
+      return true;
+    worklist.append(successors[BB].begin(), successors[BB].end());
+  }
+  return false;
+}
@@ -10,6 +10,7 @@
 
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Demangle/Demangle.h" //for getting function base name
 #include "llvm/IR/Type.h"
@@ -19,7 +20,6 @@
 #include <algorithm> // for transform
 #include <ctype.h>
 #include <cxxabi.h>
-#include <functional> // for plus
 #include <iomanip>
 #include <queue>
 
@@ -27,13 +27,11 @@ using namespace llvm;
 using namespace IR2Vec;
 using abi::__cxa_demangle;
 
-Vector IR2Vec_Symbolic::getValue(std::string key) {
-  Vector vec(DIM, 0);
-  if (vocabulary.find(key) == vocabulary.end())
-    IR2VEC_DEBUG(errs() << "cannot find key in map : " << key << "\n");
-  else
-    vec = vocabulary[key];
-  return vec;
+const double *IR2Vec_Symbolic::getValue(unsigned entity) {
+  if (!vocabulary.hasEntity(entity))
+    IR2VEC_DEBUG(errs() << "cannot find entity in vocabulary : " << entity
+                        << "\n");
+  return vocabulary.getRow(entity);
 }
 
 void IR2Vec_Symbolic::generateSymbolicEncodings(std::ostream *o) {
@@ -43,15 +41,18 @@ void IR2Vec_Symbolic::generateSymbolicEncodings(std::ostream *o) {
       SmallVector<Function *, 15> funcStack;
       auto tmp = func2Vec(f, funcStack);
       funcVecMap[&f] = tmp;
-      if (level == 'f') {
-        res += updatedRes(tmp, &f, &M);
-        res += "\n";
+      if (config.level == 'f') {
+        if (table) {
+          table->add(getFunctionKey(&f, &M), tmp);
+        } else {
+          res += updatedRes(tmp, &f, &M);
+          res += "\n";
+        }
         noOfFunc++;
       }
 
       // else if (level == 'p') {
-      std::transform(pgmVector.begin(), pgmVector.end(), tmp.begin(),
-                     pgmVector.begin(), std::plus<double>());
+      kernels.add(pgmVector, tmp);
 
       // }
     }
@@ -59,23 +60,23 @@ void IR2Vec_Symbolic::generateSymbolicEncodings(std::ostream *o) {
 
   IR2VEC_DEBUG(errs() << "Number of functions written = " << noOfFunc << "\n");
 
-  if (level == 'p') {
-    if (cls != -1)
-      res += std::to_string(cls) + "\t";
+  if (config.level == 'p' && table) {
+    table->add(M.getSourceFileName(), pgmVector, config.cls);
+  } else if (config.level == 'p') {
+    if (config.cls != -1)
+      res += std::to_string(config.cls) + "\t";
 
-    for (auto i : pgmVector) {
-      if ((i <= 0.0001 && i > 0) || (i < 0 && i >= -0.0001)) {
-        i = 0;
-      }
+    auto printedVector = pgmVector;
+    kernels.clamp(printedVector);
+    for (auto i : printedVector)
       res += std::to_string(i) + "\t";
-    }
     res += "\n";
   }
 
   if (o)
     *o << res;
 
-  IR2VEC_DEBUG(errs() << "class = " << cls << "\n");
+  IR2VEC_DEBUG(errs() << "class = " << config.cls << "\n");
   IR2VEC_DEBUG(errs() << "res = " << res);
 }
 
@@ -90,9 +91,13 @@ void IR2Vec_Symbolic::generateSymbolicEncodingsForFunction(std::ostream *o,
       SmallVector<Function *, 15> funcStack;
       tmp = func2Vec(f, funcStack);
       funcVecMap[&f] = tmp;
-      if (level == 'f') {
-        res += updatedRes(tmp, &f, &M);
-        res += "\n";
+      if (config.level == 'f') {
+        if (table) {
+          table->add(getFunctionKey(&f, &M), tmp);
+        } else {
+          res += updatedRes(tmp, &f, &M);
+          res += "\n";
+        }
         noOfFunc++;
       }
     }
@@ -102,44 +107,96 @@ void IR2Vec_Symbolic::generateSymbolicEncodingsForFunction(std::ostream *o,
     *o << res;
 }
 
+Vector IR2Vec_Symbolic::generateFunctionEncoding(Function &F) {
+  SmallVector<Function *, 15> funcStack;
+  auto tmp = func2Vec(F, funcStack);
+  funcVecMap[&F] = tmp;
+  return tmp;
+}
+
+// Functions do not depend on each other, so only the vectors of the changed
+// functions are computed again
+void IR2Vec_Symbolic::updateSymbolicEncodings(
+    ArrayRef<Function *> changed, ArrayRef<const Function *> removed,
+    SmallMapVector<const Function *, Vector, 16> &updated) {
+  // Instructions and blocks encoded before may have been freed, and their
+  // addresses reused
+  instVecMap.clear();
+  bbVecMap.clear();
+
+  SmallPtrSet<const Function *, 16> dropped(removed.begin(), removed.end());
+  for (auto F : changed)
+    dropped.insert(F);
+  funcVecMap.remove_if(
+      [&](const auto &It) { return dropped.count(It.first) != 0; });
+
+  for (auto F : changed) {
+    if (F->isDeclaration() || funcVecMap.count(F))
+      continue;
+    SmallVector<Function *, 15> funcStack;
+    auto tmp = func2Vec(*F, funcStack);
+    funcVecMap[F] = tmp;
+    updated[F] = std::move(tmp);
+  }
+}
+
+void IR2Vec_Symbolic::takeVecMaps(
+    SmallMapVector<const Instruction *, Vector, 128> &instVecs,
+    SmallMapVector<const BasicBlock *, Vector, 16> &bbVecs) {
+  instVecs = std::move(instVecMap);
+  bbVecs = std::move(bbVecMap);
+  instVecMap.clear();
+  bbVecMap.clear();
+}
+
 Vector IR2Vec_Symbolic::func2Vec(Function &F,
                                  SmallVector<Function *, 15> &funcStack) {
   auto It = funcVecMap.find(&F);
   if (It != funcVecMap.end()) {
     return It->second;
   }
+
+  std::string cacheKey;
+  if (cache) {
+    cacheKey = cache->getKey(F);
+    EmbeddingCache::Entry entry;
+    if (cache->lookup(cacheKey, entry))
+      return entry.vector;
+  }
+
   funcStack.push_back(&F);
-  Vector funcVector(DIM, 0);
+  Vector funcVector(config.dim, 0);
   ReversePostOrderTraversal<Function *> RPOT(&F);
   MapVector<const BasicBlock *, double> cumulativeScore;
 
   for (auto *b : RPOT) {
     auto bbVector = bb2Vec(*b, funcStack);
 
-    Vector weightedBBVector;
-    weightedBBVector = bbVector;
-
-    std::transform(funcVector.begin(), funcVector.end(),
-                   weightedBBVector.begin(), funcVector.begin(),
-                   std::plus<double>());
-    bbVecMap[b] = weightedBBVector;
+    kernels.add(funcVector, bbVector);
+    bbVecMap[b] = std::move(bbVector);
   }
 
   funcStack.pop_back();
+  if (cache)
+    cache->insert(cacheKey, {funcVector});
   return funcVector;
 }
 
 Vector IR2Vec_Symbolic::bb2Vec(BasicBlock &B,
                                SmallVector<Function *, 15> &funcStack) {
+  PhaseScope scope(phaseTimes, Phase::BB2Vec);
   auto It = bbVecMap.find(&B);
   if (It != bbVecMap.end()) {
     return It->second;
   }
-  Vector bbVector(DIM, 0);
+  Vector bbVector(config.dim, 0);
 
+  // Summed in the scratch vector of the engine; only the vectors of the
+  // instructions with operands are kept
+  auto &instVector = instScratch;
   for (auto &I : B) {
-    Vector instVector(DIM, 0);
-    auto vec = getValue(I.getOpcodeName());
+    std::fill(instVector.begin(), instVector.end(), 0);
+    auto vec = getValue(getOpcodeEntity(I.getOpcode()));
     // if (isa<CallInst>(I)) {
     //   auto ci = dyn_cast<CallInst>(&I);
     //   // ci->dump();
@@ -166,95 +223,26 @@ Vector IR2Vec_Symbolic::bb2Vec(BasicBlock &B,
     //                          "not found==================\n");
     //   }
     // }
-    scaleVector(vec, WO);
-    std::transform(instVector.begin(), instVector.end(), vec.begin(),
-                   instVector.begin(), std::plus<double>());
-    auto type = I.getType();
+    kernels.addScaled(instVector, config.WO, vec);
 
-    if (type->isVoidTy()) {
-      vec = getValue("voidTy");
-    } else if (type->isFloatingPointTy()) {
-      vec = getValue("floatTy");
-    } else if (type->isIntegerTy()) {
-      vec = getValue("integerTy");
-    } else if (type->isFunctionTy()) {
-      vec = getValue("functionTy");
-    } else if (type->isStructTy()) {
-      vec = getValue("structTy");
-    } else if (type->isArrayTy()) {
-      vec = getValue("arrayTy");
-    } else if (type->isPointerTy()) {
-      vec = getValue("pointerTy");
-    } else if (type->isVectorTy()) {
-      vec = getValue("vectorTy");
-    } else if (type->isEmptyTy()) {
-      vec = getValue("emptyTy");
-    } else if (type->isLabelTy()) {
-      vec = getValue("labelTy");
-    } else if (type->isTokenTy()) {
-      vec = getValue("tokenTy");
-    } else if (type->isMetadataTy()) {
-      vec = getValue("metadataTy");
-    } else {
-      vec = getValue("unknownTy");
-    }
-
-    /*switch (I.getType()->getTypeID()) {
-    case 0:
-      vec = getValue("voidTy");
-      break;
-    case 1:
-    case 2:
-    case 3:
-    case 4:
-    case 5:
-    case 6:
-      vec = getValue("floatTy");
-      break;
-    case 11:
-      vec = getValue("integerTy");
-      break;
-    case 12:
-      vec = getValue("functionTy");
-      break;
-    case 13:
-      vec = getValue("structTy");
-      break;
-    case 14:
-      vec = getValue("arrayTy");
-      break;
-    case 15:
-      vec = getValue("pointerTy");
-      break;
-    case 16:
-      vec = getValue("vectorTy");
-      break;
-    default:
-      vec = getValue("unknownTy");
-    }*/
-
-    scaleVector(vec, WT);
-    std::transform(instVector.begin(), instVector.end(), vec.begin(),
-                   instVector.begin(), std::plus<double>());
+    vec = getValue(getTypeEntity(I.getType()));
+    kernels.addScaled(instVector, config.WT, vec);
     for (unsigned i = 0; i < I.getNumOperands(); i++) {
-      Vector vec;
       if (isa<Function>(I.getOperand(i))) {
-        vec = getValue("function");
+        vec = getValue(VOCAB_function);
       } else if (isa<PointerType>(I.getOperand(i)->getType())) {
-        vec = getValue("pointer");
+        vec = getValue(VOCAB_pointer);
       } else if (isa<Constant>(I.getOperand(i))) {
-        vec = getValue("constant");
+        vec = getValue(VOCAB_constant);
       } else {
-        vec = getValue("variable");
+        vec = getValue(VOCAB_variable);
       }
-      scaleVector(vec, WA);
 
-      std::transform(instVector.begin(), instVector.end(), vec.begin(),
-                     instVector.begin(), std::plus<double>());
-      instVecMap[&I] = instVector;
+      kernels.addScaled(instVector, config.WA, vec);
     }
-    std::transform(bbVector.begin(), bbVector.end(), instVector.begin(),
-                   bbVector.begin(), std::plus<double>());
+    if (I.getNumOperands())
+      instVecMap[&I] = instVector;
+    kernels.add(bbVector, instVector);
   }
   return bbVector;
 }
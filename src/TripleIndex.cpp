@@ -0,0 +1,207 @@
+//===- TripleIndex.cpp - OpenKE index files of CollectIR --------*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "TripleIndex.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+
+using namespace llvm;
+using namespace IR2Vec;
+
+static constexpr char tripleMagic[8] = {'I', 'R', '2', 'V', 'T', 'R', 'P', 0};
+static_assert(sizeof(TripleFileHeader) == 64,
+              "Triples of train2id.bin start at byte 64");
+static_assert(sizeof(IndexTriple) == 24, "Triples are three int64 ids");
+
+static void fail(const std::string &path, const std::string &message) {
+  errs() << path << ": " << message << "\n";
+  exit(1);
+}
+
+TripleIndex::TripleIndex(const std::string &dir)
+    : dir{dir}, tmpPath{dir + "/train2id.bin.new"} {
+  if (auto EC = sys::fs::create_directories(dir))
+    fail(dir, "cannot be created: " + EC.message());
+  readExisting();
+
+  out.open(tmpPath, std::ios_base::binary | std::ios_base::trunc);
+  if (!out)
+    fail(tmpPath, "cannot be opened for writing");
+}
+
+TripleIndex::~TripleIndex() {
+  if (out.is_open())
+    close();
+}
+
+// Takes the entities and relations of an existing index, whose triples are
+// copied on close
+void TripleIndex::readExisting() {
+  std::ifstream entities(dir + "/entity2id.txt");
+  if (!entities)
+    return;
+  if (!sys::fs::exists(dir + "/train2id.bin"))
+    fail(dir, "holds an index without train2id.bin; cannot append");
+
+  size_t entityCount = 0;
+  entities >> entityCount;
+  entityNames.resize(entityCount);
+  std::string name;
+  size_t id;
+  while (entities >> name >> id) {
+    if (id >= entityCount)
+      fail(dir + "/entity2id.txt", "has an id out of range");
+    entityNames[id] = name;
+    entityIds[name] = id;
+  }
+  if (entityIds.size() != entityCount)
+    fail(dir + "/entity2id.txt", "does not list as many entities as it holds");
+
+  std::ifstream relations(dir + "/relation2id.txt");
+  if (!(relations >> relationCount))
+    fail(dir + "/relation2id.txt", "cannot be read");
+
+  TripleFileHeader existing;
+  std::ifstream in(dir + "/train2id.bin", std::ios_base::binary);
+  if (!in.read(reinterpret_cast<char *>(&existing), sizeof(existing)) ||
+      std::memcmp(existing.magic, tripleMagic, sizeof(tripleMagic)) ||
+      existing.version != 1)
+    fail(dir + "/train2id.bin", "is not an IR2Vec triple file");
+  if (existing.entityCount != entityCount)
+    fail(dir + "/train2id.bin", "does not match entity2id.txt");
+  existingCount = existing.count;
+}
+
+int64_t TripleIndex::getEntity(StringRef name) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto It = entityIds.try_emplace(name, entityNames.size());
+  if (It.second)
+    entityNames.push_back(name.str());
+  return It.first->second;
+}
+
+void TripleIndex::write(ArrayRef<IndexTriple> triples, int64_t relations) {
+  std::lock_guard<std::mutex> lock(mutex);
+  out.write(reinterpret_cast<const char *>(triples.data()),
+            triples.size() * sizeof(IndexTriple));
+  count += triples.size();
+  relationCount = std::max(relationCount, relations);
+}
+
+void TripleIndex::close() {
+  out.close();
+  if (!out)
+    fail(tmpPath, "could not be written");
+
+  std::vector<int64_t> order(entityNames.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](int64_t a, int64_t b) {
+    return entityNames[a] < entityNames[b];
+  });
+  std::vector<int64_t> ids(order.size());
+  for (size_t i = 0; i < order.size(); i++)
+    ids[order[i]] = i;
+
+  std::string path = dir + "/train2id.bin";
+  std::ofstream index(path + ".tmp",
+                      std::ios_base::binary | std::ios_base::trunc);
+  TripleFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, tripleMagic, sizeof(tripleMagic));
+  header.version = 1;
+  header.count = existingCount + count;
+  header.entityCount = entityNames.size();
+  header.relationCount = relationCount;
+  index.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  // Copies the triples of a file with the final ids of their entities
+  std::vector<IndexTriple> buffer(1 << 16);
+  auto copy = [&](const std::string &from, uint64_t offset, uint64_t total) {
+    std::ifstream in(from, std::ios_base::binary);
+    in.seekg(offset);
+    while (total && in) {
+      auto chunk = std::min<uint64_t>(total, buffer.size());
+      in.read(reinterpret_cast<char *>(buffer.data()),
+              chunk * sizeof(IndexTriple));
+      chunk = in.gcount() / sizeof(IndexTriple);
+      for (uint64_t i = 0; i < chunk; i++) {
+        buffer[i].head = ids[buffer[i].head];
+        buffer[i].tail = ids[buffer[i].tail];
+      }
+      index.write(reinterpret_cast<const char *>(buffer.data()),
+                  chunk * sizeof(IndexTriple));
+      total -= chunk;
+    }
+    if (total)
+      fail(from, "is truncated");
+  };
+  copy(path, sizeof(header), existingCount);
+  copy(tmpPath, 0, count);
+  index.close();
+  if (!index)
+    fail(path + ".tmp", "could not be written");
+
+  std::ofstream entities(dir + "/entity2id.txt.tmp", std::ios_base::trunc);
+  entities << order.size() << "\n";
+  for (size_t i = 0; i < order.size(); i++)
+    entities << entityNames[order[i]] << "\t" << i << "\n";
+  entities.close();
+
+  std::ofstream relations(dir + "/relation2id.txt.tmp", std::ios_base::trunc);
+  relations << relationCount << "\n";
+  relations << "Type\t" << TypeRelation << "\n";
+  relations << "Next\t" << NextRelation << "\n";
+  for (int64_t i = FirstArgRelation; i < relationCount; i++)
+    relations << "Arg" << i - FirstArgRelation << "\t" << i << "\n";
+  relations.close();
+  if (!entities || !relations)
+    fail(dir, "index files could not be written");
+
+  for (auto name : {"/train2id.bin", "/entity2id.txt", "/relation2id.txt"})
+    if (auto EC = sys::fs::rename(dir + name + ".tmp", dir + name))
+      fail(dir + name, "cannot be replaced: " + EC.message());
+  std::remove(tmpPath.c_str());
+}
+
+int64_t TripleStream::getEntity(StringRef name) {
+  auto It = entities.find(name);
+  if (It != entities.end())
+    return It->second;
+  int64_t id = index.getEntity(name);
+  entities[name] = id;
+  return id;
+}
+
+void TripleStream::add(ArrayRef<StringRef> tokens) {
+  int64_t opcode = getEntity(tokens[0]);
+  if (previous >= 0)
+    triples.push_back({previous, NextRelation, opcode});
+  previous = opcode;
+
+  triples.push_back({opcode, TypeRelation, getEntity(tokens[1])});
+  for (size_t i = 2; i < tokens.size(); i++)
+    triples.push_back(
+        {opcode, FirstArgRelation + int64_t(i - 2), getEntity(tokens[i])});
+  relations =
+      std::max(relations, FirstArgRelation + int64_t(tokens.size()) - 2);
+
+  if (triples.size() >= BufferSize)
+    flush();
+}
+
+void TripleStream::flush() {
+  if (triples.empty())
+    return;
+  index.write(triples, relations);
+  triples.clear();
+}
@@ -0,0 +1,253 @@
+//===- VectorOps.cpp - Kernels for arithmetic on embeddings -----*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+// This file is compiled with -ffp-contract=off: a fused multiply-add rounds
+// once where the scalar kernels round twice, which would make the embeddings
+// depend on the machine they are generated on.
+
+#include "VectorOps.h"
+
+#include <cstddef>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define IR2VEC_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace IR2Vec;
+
+namespace {
+
+constexpr double clampLimit = 0.0001;
+
+// Kernels are instantiated for a length N known at compile time, or for the
+// length n they are called with if N is 0
+template <size_t N> constexpr size_t length(size_t n) { return N ? N : n; }
+
+template <size_t N> void addScalar(double *dst, const double *src, size_t n) {
+  n = length<N>(n);
+  for (size_t i = 0; i < n; i++)
+    dst[i] = dst[i] + src[i];
+}
+
+template <size_t N>
+void addScaledScalar(double *dst, double factor, const double *src, size_t n) {
+  n = length<N>(n);
+  for (size_t i = 0; i < n; i++)
+    dst[i] = dst[i] + src[i] * factor;
+}
+
+template <size_t N> void scaleScalar(double *dst, double factor, size_t n) {
+  n = length<N>(n);
+  for (size_t i = 0; i < n; i++)
+    dst[i] = dst[i] * factor;
+}
+
+// -0.0 and NaN are kept as they are
+template <size_t N> void clampScalar(double *dst, size_t n) {
+  n = length<N>(n);
+  for (size_t i = 0; i < n; i++)
+    if ((dst[i] <= clampLimit && dst[i] > 0) ||
+        (dst[i] < 0 && dst[i] >= -clampLimit))
+      dst[i] = 0;
+}
+
+#ifdef IR2VEC_X86_KERNELS
+
+template <size_t N>
+__attribute__((target("sse2"))) void addSSE2(double *dst, const double *src,
+                                             size_t n) {
+  n = length<N>(n);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(dst + i,
+                  _mm_add_pd(_mm_loadu_pd(dst + i), _mm_loadu_pd(src + i)));
+  addScalar<N % 2>(dst + i, src + i, n - i);
+}
+
+template <size_t N>
+__attribute__((target("sse2"))) void
+addScaledSSE2(double *dst, double factor, const double *src, size_t n) {
+  n = length<N>(n);
+  __m128d f = _mm_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(dst + i,
+                  _mm_add_pd(_mm_loadu_pd(dst + i),
+                             _mm_mul_pd(_mm_loadu_pd(src + i), f)));
+  addScaledScalar<N % 2>(dst + i, factor, src + i, n - i);
+}
+
+template <size_t N>
+__attribute__((target("sse2"))) void scaleSSE2(double *dst, double factor,
+                                               size_t n) {
+  n = length<N>(n);
+  __m128d f = _mm_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(dst + i), f));
+  scaleScalar<N % 2>(dst + i, factor, n - i);
+}
+
+template <size_t N>
+__attribute__((target("sse2"))) void clampSSE2(double *dst, size_t n) {
+  n = length<N>(n);
+  __m128d zero = _mm_setzero_pd();
+  __m128d hi = _mm_set1_pd(clampLimit), lo = _mm_set1_pd(-clampLimit);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d x = _mm_loadu_pd(dst + i);
+    __m128d small =
+        _mm_or_pd(_mm_and_pd(_mm_cmple_pd(x, hi), _mm_cmpgt_pd(x, zero)),
+                  _mm_and_pd(_mm_cmplt_pd(x, zero), _mm_cmpge_pd(x, lo)));
+    _mm_storeu_pd(dst + i, _mm_andnot_pd(small, x));
+  }
+  clampScalar<N % 2>(dst + i, n - i);
+}
+
+template <size_t N>
+__attribute__((target("avx2"))) void addAVX2(double *dst, const double *src,
+                                             size_t n) {
+  n = length<N>(n);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_loadu_pd(dst + i),
+                                            _mm256_loadu_pd(src + i)));
+  addScalar<N % 4>(dst + i, src + i, n - i);
+}
+
+template <size_t N>
+__attribute__((target("avx2"))) void
+addScaledAVX2(double *dst, double factor, const double *src, size_t n) {
+  n = length<N>(n);
+  __m256d f = _mm256_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(dst + i,
+                     _mm256_add_pd(_mm256_loadu_pd(dst + i),
+                                   _mm256_mul_pd(_mm256_loadu_pd(src + i), f)));
+  addScaledScalar<N % 4>(dst + i, factor, src + i, n - i);
+}
+
+template <size_t N>
+__attribute__((target("avx2"))) void scaleAVX2(double *dst, double factor,
+                                               size_t n) {
+  n = length<N>(n);
+  __m256d f = _mm256_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(dst + i), f));
+  scaleScalar<N % 4>(dst + i, factor, n - i);
+}
+
+template <size_t N>
+__attribute__((target("avx2"))) void clampAVX2(double *dst, size_t n) {
+  n = length<N>(n);
+  __m256d zero = _mm256_setzero_pd();
+  __m256d hi = _mm256_set1_pd(clampLimit), lo = _mm256_set1_pd(-clampLimit);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d x = _mm256_loadu_pd(dst + i);
+    __m256d small = _mm256_or_pd(
+        _mm256_and_pd(_mm256_cmp_pd(x, hi, _CMP_LE_OQ),
+                      _mm256_cmp_pd(x, zero, _CMP_GT_OQ)),
+        _mm256_and_pd(_mm256_cmp_pd(x, zero, _CMP_LT_OQ),
+                      _mm256_cmp_pd(x, lo, _CMP_GE_OQ)));
+    _mm256_storeu_pd(dst + i, _mm256_andnot_pd(small, x));
+  }
+  clampScalar<N % 4>(dst + i, n - i);
+}
+
+template <size_t N>
+__attribute__((target("avx512f"))) void addAVX512(double *dst,
+                                                  const double *src, size_t n) {
+  n = length<N>(n);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm512_storeu_pd(dst + i, _mm512_add_pd(_mm512_loadu_pd(dst + i),
+                                            _mm512_loadu_pd(src + i)));
+  addScalar<N % 8>(dst + i, src + i, n - i);
+}
+
+template <size_t N>
+__attribute__((target("avx512f"))) void
+addScaledAVX512(double *dst, double factor, const double *src, size_t n) {
+  n = length<N>(n);
+  __m512d f = _mm512_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm512_storeu_pd(dst + i,
+                     _mm512_add_pd(_mm512_loadu_pd(dst + i),
+                                   _mm512_mul_pd(_mm512_loadu_pd(src + i), f)));
+  addScaledScalar<N % 8>(dst + i, factor, src + i, n - i);
+}
+
+template <size_t N>
+__attribute__((target("avx512f"))) void scaleAVX512(double *dst, double factor,
+                                                    size_t n) {
+  n = length<N>(n);
+  __m512d f = _mm512_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm512_storeu_pd(dst + i, _mm512_mul_pd(_mm512_loadu_pd(dst + i), f));
+  scaleScalar<N % 8>(dst + i, factor, n - i);
+}
+
+template <size_t N>
+__attribute__((target("avx512f"))) void clampAVX512(double *dst, size_t n) {
+  n = length<N>(n);
+  __m512d zero = _mm512_setzero_pd();
+  __m512d hi = _mm512_set1_pd(clampLimit), lo = _mm512_set1_pd(-clampLimit);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512d x = _mm512_loadu_pd(dst + i);
+    __mmask8 small = (_mm512_cmp_pd_mask(x, hi, _CMP_LE_OQ) &
+                      _mm512_cmp_pd_mask(x, zero, _CMP_GT_OQ)) |
+                     (_mm512_cmp_pd_mask(x, zero, _CMP_LT_OQ) &
+                      _mm512_cmp_pd_mask(x, lo, _CMP_GE_OQ));
+    _mm512_storeu_pd(dst + i, _mm512_mask_mov_pd(x, small, zero));
+  }
+  clampScalar<N % 8>(dst + i, n - i);
+}
+
+#endif
+
+template <size_t N> VectorKernels selectKernels() {
+#ifdef IR2VEC_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return {N, addAVX512<N>, addScaledAVX512<N>, scaleAVX512<N>,
+            clampAVX512<N>};
+  if (__builtin_cpu_supports("avx2"))
+    return {N, addAVX2<N>, addScaledAVX2<N>, scaleAVX2<N>, clampAVX2<N>};
+  if (__builtin_cpu_supports("sse2"))
+    return {N, addSSE2<N>, addScaledSSE2<N>, scaleSSE2<N>, clampSSE2<N>};
+#endif
+  return {N, addScalar<N>, addScaledScalar<N>, scaleScalar<N>,
+          clampScalar<N>};
+}
+
+template <size_t N> const VectorKernels &getKernels() {
+  static const VectorKernels kernels = selectKernels<N>();
+  return kernels;
+}
+
+} // namespace
+
+const VectorKernels &IR2Vec::getVectorKernels(unsigned dim) {
+  switch (dim) {
+  case 75:
+    return getKernels<75>();
+  case 100:
+    return getKernels<100>();
+  case 300:
+    return getKernels<300>();
+  default:
+    return getKernels<0>();
+  }
+}
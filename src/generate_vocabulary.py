@@ -25,6 +25,33 @@ HEADER_VOCABULARY_CLASS = (
 )
 HEADER_CLANG_FORMAT_OFF = "// clang-format off\n"
 
+# Entities that IR2Vec looks up in a vocabulary, in row order. Every generated
+# vocabulary stores one row per entity, so the position of an entity in this
+# list is its compile-time ID. Entities that a seed vocabulary does not define
+# get a zero row and are reported as absent. The opcodes are the names that
+# Instruction::getOpcodeName gives to all the opcodes of LLVM 20, so that the
+# vocabularies trained on collectIR triplets are read in full.
+# fmt: off
+ENTITIES = [
+    # Opcodes
+    "add", "addrspacecast", "alloca", "and", "ashr", "atomicrmw", "bitcast",
+    "br", "call", "callbr", "catchpad", "catchret", "catchswitch", "cleanuppad",
+    "cleanupret", "cmpxchg", "extractelement", "extractvalue", "fadd", "fcmp",
+    "fdiv", "fence", "fmul", "fneg", "fpext", "fptosi", "fptoui", "fptrunc",
+    "freeze", "frem", "fsub", "getelementptr", "icmp", "indirectbr",
+    "insertelement", "insertvalue", "inttoptr", "invoke", "landingpad", "load",
+    "lshr", "mul", "or", "phi", "ptrtoint", "resume", "ret", "sdiv", "select",
+    "sext", "shl", "shufflevector", "sitofp", "srem", "store", "sub", "switch",
+    "trunc", "udiv", "uitofp", "unreachable", "urem", "va_arg", "xor", "zext",
+    # Types
+    "voidTy", "floatTy", "integerTy", "functionTy", "structTy", "arrayTy",
+    "pointerTy", "vectorTy", "emptyTy", "labelTy", "tokenTy", "metadataTy",
+    "unknownTy",
+    # Operands
+    "function", "pointer", "constant", "label", "variable",
+]
+# fmt: on
+
 
 def write_file(file_path, content):
     try:
@@ -48,10 +75,42 @@ def generate_base_vocabulary_header():
         "#include <stdexcept> // For std::invalid_argument\n"
         "namespace IR2Vec {\n\n"
         "using Vector = std::vector<double>;\n\n"
+        "// Row of each entity in the vocabulary matrix. Lookups that do not\n"
+        "// resolve to an entity yield NUM_VOCAB_ENTITIES, whose row is all zeros.\n"
+        "enum VocabEntity : unsigned {\n"
+        f"{generate_entity_enumerators()}"
+        "    NUM_VOCAB_ENTITIES\n"
+        "};\n\n"
+        "inline constexpr const char *VocabEntityNames[NUM_VOCAB_ENTITIES] = {\n"
+        f"{generate_entity_names()}"
+        "};\n\n"
         "class VocabularyBase {\n"
         "public:\n"
         "    virtual ~VocabularyBase() {}\n"
-        "    virtual const std::map<std::string, IR2Vec::Vector>& getVocabulary() const = 0;\n"
+        "    virtual const std::map<std::string, IR2Vec::Vector>& getVocabulary() const = 0;\n\n"
+        "    unsigned getDimension() const { return dim; }\n\n"
+        "    // Returns true if the seed vocabulary defines a row for the entity\n"
+        "    bool hasEntity(unsigned entity) const { return present[entity]; }\n\n"
+        "    // Returns the row of the entity; rows of absent entities are zeros\n"
+        "    const double *getRow(unsigned entity) const {\n"
+        "        return matrix + entity * dim;\n"
+        "    }\n\n"
+        "protected:\n"
+        "    VocabularyBase(const double *matrix, const bool *present, unsigned dim)\n"
+        "        : matrix(matrix), present(present), dim(dim) {}\n\n"
+        "    // Builds the key-value view of a vocabulary matrix\n"
+        "    std::map<std::string, IR2Vec::Vector> toMap() const {\n"
+        "        std::map<std::string, IR2Vec::Vector> vocabulary;\n"
+        "        for (unsigned e = 0; e < NUM_VOCAB_ENTITIES; e++)\n"
+        "            if (present[e])\n"
+        "                vocabulary[VocabEntityNames[e]] =\n"
+        "                    IR2Vec::Vector(getRow(e), getRow(e) + dim);\n"
+        "        return vocabulary;\n"
+        "    }\n\n"
+        "private:\n"
+        "    const double *matrix;\n"
+        "    const bool *present;\n"
+        "    unsigned dim;\n"
         "};\n\n"
         "class VocabularyFactory {\n"
         "public:\n"
@@ -62,7 +121,36 @@ def generate_base_vocabulary_header():
     )
 
 
+def generate_entity_enumerators():
+    return "".join(f"    VOCAB_{entity},\n" for entity in ENTITIES)
+
+
+def generate_entity_names():
+    return "".join(f'    "{entity}",\n' for entity in ENTITIES)
+
+
+def read_vocabulary(vocab_file):
+    rows = {}
+    with open(vocab_file, "r") as fr:
+        for line in fr.readlines():
+            key, val = line.strip().split(":")
+            if key not in ENTITIES:
+                # Rows of entities IR2Vec never looks up are of no use, but
+                # must not keep a retrained vocabulary from being built in
+                sys.stderr.write(
+                    f"Warning: skipping unknown entity {key} in {vocab_file}\n"
+                )
+                continue
+            e = val.find("]")
+            rows[key] = val[1:e]
+    return rows
+
+
 def generate_vocabulary_class(vocab_file, class_name):
+    dim = class_name.replace("Vocabulary", "").replace("D", "")
+    rows = read_vocabulary(vocab_file)
+    zeros = ", ".join(["0"] * int(dim))
+
     class_header = (
         f"{HEADER_GENERATED}"
         f"{HEADER_VOCABULARY_CLASS.format(class_name=class_name)}"
@@ -76,40 +164,40 @@ def generate_vocabulary_class(vocab_file, class_name):
         f"namespace IR2Vec {{\n\n"
         f"class {class_name} : public VocabularyBase {{\n"
         f"public:\n"
+        f"    {class_name}() : VocabularyBase(vectors, defined, {dim}) {{}}\n\n"
         f"    const std::map<std::string, IR2Vec::Vector>& getVocabulary() const override{{\n"
+        f"        static const std::map<std::string, IR2Vec::Vector> vocabulary = toMap();\n"
         f"        return vocabulary;\n"
         f"    }}\n"
         f"private:\n"
-        f"    static const std::map<std::string, IR2Vec::Vector> vocabulary;\n"
-        f"}};\n"
     )
 
-    opening = (
-        f"\nconst std::map<std::string, IR2Vec::Vector> {class_name}::vocabulary = {{\n"
+    # One row per entity followed by the zero row of NUM_VOCAB_ENTITIES
+    matrix_rows = ""
+    present_flags = ""
+    for entity in ENTITIES:
+        matrix_rows += f"        /* {entity} */ {rows.get(entity, zeros)},\n"
+        present_flags += (
+            f"        {'true' if entity in rows else 'false'}, // {entity}\n"
+        )
+    matrix_rows += f"        /* none */ {zeros}\n"
+    present_flags += "        false\n"
+
+    matrix = (
+        f"    alignas(64) static constexpr double vectors[(NUM_VOCAB_ENTITIES + 1) * {dim}] = {{\n"
+        f"{matrix_rows}"
+        f"    }};\n"
+        f"    static constexpr bool defined[NUM_VOCAB_ENTITIES + 1] = {{\n"
+        f"{present_flags}"
+        f"    }};\n"
     )
-    closing = """\
-};
-} // namespace IR2Vec
+    closing = f"""\
+}};
+}} // namespace IR2Vec
 
 #endif // __{class_name.upper()}__
 """
-    dim = class_name.replace("Vocabulary", "")
-    vector_definitions = ""
-    with open(vocab_file, "r") as fr:
-        for line in fr.readlines():
-            key, val = line.strip().split(":")
-            e = val.find("]")
-            vector_definitions += (
-                f"const IR2Vec::Vector {key}_vector_{dim} = {{  {val[1:e]} }};\n"
-            )
-
-    vocabulary_entries = ""
-    with open(vocab_file, "r") as fr:
-        for line in fr.readlines():
-            key, _ = line.strip().split(":")
-            vocabulary_entries += f'    {{ "{key}", {key}_vector_{dim} }},\n'
-
-    return class_header + vector_definitions + opening + vocabulary_entries + closing
+    return class_header + matrix + closing
 
 
 def generate_vocabulary_factory(class_names):
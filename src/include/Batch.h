@@ -0,0 +1,116 @@
+//===- Batch.h - Encoding a corpus of IR files in one process ---*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __IR2Vec_BATCH_H__
+#define __IR2Vec_BATCH_H__
+
+#include "BoundedQueue.h"
+#include "EmbeddingCache.h"
+#include "EmbeddingWriter.h"
+#include "TripleIndex.h"
+#include "utils.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace IR2Vec {
+
+// A worker starts over with a fresh LLVMContext after these many modules, as
+// types and constants of parsed modules are never freed by a context
+constexpr unsigned ModulesPerContext = 256;
+
+// IR file read by the first stage of a batch
+struct BatchInput {
+  size_t index;
+  std::string path;
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+  std::string error;
+};
+
+} // namespace IR2Vec
+
+// Encodes the IR files of a directory or of a list file with the mode of the
+// command line and the given configuration. Files are read by one thread,
+// parsed and encoded by a pool of config.threads workers each owning an
+// LLVMContext, and the results are appended to the output files in input
+// order by the calling thread
+class BatchEncoder {
+
+private:
+  struct Result {
+    size_t index;
+    std::string out;
+    std::string missCount;
+    std::string cyclicCount;
+    IR2Vec::EmbeddingTable table;
+    std::string error;
+  };
+
+  const IR2Vec::VocabularyBase &vocabulary;
+  const IR2Vec::Config config;
+  unsigned workers;
+  // Receives the embeddings in the binary formats; text output if null
+  IR2Vec::EmbeddingWriter *writer;
+  const IR2Vec::EmbeddingCache *cache;
+  std::vector<std::string> paths;
+
+  IR2Vec::BoundedQueue<IR2Vec::BatchInput> inputs;
+  IR2Vec::BoundedQueue<Result> results;
+  // Holds a token per file that may be in flight, which bounds the results
+  // kept back by the writer for the output to stay in input order
+  IR2Vec::BoundedQueue<char> window;
+
+  void readInputs();
+  void encodeInputs();
+  void encode(llvm::Module &M, Result &result);
+
+public:
+  BatchEncoder(const std::string &batchPath,
+               const IR2Vec::VocabularyBase &vocab,
+               const IR2Vec::Config &config,
+               IR2Vec::EmbeddingWriter *writer = nullptr,
+               const IR2Vec::EmbeddingCache *cache = nullptr);
+
+  // Returns the number of files that could not be encoded
+  unsigned run();
+
+  size_t size() const { return paths.size(); }
+};
+
+// Collects the triplets of the IR files of a directory or of a list file, for
+// training the seed vocabulary. Files are read by one thread and parsed on
+// config.threads workers, each of which streams the triplets of the files it
+// takes to an output file of its own, <output>.<worker>; a single worker
+// appends to <output> in input order. The triplets of a file are contiguous,
+// but which shard holds them depends on the order the workers take the files.
+// Given an index, the workers add the triples of the files to it instead
+class BatchCollector {
+
+private:
+  const IR2Vec::Config config;
+  unsigned workers;
+  IR2Vec::TripleIndex *index;
+  std::vector<std::string> paths;
+  IR2Vec::BoundedQueue<IR2Vec::BatchInput> inputs;
+
+  // Returns the number of files of the worker that could not be collected
+  unsigned collectInputs(const std::string &shard, std::string &errors);
+
+public:
+  BatchCollector(const std::string &batchPath, const IR2Vec::Config &config,
+                 IR2Vec::TripleIndex *index = nullptr);
+
+  // Returns the number of files that could not be collected
+  unsigned run(const std::string &output);
+
+  size_t size() const { return paths.size(); }
+};
+
+#endif
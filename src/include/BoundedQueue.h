@@ -0,0 +1,68 @@
+//===- BoundedQueue.h - Blocking queue of bounded capacity ------*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __IR2Vec_BOUNDED_QUEUE_H__
+#define __IR2Vec_BOUNDED_QUEUE_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace IR2Vec {
+
+// Multi-producer multi-consumer queue connecting the stages of a pipeline.
+// Producers block while the queue is full, so that a fast stage cannot run
+// arbitrarily far ahead of a slow one
+template <typename T> class BoundedQueue {
+  std::deque<T> items;
+  std::size_t capacity;
+  bool closed = false;
+  std::mutex mutex;
+  std::condition_variable notFull, notEmpty;
+
+public:
+  explicit BoundedQueue(std::size_t capacity)
+      : capacity{capacity ? capacity : 1} {}
+
+  // Returns false without queueing item if the queue has been closed
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+    if (closed)
+      return false;
+    items.push_back(std::move(item));
+    notEmpty.notify_one();
+    return true;
+  }
+
+  // Returns false once the queue has been closed and drained
+  bool pop(T &item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+    if (items.empty())
+      return false;
+    item = std::move(items.front());
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+  // Wakes up all waiting producers and consumers; items already queued are
+  // still handed out by pop
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    notFull.notify_all();
+    notEmpty.notify_all();
+  }
+};
+
+} // namespace IR2Vec
+
+#endif
@@ -9,26 +9,42 @@
 #ifndef __COLLECT_IR__
 #define __COLLECT_IR__
 
+#include "TripleIndex.h"
 #include "utils.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 #include <fstream>
 #include <map>
 
+// Writes the opcode, type and operand kinds of each instruction of a module
+// as a line of triplets. Triplets are streamed to the output a few basic
+// blocks at a time, so that memory does not grow with the size of the module
 class CollectIR {
 
 private:
+  // Triplets are written out once this much has been buffered
+  static constexpr size_t BufferSize = 1 << 16;
+
   void collectData();
   std::string res;
   llvm::Module &M;
+  const IR2Vec::Config config;
 
   void traverseBasicBlock(llvm::BasicBlock &B);
+  void getTokens(llvm::Instruction &I,
+                 llvm::SmallVectorImpl<llvm::StringRef> &tokens);
 
 public:
-  CollectIR(std::unique_ptr<llvm::Module> &M) : M{*M} { res = ""; }
+  CollectIR(llvm::Module &M, const IR2Vec::Config &config)
+      : M{M}, config{config} {
+    res.reserve(BufferSize);
+  }
 
   void generateTriplets(std::ostream &out);
+  // Adds the triples of the OpenKE index instead of the text triplets
+  void generateTriplets(IR2Vec::TripleStream &out);
 };
 
 #endif
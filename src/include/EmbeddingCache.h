@@ -0,0 +1,70 @@
+//===- EmbeddingCache.h - On-disk cache of function embeddings --*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __IR2Vec_EMBEDDING_CACHE_H__
+#define __IR2Vec_EMBEDDING_CACHE_H__
+
+#include "VectorOps.h"
+#include "Vocabulary.h"
+#include "utils.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/Support/Error.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace IR2Vec {
+
+// Caches the vectors computed by func2Vec in a directory, keyed by a hash of
+// the structure of the function along with the mode, dimension, weights and
+// vocabulary of the run. Every entry is a file of its own, written to a
+// temporary file and renamed in place, so that any number of processes and
+// threads can share a directory. Least recently used entries are removed
+// once the directory grows over its size limit.
+//
+// Entries only hold function vectors: the instruction and basic block
+// vectors of a function taken from the cache are not computed.
+class EmbeddingCache {
+
+public:
+  struct Entry {
+    Vector vector;
+    // Counters of the run the vector was computed in, added to the ones of
+    // the runs that take it from the cache
+    uint32_t missCount = 0;
+    uint32_t cyclicCount = 0;
+  };
+
+  // Creates dir if it does not exist; fails if it cannot be created
+  static llvm::Expected<std::unique_ptr<EmbeddingCache>>
+  create(const std::string &dir, char mode, const VocabularyBase &vocabulary,
+         const Config &config, uint64_t maxSizeBytes);
+  // Prunes the directory
+  ~EmbeddingCache();
+
+  std::string getKey(const llvm::Function &F) const;
+  bool lookup(const std::string &key, Entry &entry) const;
+  void insert(const std::string &key, const Entry &entry) const;
+
+private:
+  std::string dir;
+  unsigned dim;
+  uint64_t maxSizeBytes;
+  // Hash of the configuration every key starts with
+  std::string prefix;
+
+  EmbeddingCache(const std::string &dir, char mode,
+                 const VocabularyBase &vocabulary, const Config &config,
+                 uint64_t maxSizeBytes);
+  std::string getPath(const std::string &key) const;
+};
+
+} // namespace IR2Vec
+
+#endif
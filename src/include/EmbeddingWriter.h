@@ -0,0 +1,118 @@
+//===- EmbeddingWriter.h - Binary output of embeddings ----------*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __IR2Vec_EMBEDDING_WRITER_H__
+#define __IR2Vec_EMBEDDING_WRITER_H__
+
+#include "VectorOps.h"
+#include "Vocabulary.h"
+#include "utils.h"
+
+#include "llvm/Support/Error.h"
+#include <cstdint>
+#include <memory>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace IR2Vec {
+
+// Embeddings of the programs (level p) or functions (level f) of a run, keyed
+// like in the text output: SourceFileName for programs and
+// SourceFileName__demangledName for functions
+struct EmbeddingTable {
+  std::vector<std::string> keys;
+  // Class of the program-level embeddings; -1 if not given
+  std::vector<int32_t> labels;
+  // Row-major, one row per key
+  std::vector<double> values;
+
+  void add(std::string key, const Vector &vec, int32_t label = -1) {
+    keys.push_back(std::move(key));
+    labels.push_back(label);
+    values.insert(values.end(), vec.begin(), vec.end());
+  }
+
+  size_t size() const { return keys.size(); }
+};
+
+enum class OutputFormat { Text, Bin, Npy };
+
+// Layout of the -format=bin files, in little-endian byte order on every host:
+//   BinaryHeader
+//   rows x dim values, in float or double as given by elementSize
+//   rows int32 labels
+//   rows + 1 uint64 offsets of the keys within the key bytes
+//   key bytes, without terminators
+// Each section starts at a multiple of 64 bytes, so that a file can be
+// mapped and the matrix used in place. Unlike the text output, the values
+// are written unrounded.
+struct BinaryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t dim;
+  uint64_t rows;
+  char mode;  // 's' for symbolic, 'f' for flow-aware
+  char level; // 'p' or 'f'
+  uint8_t elementSize;
+  uint8_t reserved[5];
+  float WO, WA, WT;
+  uint32_t reserved2;
+  // FNV-1a hash of the rows of the vocabulary the embeddings are built with
+  uint64_t vocabularyHash;
+  uint64_t matrixOffset;
+  uint64_t labelsOffset;
+  uint64_t keyOffsetsOffset;
+  uint64_t keysOffset;
+  uint64_t fileSize;
+};
+
+// Writes embedding tables to a -format=bin file, or to a .npy file of the
+// matrix along with a <path>.keys file of "key[\tlabel]" lines, in which the
+// backslashes, tabs and newlines of keys are escaped as \\, \t and \n. Rows
+// are streamed to disk as they are written; the keys are kept until close.
+// Like the text output, an existing file of the same configuration is
+// appended to. Errors are returned to the caller, which decides whether to
+// exit.
+class EmbeddingWriter {
+
+private:
+  std::string path;
+  std::string tmpPath;
+  OutputFormat format;
+  BinaryHeader header;
+  std::ofstream out;
+  std::vector<std::string> keys;
+  std::vector<int32_t> labels;
+
+  EmbeddingWriter(const std::string &path, OutputFormat format, char mode,
+                  const VocabularyBase &vocabulary, const Config &config,
+                  bool singlePrecision);
+  llvm::Error open();
+  llvm::Error readExisting();
+  void writeNpyHeader();
+
+public:
+  static llvm::Expected<std::unique_ptr<EmbeddingWriter>>
+  create(const std::string &path, OutputFormat format, char mode,
+         const VocabularyBase &vocabulary, const Config &config,
+         bool singlePrecision);
+  // Removes the temporary file if the writer was not closed; path is left as
+  // it was
+  ~EmbeddingWriter();
+
+  void write(const EmbeddingTable &table);
+  // Writes the keys and the final header, and moves the file in place
+  llvm::Error close();
+};
+
+uint64_t getVocabularyHash(const VocabularyBase &vocabulary);
+
+} // namespace IR2Vec
+
+#endif
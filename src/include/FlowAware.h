@@ -9,33 +9,52 @@
 #ifndef __IR2Vec_FA_H__
 #define __IR2Vec_FA_H__
 
+#include "EmbeddingCache.h"
+#include "EmbeddingWriter.h"
+#include "PhaseTimer.h"
+#include "Reachability.h"
 #include "utils.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallSet.h"
-#include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
+#include <array>
 #include <fstream>
+#include <memory>
 #include <unordered_map>
 
 class IR2Vec_FA {
 
 private:
   llvm::Module &M;
+  const IR2Vec::Config config;
   std::string res;
-  IR2Vec::VocabTy &vocabulary;
+  const IR2Vec::VocabularyBase &vocabulary;
+  // Kernels specialized for the dimension of the vocabulary
+  const IR2Vec::VectorKernels &kernels;
   IR2Vec::Vector pgmVector;
+  // Receives the embeddings instead of the text output if set
+  IR2Vec::EmbeddingTable *table = nullptr;
+  // Function vectors are looked up in and added to the cache if set
+  const IR2Vec::EmbeddingCache *cache = nullptr;
+  // Receives the time spent in each phase if set
+  IR2Vec::PhaseTimes *phaseTimes = nullptr;
   unsigned dataMissCounter;
   unsigned cyclicCounter;
 
-  llvm::SmallDenseMap<llvm::StringRef, unsigned> memWriteOps;
+  // Pointer operand of memory instructions indexed by opcode; -1 for others
+  using MemOpTable = std::array<int, llvm::Instruction::OtherOpsEnd>;
+  MemOpTable memWriteOps;
   llvm::SmallDenseMap<const llvm::Instruction *, bool> livelinessMap;
-  llvm::SmallDenseMap<llvm::StringRef, unsigned> memAccessOps;
+  MemOpTable memAccessOps;
 
   llvm::SmallMapVector<const llvm::Instruction *, IR2Vec::Vector, 128>
       instVecMap;
@@ -46,10 +65,32 @@ private:
                        llvm::SmallVector<const llvm::Function *, 10>, 16>
       funcCallMap;
 
+  // Reverse funcCallMap, and the vectors of the functions before the ones of
+  // their callees are added, to update the callers of the functions that are
+  // encoded again
+  llvm::DenseMap<const llvm::Function *,
+                 llvm::SmallVector<const llvm::Function *, 4>>
+      callerMap;
+  llvm::DenseMap<const llvm::Function *, IR2Vec::Vector> funcBodyVecMap;
+
+  // Functions whose write definitions and callees are collected; functions
+  // are analyzed before they are encoded, so that encoding a single function
+  // only analyzes the functions it calls
+  llvm::SmallPtrSet<const llvm::Function *, 16> analyzedFunctions;
+
   llvm::SmallMapVector<const llvm::Instruction *,
                        llvm::SmallVector<const llvm::Instruction *, 10>, 16>
       writeDefsMap;
 
+  // Write definitions of the module; points to writeDefsMap of the instance
+  // that collected them, which per-function contexts share
+  const decltype(writeDefsMap) *moduleWriteDefsMap = &writeDefsMap;
+
+  // Built on the first reaching definitions query within each function
+  llvm::DenseMap<const llvm::Function *,
+                 std::unique_ptr<IR2Vec::ReachabilityIndex>>
+      reachability;
+
   llvm::SmallMapVector<const llvm::Instruction *,
                        llvm::SmallVector<const llvm::Instruction *, 10>, 16>
       instReachingDefsMap;
@@ -70,14 +111,23 @@ private:
 
   std::map<int, std::vector<int>> SCCAdjList;
 
+  // Sums of the operand and reaching definition vectors of the instruction
+  // being encoded, and right-hand sides of the system of solveInsts; sized
+  // once and reused for every instruction
+  IR2Vec::Vector argsVector;
+  IR2Vec::Vector rdsVector;
+  std::vector<std::vector<double>> solverRows;
+
   void getAllSCC();
 
-  IR2Vec::Vector getValue(std::string key);
-  void collectWriteDefsMap(llvm::Module &M);
+  const double *getValue(unsigned entity);
+  void collectWriteDefs(llvm::Function &F);
+  void collectCallees(llvm::Function &F);
+  void analyzeFunction(llvm::Function &F);
   void getTransitiveUse(
-      const llvm::Instruction *root, const llvm::Instruction *def,
-      llvm::SmallVector<const llvm::Instruction *, 100> &visitedList,
-      llvm::SmallVector<const llvm::Instruction *, 10> toAppend = {});
+      const llvm::Instruction *root,
+      llvm::SmallPtrSetImpl<const llvm::Instruction *> &visitedSet);
+  IR2Vec::ReachabilityIndex &getReachability(const llvm::Function &F);
   llvm::SmallVector<const llvm::Instruction *, 10>
   getReachingDefs(const llvm::Instruction *, unsigned i);
 
@@ -89,6 +139,10 @@ private:
                      llvm::SmallMapVector<const llvm::Instruction *,
                                           IR2Vec::Vector, 16> &instValMap);
 
+  // Components of more instructions than this are solved with a sparse LU
+  // factorization; smaller ones with the dense solver
+  static constexpr unsigned sparseSolverThreshold = 64;
+
   void solveInsts(llvm::SmallMapVector<const llvm::Instruction *,
                                        IR2Vec::Vector, 16> &instValMap);
   std::vector<int> topoOrder(int size);
@@ -113,8 +167,7 @@ private:
   IR2Vec::Vector func2Vec(llvm::Function &F,
                           llvm::SmallVector<llvm::Function *, 15> &funcStack);
 
-  bool isMemOp(llvm::StringRef opcode, unsigned &operand,
-               llvm::SmallDenseMap<llvm::StringRef, unsigned> map);
+  bool isMemOp(unsigned opcode, unsigned &operand, const MemOpTable &table);
   std::string splitAndPipeFunctionName(std::string s);
 
   void TransitiveReads(llvm::SmallVector<llvm::Instruction *, 16> &Killlist,
@@ -131,42 +184,56 @@ private:
 
   void updateFuncVecMapWithCallee(const llvm::Function *function);
 
-public:
-  IR2Vec_FA(llvm::Module &M, IR2Vec::VocabTy &vocab) : M{M}, vocabulary{vocab} {
-
-    pgmVector = IR2Vec::Vector(IR2Vec::DIM, 0);
-    res = "";
-
-    memWriteOps.try_emplace("store", 1);
-    memWriteOps.try_emplace("cmpxchg", 0);
-    memWriteOps.try_emplace("atomicrmw", 0);
-
-    memAccessOps.try_emplace("getelementptr", 0);
-    memAccessOps.try_emplace("load", 0);
-
+  IR2Vec::Vector getVectorWithCallees(
+      const llvm::Function *function,
+      const llvm::DenseMap<const llvm::Function *, unsigned> &positions);
+  void forgetFunction(const llvm::Function *function);
+  void clearAnalysis();
+
+  // Creates a context of its own analysis state for the module of Parent and
+  // encodes F in it, so that functions can be encoded in parallel
+  IR2Vec_FA(const IR2Vec_FA &Parent, llvm::Function &F)
+      : M{Parent.M}, config{Parent.config}, vocabulary{Parent.vocabulary},
+        kernels{Parent.kernels}, cache{Parent.cache},
+        phaseTimes{Parent.phaseTimes}, memWriteOps{Parent.memWriteOps},
+        memAccessOps{Parent.memAccessOps},
+        moduleWriteDefsMap{Parent.moduleWriteDefsMap} {
+    pgmVector = IR2Vec::Vector(config.dim, 0);
+    argsVector = IR2Vec::Vector(config.dim, 0);
+    rdsVector = IR2Vec::Vector(config.dim, 0);
     dataMissCounter = 0;
     cyclicCounter = 0;
 
-    collectWriteDefsMap(M);
+    llvm::SmallVector<llvm::Function *, 15> funcStack;
+    func2Vec(F, funcStack);
+  }
+
+  void encodeFunctions(llvm::SmallVectorImpl<llvm::Function *> &functions);
 
-    llvm::CallGraph cg = llvm::CallGraph(M);
+public:
+  IR2Vec_FA(llvm::Module &M, const IR2Vec::VocabularyBase &vocab,
+            const IR2Vec::Config &config)
+      : M{M}, config{config}, vocabulary{vocab},
+        kernels{IR2Vec::getVectorKernels(vocab.getDimension())} {
+    assert(config.dim == vocab.getDimension() &&
+           "Dimension of the configuration and the vocabulary differ");
+
+    pgmVector = IR2Vec::Vector(config.dim, 0);
+    argsVector = IR2Vec::Vector(config.dim, 0);
+    rdsVector = IR2Vec::Vector(config.dim, 0);
+    res = "";
 
-    for (auto callItr = cg.begin(); callItr != cg.end(); callItr++) {
-      if (callItr->first && !callItr->first->isDeclaration()) {
-        auto ParentFunc = callItr->first;
-        llvm::CallGraphNode *cgn = callItr->second.get();
-        if (cgn) {
+    memWriteOps.fill(-1);
+    memWriteOps[llvm::Instruction::Store] = 1;
+    memWriteOps[llvm::Instruction::AtomicCmpXchg] = 0;
+    memWriteOps[llvm::Instruction::AtomicRMW] = 0;
 
-          for (auto It = cgn->begin(); It != cgn->end(); It++) {
+    memAccessOps.fill(-1);
+    memAccessOps[llvm::Instruction::GetElementPtr] = 0;
+    memAccessOps[llvm::Instruction::Load] = 0;
 
-            auto func = It->second->getFunction();
-            if (func && !func->isDeclaration()) {
-              funcCallMap[ParentFunc].push_back(func);
-            }
-          }
-        }
-      }
-    }
+    dataMissCounter = 0;
+    cyclicCounter = 0;
   }
 
   void generateFlowAwareEncodings(std::ostream *o = nullptr,
@@ -179,6 +246,32 @@ public:
       std::ostream *o = nullptr, std::string name = "",
       std::ostream *missCount = nullptr, std::ostream *cyclicCount = nullptr);
 
+  // Encodes F alone: the vectors of its callees, which
+  // generateFlowAwareEncodings adds to the ones of their callers, are not
+  // added
+  IR2Vec::Vector generateFunctionBodyEncoding(llvm::Function &F);
+
+  // Encodes again the functions of Changed after they were modified or added
+  // to the module, and forgets the ones of Removed. Only the instruction and
+  // basic block vectors of Changed are computed; the vectors of their callers
+  // are updated with the callee vectors that changed. Functions whose vector
+  // changed are added to Updated along with it. Functions calling a function
+  // that was removed, or that was defined or declared anew, must be in
+  // Changed.
+  void updateFlowAwareEncodings(
+      llvm::ArrayRef<llvm::Function *> changed,
+      llvm::ArrayRef<const llvm::Function *> removed,
+      llvm::SmallMapVector<const llvm::Function *, IR2Vec::Vector, 16>
+          &updated);
+
+  // Moves the instruction and basic block vectors out, and drops the state of
+  // the analysis of the encoded functions
+  void takeVecMaps(
+      llvm::SmallMapVector<const llvm::Instruction *, IR2Vec::Vector, 128>
+          &instVecs,
+      llvm::SmallMapVector<const llvm::BasicBlock *, IR2Vec::Vector, 16>
+          &bbVecs);
+
   llvm::SmallMapVector<const llvm::Instruction *, IR2Vec::Vector, 128>
   getInstVecMap() {
     return instVecMap;
@@ -195,6 +288,18 @@ public:
   }
 
   IR2Vec::Vector getProgramVector() { return pgmVector; }
+
+  // Collects the embeddings that would be printed into table, for the binary
+  // output formats
+  void setEmbeddingTable(IR2Vec::EmbeddingTable *table) {
+    this->table = table;
+  }
+
+  void setEmbeddingCache(const IR2Vec::EmbeddingCache *cache) {
+    this->cache = cache;
+  }
+
+  void setPhaseTimes(IR2Vec::PhaseTimes *times) { phaseTimes = times; }
 };
 
 #endif
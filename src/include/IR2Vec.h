@@ -9,15 +9,43 @@
 #ifndef __IR2Vec__
 #define __IR2Vec__
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBufferRef.h"
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "Vocabulary.h"
+
+class IR2Vec_FA;
+class IR2Vec_Symbolic;
+
+namespace llvm {
+class SMDiagnostic;
+} // namespace llvm
+
 namespace IR2Vec {
 
 enum IR2VecMode { FlowAware, Symbolic };
 
+// Parses the textual or bitcode IR of Buffer, so that IR held in memory, like
+// the bitcode of a compiler or the contents of MemoryBuffer::getSTDIN(), is
+// not written to a file first. Buffer need not end in a NUL: textual IR is
+// copied before it is parsed. Returns null with Err set if the IR is not
+// valid.
+std::unique_ptr<llvm::Module> parseIR(llvm::MemoryBufferRef Buffer,
+                                      llvm::LLVMContext &Context,
+                                      llvm::SMDiagnostic &Err);
+
+// Parses the IR of a string; Name identifies it in the diagnostics
+std::unique_ptr<llvm::Module> parseIR(llvm::StringRef IR,
+                                      llvm::LLVMContext &Context,
+                                      llvm::SMDiagnostic &Err,
+                                      llvm::StringRef Name = "<memory>");
+
 class Embeddings {
   int generateEncodings(llvm::Module &M, IR2VecMode mode, char level = '\0',
                         std::string funcName = "", unsigned dim = 300,
@@ -28,26 +56,60 @@ class Embeddings {
   llvm::SmallMapVector<const llvm::BasicBlock *, IR2Vec::Vector, 16> bbVecMap;
   llvm::SmallMapVector<const llvm::Function *, Vector, 16> funcVecMap;
   Vector pgmVector;
-  std::map<std::string, IR2Vec::Vector> vocabulary;
+  std::unique_ptr<VocabularyBase> vocabulary;
+
+  // Encoder of the module, kept when all of its functions are encoded so
+  // that updateFunctions encodes only the functions that changed. Encoders
+  // hold the configuration of the run, so that any number of Embeddings can
+  // be computed and updated concurrently, each of its own module.
+  std::unique_ptr<IR2Vec_FA> FA;
+  std::unique_ptr<IR2Vec_Symbolic> SYM;
+  unsigned dim = 300;
+  // Instructions and basic blocks of each function that have a vector, to
+  // drop the ones that are gone once the function changes
+  llvm::DenseMap<const llvm::Function *,
+                 std::pair<std::vector<const llvm::Instruction *>,
+                           std::vector<const llvm::BasicBlock *>>>
+      funcValues;
+
+  void addVecMaps(
+      llvm::SmallMapVector<const llvm::Instruction *, Vector, 128> &instVecs,
+      llvm::SmallMapVector<const llvm::BasicBlock *, Vector, 16> &bbVecs,
+      llvm::ArrayRef<const llvm::Function *> functions);
 
 public:
-  Embeddings() = default;
+  Embeddings();
   Embeddings(llvm::Module &M, IR2VecMode mode, unsigned dim = 300,
              std::string funcName = "", float WO = 1, float WA = 0.2,
-             float WT = 0.5) {
-    vocabulary = VocabularyFactory::createVocabulary(dim)->getVocabulary();
-    generateEncodings(M, mode, '\0', funcName, dim, nullptr, -1, WO, WA, WT);
-  }
+             float WT = 0.5);
 
   // Use this constructor if the representations ought to be written to a
   // file. Analogous to the command line options that are being used in IR2Vec
   // binary.
   Embeddings(llvm::Module &M, IR2VecMode mode, char level, std::ostream *o,
              unsigned dim = 300, std::string funcName = "", float WO = 1,
-             float WA = 0.2, float WT = 0.5) {
-    vocabulary = VocabularyFactory::createVocabulary(dim)->getVocabulary();
-    generateEncodings(M, mode, level, funcName, dim, o, -1, WO, WA, WT);
-  }
+             float WA = 0.2, float WT = 0.5);
+
+  Embeddings(Embeddings &&);
+  Embeddings &operator=(Embeddings &&);
+  ~Embeddings();
+
+  // Updates the embeddings after the functions of Changed were modified in
+  // place or added to the module, and the ones of Removed were erased from
+  // it; functions that turned into declarations can be in either. Only these
+  // functions are encoded again, along with the callers of the ones that were
+  // defined or declared anew. The vectors of the other callers are updated
+  // with the callee vectors that changed, and the program vector with the
+  // difference of the function vectors, so that the cost of an update follows
+  // the size of the change rather than the one of the module. Functions
+  // calling a removed function must be in Changed.
+  //
+  // Function vectors are the ones a new Embeddings of the module gives; the
+  // program vector may differ from it by the rounding of the sums. Only
+  // available when all the functions of the module were encoded; returns
+  // false and leaves the embeddings as they are otherwise.
+  bool updateFunctions(llvm::ArrayRef<llvm::Function *> changed,
+                       llvm::ArrayRef<const llvm::Function *> removed = {});
 
   // Returns a map containing instructions and the corresponding vector
   // representations for a given module corresponding to the IR2VecMode and
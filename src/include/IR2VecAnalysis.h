@@ -0,0 +1,101 @@
+//===- IR2VecAnalysis.h - IR2Vec analyses of the pass manager ---*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __IR2Vec_ANALYSIS_H__
+#define __IR2Vec_ANALYSIS_H__
+
+#include "IR2Vec.h"
+#include "VectorOps.h"
+#include "Vocabulary.h"
+
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <utility>
+
+namespace IR2Vec {
+
+// Configuration of the analyses, with the defaults of IR2Vec::Embeddings
+struct AnalysisConfig {
+  IR2VecMode mode = FlowAware;
+  unsigned dim = 300;
+  float WO = 1;
+  float WA = 0.2;
+  float WT = 0.5;
+};
+
+// Embeddings in the new pass manager. Functions are encoded by
+// IR2VecFunctionAnalysis, whose results are cached by the function analysis
+// manager until a pass changes the function. IR2VecModuleAnalysis computes the
+// function vectors along with the ones of their callees, and the program
+// vector, out of the cached results, so that only the functions that changed
+// since the last query are encoded again.
+class IR2VecFunctionAnalysis
+    : public llvm::AnalysisInfoMixin<IR2VecFunctionAnalysis> {
+  friend llvm::AnalysisInfoMixin<IR2VecFunctionAnalysis>;
+  static llvm::AnalysisKey Key;
+
+  AnalysisConfig config;
+  std::shared_ptr<VocabularyBase> vocabulary;
+
+public:
+  struct Result {
+    // Vector of the function alone; in flow-aware mode, IR2VecModuleAnalysis
+    // adds the vectors of the callees to it
+    Vector funcVector;
+    llvm::SmallMapVector<const llvm::Instruction *, Vector, 128> instVecMap;
+    llvm::SmallMapVector<const llvm::BasicBlock *, Vector, 16> bbVecMap;
+    // Functions called and whether they were defined, which the flow-aware
+    // vectors depend on
+    llvm::SmallVector<std::pair<const llvm::Function *, bool>, 8> callees;
+  };
+
+  explicit IR2VecFunctionAnalysis(AnalysisConfig config = {});
+
+  Result run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+};
+
+class IR2VecModuleAnalysis
+    : public llvm::AnalysisInfoMixin<IR2VecModuleAnalysis> {
+  friend llvm::AnalysisInfoMixin<IR2VecModuleAnalysis>;
+  static llvm::AnalysisKey Key;
+
+  AnalysisConfig config;
+
+public:
+  struct Result {
+    llvm::SmallMapVector<const llvm::Function *, Vector, 16> funcVecMap;
+    Vector pgmVector;
+  };
+
+  explicit IR2VecModuleAnalysis(AnalysisConfig config = {}) : config{config} {}
+
+  Result run(llvm::Module &M, llvm::ModuleAnalysisManager &MAM);
+};
+
+// Prints the function vectors and the program vector, as the level f and p
+// outputs of the ir2vec binary do
+class IR2VecPrinterPass : public llvm::PassInfoMixin<IR2VecPrinterPass> {
+  llvm::raw_ostream &OS;
+
+public:
+  explicit IR2VecPrinterPass(llvm::raw_ostream &OS) : OS{OS} {}
+
+  llvm::PreservedAnalyses run(llvm::Module &M,
+                              llvm::ModuleAnalysisManager &MAM);
+
+  static bool isRequired() { return true; }
+};
+
+} // namespace IR2Vec
+
+#endif
@@ -0,0 +1,81 @@
+//===- PhaseTimer.h - Self times of the phases of the encoders --*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __IR2Vec_PHASE_TIMER_H__
+#define __IR2Vec_PHASE_TIMER_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace IR2Vec {
+
+enum class Phase : unsigned { ReachingDefs, SolveInsts, BB2Vec, Count };
+
+// Time spent in the phases of an encoder, for the benchmarks. A phase entered
+// from another one, as getReachingDefs is from bb2Vec, or bb2Vec of a callee
+// from bb2Vec of its caller, only counts towards the inner one, so that the
+// phases never count the same time twice.
+struct PhaseTimes {
+  static constexpr unsigned Count = unsigned(Phase::Count);
+
+  std::atomic<uint64_t> nanoseconds[Count] = {};
+  std::atomic<uint64_t> calls[Count] = {};
+
+  void clear() {
+    for (unsigned i = 0; i < Count; i++) {
+      nanoseconds[i] = 0;
+      calls[i] = 0;
+    }
+  }
+};
+
+// Adds the time of the enclosing scope, less that of the phases it enters, to
+// its phase in times. Does nothing if times is null.
+class PhaseScope {
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  PhaseTimes *times;
+  Phase phase;
+  PhaseScope *parent = nullptr;
+  Clock::time_point start;
+  Clock::duration children{0};
+
+  static inline thread_local PhaseScope *current = nullptr;
+
+public:
+  PhaseScope(PhaseTimes *times, Phase phase) : times{times}, phase{phase} {
+    if (!times)
+      return;
+    parent = current;
+    current = this;
+    start = Clock::now();
+  }
+
+  ~PhaseScope() {
+    if (!times)
+      return;
+    auto elapsed = Clock::now() - start;
+    auto self = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        elapsed - children);
+    times->nanoseconds[unsigned(phase)] += self.count();
+    times->calls[unsigned(phase)]++;
+    if (parent)
+      parent->children += elapsed;
+    current = parent;
+  }
+
+  PhaseScope(const PhaseScope &) = delete;
+  PhaseScope &operator=(const PhaseScope &) = delete;
+};
+
+} // namespace IR2Vec
+
+#endif
@@ -0,0 +1,71 @@
+//===- Reachability.h - Reachability within a function ----------*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __IR2Vec_REACHABILITY_H__
+#define __IR2Vec_REACHABILITY_H__
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include <vector>
+
+namespace IR2Vec {
+
+// Answers the reachability queries of llvm::isPotentiallyReachable, without
+// dominator tree or loop info, for the instructions of a function.
+//
+// That walk gives up after MaxBlocksToExplore blocks and then answers true, so
+// its answer only depends on whether the target is reachable when fewer
+// blocks than that are reachable. The index keeps, for each block, the blocks
+// reachable from its successors while there are fewer than that, which
+// answers a query with a lookup in at most MaxBlocksToExplore sorted block
+// numbers instead of a walk of the CFG.
+class ReachabilityIndex {
+
+public:
+  static constexpr unsigned MaxBlocksToExplore = 32;
+
+  explicit ReachabilityIndex(const llvm::Function &F);
+
+  // Same as llvm::isPotentiallyReachable(A, B)
+  bool isPotentiallyReachable(const llvm::Instruction *A,
+                              const llvm::Instruction *B) const;
+
+  // Same as llvm::isPotentiallyReachable(A, B, &ExclusionSet) with an
+  // ExclusionSet of the blocks of Blocks other than the one of A
+  bool isPotentiallyReachableAvoiding(
+      const llvm::Instruction *A, const llvm::Instruction *B,
+      const llvm::SmallPtrSetImpl<const llvm::BasicBlock *> &Blocks);
+
+private:
+  const llvm::Function &F;
+  std::vector<const llvm::BasicBlock *> blocks;
+  llvm::DenseMap<const llvm::BasicBlock *, unsigned> blockNumbers;
+  std::vector<llvm::SmallVector<unsigned, 2>> successors;
+
+  // Sorted numbers of the blocks reachable from the successors of a block,
+  // unless there are MaxBlocksToExplore or more of them (large)
+  std::vector<llvm::SmallVector<unsigned, 4>> reachable;
+  std::vector<bool> large;
+
+  // Scratch state of the walks; a block is visited in the current walk if its
+  // stamp is the current epoch
+  std::vector<unsigned> stamps;
+  unsigned epoch = 0;
+  llvm::SmallVector<unsigned, 32> worklist;
+
+  bool reaches(unsigned From, unsigned To) const;
+  bool isSameBlockQuery(const llvm::Instruction *A, const llvm::Instruction *B,
+                        bool &Result) const;
+};
+
+} // namespace IR2Vec
+
+#endif
@@ -9,8 +9,12 @@
 #ifndef __IR2Vec_Symbolic_H__
 #define __IR2Vec_Symbolic_H__
 
+#include "EmbeddingCache.h"
+#include "EmbeddingWriter.h"
+#include "PhaseTimer.h"
 #include "utils.h"
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Function.h"
@@ -24,10 +28,19 @@ class IR2Vec_Symbolic {
 
 private:
   llvm::Module &M;
-  IR2Vec::VocabTy &vocabulary;
+  const IR2Vec::Config config;
+  const IR2Vec::VocabularyBase &vocabulary;
+  // Kernels specialized for the dimension of the vocabulary
+  const IR2Vec::VectorKernels &kernels;
   IR2Vec::Vector pgmVector;
+  // Receives the embeddings instead of the text output if set
+  IR2Vec::EmbeddingTable *table = nullptr;
+  // Function vectors are looked up in and added to the cache if set
+  const IR2Vec::EmbeddingCache *cache = nullptr;
+  // Receives the time spent in bb2Vec if set
+  IR2Vec::PhaseTimes *phaseTimes = nullptr;
 
-  IR2Vec::Vector getValue(std::string key);
+  const double *getValue(unsigned entity);
   IR2Vec::Vector bb2Vec(llvm::BasicBlock &B,
                         llvm::SmallVector<llvm::Function *, 15> &funcStack);
   IR2Vec::Vector func2Vec(llvm::Function &F,
@@ -37,17 +50,43 @@ private:
   llvm::SmallMapVector<const llvm::BasicBlock *, IR2Vec::Vector, 16> bbVecMap;
   llvm::SmallMapVector<const llvm::Instruction *, IR2Vec::Vector, 128>
       instVecMap;
+  // Vector of the instruction being encoded, sized once and reused
+  IR2Vec::Vector instScratch;
 
 public:
-  IR2Vec_Symbolic(llvm::Module &M, IR2Vec::VocabTy &vocab)
-      : M{M}, vocabulary{vocab} {
-    pgmVector = IR2Vec::Vector(IR2Vec::DIM, 0);
+  IR2Vec_Symbolic(llvm::Module &M, const IR2Vec::VocabularyBase &vocab,
+                  const IR2Vec::Config &config)
+      : M{M}, config{config}, vocabulary{vocab},
+        kernels{IR2Vec::getVectorKernels(vocab.getDimension())} {
+    assert(config.dim == vocab.getDimension() &&
+           "Dimension of the configuration and the vocabulary differ");
+    pgmVector = IR2Vec::Vector(config.dim, 0);
+    instScratch = IR2Vec::Vector(config.dim, 0);
     res = "";
   }
 
   void generateSymbolicEncodings(std::ostream *o = nullptr);
   void generateSymbolicEncodingsForFunction(std::ostream *o = nullptr,
                                             std::string name = "");
+
+  IR2Vec::Vector generateFunctionEncoding(llvm::Function &F);
+
+  // Encodes again the functions of Changed after they were modified or added
+  // to the module, and forgets the ones of Removed. Functions whose vector
+  // changed are added to Updated along with it
+  void updateSymbolicEncodings(
+      llvm::ArrayRef<llvm::Function *> changed,
+      llvm::ArrayRef<const llvm::Function *> removed,
+      llvm::SmallMapVector<const llvm::Function *, IR2Vec::Vector, 16>
+          &updated);
+
+  // Moves the instruction and basic block vectors out
+  void takeVecMaps(
+      llvm::SmallMapVector<const llvm::Instruction *, IR2Vec::Vector, 128>
+          &instVecs,
+      llvm::SmallMapVector<const llvm::BasicBlock *, IR2Vec::Vector, 16>
+          &bbVecs);
+
   llvm::SmallMapVector<const llvm::Instruction *, IR2Vec::Vector, 128>
   getInstVecMap() {
     return instVecMap;
@@ -64,6 +103,18 @@ public:
   }
 
   IR2Vec::Vector getProgramVector() { return pgmVector; }
+
+  // Collects the embeddings that would be printed into table, for the binary
+  // output formats
+  void setEmbeddingTable(IR2Vec::EmbeddingTable *table) {
+    this->table = table;
+  }
+
+  void setEmbeddingCache(const IR2Vec::EmbeddingCache *cache) {
+    this->cache = cache;
+  }
+
+  void setPhaseTimes(IR2Vec::PhaseTimes *times) { phaseTimes = times; }
 };
 
 #endif
@@ -0,0 +1,120 @@
+//===- TripleIndex.h - OpenKE index files of CollectIR ----------*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __IR2Vec_TRIPLE_INDEX_H__
+#define __IR2Vec_TRIPLE_INDEX_H__
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace IR2Vec {
+
+// Triple of the training set, with the layout of Triple of
+// seed_embeddings/OpenKE/base/Triple.h
+struct IndexTriple {
+  int64_t head;
+  int64_t relation;
+  int64_t tail;
+};
+
+// Layout of the train2id.bin files, in little-endian byte order:
+//   TripleFileHeader
+//   count IndexTriple
+// The triples start at byte 64, so that the file can be mapped and the
+// triples used in place by the OpenKE reader. Their ids are the ones of the
+// entity2id.txt and relation2id.txt files of the same directory.
+struct TripleFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t count;
+  uint64_t entityCount;
+  uint64_t relationCount;
+  uint64_t reserved2[3];
+};
+
+// Relations between the opcode of an instruction and its type, the opcode of
+// the next instruction, and the kind of its operand i at FirstArgRelation + i
+enum : int64_t { TypeRelation = 0, NextRelation = 1, FirstArgRelation = 2 };
+
+// Builds the entity2id.txt, relation2id.txt and train2id.bin files of a
+// directory in a single pass over the triplets of CollectIR, in place of
+// seed_embeddings/OpenKE/preprocess.py. Entities are numbered as they are
+// first seen; close renumbers them in sorted order, as preprocess.py does,
+// and rewrites the triples with the final ids. Like the text output, an
+// existing index of the directory is added to.
+//
+// Threads add triples through TripleStreams of their own, which only lock
+// the index for entities they have not seen yet and for full buffers.
+class TripleIndex {
+
+private:
+  std::string dir;
+  // Triples of this run with the ids of entityNames, until close
+  std::string tmpPath;
+  std::ofstream out;
+  uint64_t count = 0;
+  // Triples of the existing index
+  uint64_t existingCount = 0;
+  int64_t relationCount = FirstArgRelation;
+
+  std::mutex mutex;
+  std::vector<std::string> entityNames;
+  llvm::StringMap<int64_t> entityIds;
+
+  void readExisting();
+
+public:
+  explicit TripleIndex(const std::string &dir);
+  ~TripleIndex();
+
+  int64_t getEntity(llvm::StringRef name);
+  void write(llvm::ArrayRef<IndexTriple> triples, int64_t relations);
+  // Renumbers the entities and writes the index files in place
+  void close();
+};
+
+// Triples of the instructions collected by a thread, in the order
+// preprocess.py reads them from the text output: an instruction is the head
+// of a Type triple to its type and of an Arg<i> triple to its operand i, and
+// the tail of a Next triple from the instruction before it.
+class TripleStream {
+
+private:
+  // Triples are handed to the index once this many have been buffered
+  static constexpr size_t BufferSize = 1 << 14;
+
+  TripleIndex &index;
+  // Ids the index gave to the entities seen by the stream
+  llvm::StringMap<int64_t> entities;
+  int64_t previous = -1;
+  int64_t relations = FirstArgRelation;
+  std::vector<IndexTriple> triples;
+
+  int64_t getEntity(llvm::StringRef name);
+
+public:
+  explicit TripleStream(TripleIndex &index) : index{index} {
+    triples.reserve(BufferSize);
+  }
+  ~TripleStream() { flush(); }
+
+  // Adds the opcode, type and operand kinds of an instruction
+  void add(llvm::ArrayRef<llvm::StringRef> tokens);
+  void flush();
+};
+
+} // namespace IR2Vec
+
+#endif
@@ -0,0 +1,102 @@
+//===- VectorOps.h - Kernels for arithmetic on embeddings -------*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __IR2Vec_VECTOR_OPS_H__
+#define __IR2Vec_VECTOR_OPS_H__
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace IR2Vec {
+
+using Vector = std::vector<double>;
+
+// The kernels are selected once at runtime among AVX-512, AVX2, SSE2 and
+// scalar implementations. All of them round the product and the sum of
+// addScaled separately, so that every implementation gives the same
+// embeddings bit for bit. src points to at least dst.size() elements.
+class VectorKernels {
+public:
+  using AddFn = void (*)(double *dst, const double *src, size_t n);
+  using AddScaledFn = void (*)(double *dst, double factor, const double *src,
+                               size_t n);
+  using ScaleFn = void (*)(double *dst, double factor, size_t n);
+  using ClampFn = void (*)(double *dst, size_t n);
+
+  VectorKernels(unsigned dim, AddFn add, AddScaledFn addScaled, ScaleFn scale,
+                ClampFn clamp)
+      : dim{dim}, addFn{add}, addScaledFn{addScaled}, scaleFn{scale},
+        clampFn{clamp} {}
+
+  // dst += src
+  void add(Vector &dst, const double *src) const {
+    assert((!dim || dst.size() == dim) && "Vector of another dimension");
+    addFn(dst.data(), src, dst.size());
+  }
+  void add(Vector &dst, const Vector &src) const { add(dst, src.data()); }
+
+  // dst += factor * src
+  void addScaled(Vector &dst, float factor, const double *src) const {
+    assert((!dim || dst.size() == dim) && "Vector of another dimension");
+    addScaledFn(dst.data(), factor, src, dst.size());
+  }
+  void addScaled(Vector &dst, float factor, const Vector &src) const {
+    addScaled(dst, factor, src.data());
+  }
+
+  // vec *= factor
+  void scale(Vector &vec, float factor) const {
+    assert((!dim || vec.size() == dim) && "Vector of another dimension");
+    scaleFn(vec.data(), factor, vec.size());
+  }
+
+  // Flushes the elements within 0.0001 of zero to zero, as done for the
+  // embeddings that are printed
+  void clamp(Vector &vec) const {
+    assert((!dim || vec.size() == dim) && "Vector of another dimension");
+    clampFn(vec.data(), vec.size());
+  }
+
+private:
+  unsigned dim;
+  AddFn addFn;
+  AddScaledFn addScaledFn;
+  ScaleFn scaleFn;
+  ClampFn clampFn;
+};
+
+// Kernels for vectors of dim elements. The dimensions of the shipped
+// vocabularies (75, 100 and 300) get kernels compiled for that length, with
+// the loops unrolled; other dimensions get kernels for any length
+const VectorKernels &getVectorKernels(unsigned dim);
+
+// Shorthands for vectors outside the encoders, which are dispatched on the
+// size of the vector at each call
+inline void addVector(Vector &dst, const double *src) {
+  getVectorKernels(dst.size()).add(dst, src);
+}
+inline void addVector(Vector &dst, const Vector &src) {
+  addVector(dst, src.data());
+}
+inline void addVectorScaled(Vector &dst, float factor, const double *src) {
+  getVectorKernels(dst.size()).addScaled(dst, factor, src);
+}
+inline void addVectorScaled(Vector &dst, float factor, const Vector &src) {
+  addVectorScaled(dst, factor, src.data());
+}
+inline void scaleVector(Vector &vec, float factor) {
+  getVectorKernels(vec.size()).scale(vec, factor);
+}
+inline void clampVector(Vector &vec) {
+  getVectorKernels(vec.size()).clamp(vec);
+}
+
+} // namespace IR2Vec
+
+#endif
@@ -13,9 +13,13 @@
 #include <cmath>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <set>
 #include <vector>
 using namespace std;
 typedef std::vector<std::vector<double>> matrix;
+// Rows of (column, value) pairs of the non-zeros of a square matrix
+typedef std::vector<std::vector<std::pair<int, double>>> sparseMatrix;
 // Function to swap rows in a matrix
 void swapRows(std::vector<double> &row1, std::vector<double> &row2) {
   std::swap(row1, row2);
@@ -94,4 +98,69 @@ matrix solve(matrix &A, matrix &B) {
   return X;
 }
 
+// Solves AX = B by Gaussian elimination with partial pivoting that only goes
+// through the non-zeros of the rows of A. Like gaussJordan, unknowns without
+// a pivot are left as 0.
+matrix solveSparse(const sparseMatrix &A, matrix &B) {
+  int n = A.size();
+  int k = B[0].size();
+
+  std::vector<std::map<int, double>> rows(n);
+  // Rows not yet eliminated having a non-zero in each column
+  std::vector<std::set<int>> colRows(n);
+  for (int i = 0; i < n; ++i)
+    for (auto &entry : A[i])
+      if (entry.second != 0) {
+        rows[i][entry.first] = entry.second;
+        colRows[entry.first].insert(i);
+      }
+
+  vector<int> where(n, -1);
+  for (int col = 0; col < n; ++col) {
+    int sel = -1;
+    for (int i : colRows[col])
+      if (sel == -1 || abs(rows[i][col]) > abs(rows[sel][col]))
+        sel = i;
+    if (sel == -1 || abs(rows[sel][col]) < EPS)
+      continue;
+    where[col] = sel;
+    // The pivot row only has non-zeros from col on
+    for (auto &entry : rows[sel])
+      colRows[entry.first].erase(sel);
+
+    auto below = colRows[col];
+    for (int i : below) {
+      double c = rows[i][col] / rows[sel][col];
+      for (auto &entry : rows[sel]) {
+        auto it = rows[i].find(entry.first);
+        if (it == rows[i].end()) {
+          rows[i][entry.first] = -entry.second * c;
+          colRows[entry.first].insert(i);
+        } else
+          it->second -= entry.second * c;
+      }
+      rows[i].erase(col);
+      colRows[col].erase(i);
+      for (int j = 0; j < k; ++j)
+        B[i][j] -= B[sel][j] * c;
+    }
+  }
+
+  matrix X(n, std::vector<double>(k, 0));
+  for (int col = n - 1; col >= 0; --col) {
+    int row = where[col];
+    if (row == -1)
+      continue;
+    double pivot = rows[row][col];
+    for (int j = 0; j < k; ++j) {
+      double sum = B[row][j];
+      for (auto &entry : rows[row])
+        if (entry.first > col)
+          sum -= entry.second * X[entry.first][j];
+      X[col][j] = sum / pivot;
+    }
+  }
+  return X;
+}
+
 #endif
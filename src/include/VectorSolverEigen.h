@@ -12,21 +12,32 @@
 
 #include "Eigen/LU"
 #include "Eigen/QR"
+#include "Eigen/SparseCore"
+#include "Eigen/SparseQR"
 #include "llvm/ADT/SmallVector.h"
+#include <algorithm>
 #include <vector>
 
 using namespace Eigen;
 using namespace llvm;
 
 typedef std::vector<std::vector<double>> matrix;
+// Rows of (column, value) pairs of the non-zeros of a square matrix
+typedef std::vector<std::vector<std::pair<int, double>>> sparseMatrix;
 
-MatrixXd calculate(MatrixXd A, MatrixXd B) {
-  if (A.determinant() != 0) {
-    return A.fullPivHouseholderQr().solve(B);
-  } else {
-    // To-Do: perturb probabilities
-    llvm_unreachable("inconsistent/infinitely many solutions");
-  }
+// Pivots of the QR factorizations that are at most this fraction of the
+// largest one count as zero, as by default in FullPivHouseholderQR
+double pivotThreshold(Index n) { return NumTraits<double>::epsilon() * n; }
+
+MatrixXd calculate(const MatrixXd &A, const MatrixXd &B) {
+  auto QR = A.fullPivHouseholderQr();
+  QR.setThreshold(pivotThreshold(A.rows()));
+  if (QR.isInvertible())
+    return QR.solve(B);
+  // To-Do: perturb probabilities
+  // Systems without a unique solution take the least-squares solution of
+  // minimal norm
+  return A.completeOrthogonalDecomposition().solve(B);
 }
 
 MatrixXd formMatrix(std::vector<std::vector<double>> a, int r, int l) {
@@ -62,4 +73,33 @@ matrix solve(matrix A, matrix B) {
   return raw_data;
 }
 
+// Factors the sparse A once and solves for all the columns of B
+matrix solveSparse(const sparseMatrix &A, const matrix &B) {
+  int n = A.size();
+  std::vector<Triplet<double>> triplets;
+  for (int i = 0; i < n; i++)
+    for (auto &entry : A[i])
+      triplets.emplace_back(i, entry.first, entry.second);
+  SparseMatrix<double> mA(n, n);
+  mA.setFromTriplets(triplets.begin(), triplets.end());
+
+  // The rank is decided as for the dense systems: columns whose pivot is
+  // small next to the largest column norm count as dependent
+  double maxNorm = 0;
+  for (int j = 0; j < n; j++)
+    maxNorm = std::max(maxNorm, mA.col(j).norm());
+  SparseQR<SparseMatrix<double>, COLAMDOrdering<int>> QR;
+  QR.setPivotThreshold(pivotThreshold(n) * maxNorm);
+  QR.compute(mA);
+  MatrixXd mB = formMatrix(B, B.size(), B[0].size());
+  // A singular A is solved like the dense ones
+  MatrixXd x = QR.info() == Success && QR.rank() == n
+                   ? MatrixXd(QR.solve(mB))
+                   : calculate(MatrixXd(mA), mB);
+  matrix raw_data(x.rows(), std::vector<double>(x.cols()));
+  for (unsigned i = 0; i < x.rows(); i++)
+    VectorXd::Map(&raw_data[i][0], x.cols()) = x.row(i);
+  return raw_data;
+}
+
 #endif
@@ -16,43 +16,64 @@
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "VectorOps.h"
+#include "Vocabulary.h"
+
 #include <cxxabi.h>
 
 #include <map>
 
 namespace IR2Vec {
 
+// Runs X when the diagnostics of the Config named config in scope are on
 #define IR2VEC_DEBUG(X)                                                        \
   ({                                                                           \
-    if (IR2Vec::debug) {                                                       \
+    if (config.debug) {                                                        \
       X;                                                                       \
     }                                                                          \
   })
 
 using Vector = std::vector<double>;
-using VocabTy = std::map<std::string, Vector>;
 using abi::__cxa_demangle;
 
+// Options of an encoding run. Engines keep a copy of their own rather than
+// reading process-wide state, so that modules can be encoded concurrently
+// with different options; dim must be the one of the vocabulary.
+struct Config {
+  // 'p' or 'f' for the text output; '\0' if nothing is printed
+  char level = '\0';
+  // Class written before the program vector; none if -1
+  int cls = -1;
+  std::string funcName;
+  unsigned dim = 300;
+  float WO = 1;
+  float WA = 0.2;
+  float WT = 0.5;
+  // Workers encoding the functions of a module in flow-aware mode
+  unsigned threads = 1;
+  bool debug = false;
+};
+
 extern bool fa;
 extern bool sym;
 extern bool printTime;
 extern bool collectIR;
 extern std::string iname;
 extern std::string oname;
-extern std::string funcName;
-extern char level;
-extern int cls;
-extern float WO;
-extern float WA;
-extern float WT;
-extern bool debug;
-extern unsigned DIM;
+// Parses the IR of iname, or of the standard input if it is "-"
 std::unique_ptr<llvm::Module> getLLVMIR();
-void scaleVector(Vector &vec, float factor);
+// Vocabulary entity of an opcode; NUM_VOCAB_ENTITIES if it has none
+unsigned getOpcodeEntity(unsigned opcode);
+// Vocabulary entity of a type
+unsigned getTypeEntity(const llvm::Type *type);
 // newly added
 std::string getDemagledName(const llvm::Function *function);
-char *getActualName(llvm::Function *function);
+// Base name of the function without namespace or parameters; the demangled
+// name if it cannot be demangled partially
+std::string getActualName(llvm::Function *function);
 std::string updatedRes(IR2Vec::Vector tmp, llvm::Function *f, llvm::Module *M);
+// Key of the embedding of a function in the outputs
+std::string getFunctionKey(const llvm::Function *f, const llvm::Module *M);
 } // namespace IR2Vec
 
 #endif
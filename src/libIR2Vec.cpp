@@ -12,8 +12,60 @@
 #include "Symbolic.h"
 #include "utils.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/IR/AbstractCallSite.h"
+#include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+
+using namespace llvm;
+
+std::unique_ptr<Module> IR2Vec::parseIR(MemoryBufferRef Buffer,
+                                        LLVMContext &Context,
+                                        SMDiagnostic &Err) {
+  // The textual IR parser reads up to a NUL past the end of the buffer, which
+  // views like a slice of a larger buffer do not hold; parse a copy of them
+  auto *Start =
+      reinterpret_cast<const unsigned char *>(Buffer.getBufferStart());
+  auto *End = reinterpret_cast<const unsigned char *>(Buffer.getBufferEnd());
+  if (isBitcode(Start, End))
+    return llvm::parseIR(Buffer, Err, Context);
+  std::unique_ptr<MemoryBuffer> Copy = MemoryBuffer::getMemBufferCopy(
+      Buffer.getBuffer(), Buffer.getBufferIdentifier());
+  return llvm::parseIR(Copy->getMemBufferRef(), Err, Context);
+}
+
+std::unique_ptr<Module> IR2Vec::parseIR(StringRef IR, LLVMContext &Context,
+                                        SMDiagnostic &Err, StringRef Name) {
+  return parseIR(MemoryBufferRef(IR, Name), Context, Err);
+}
+
+IR2Vec::Embeddings::Embeddings() = default;
+IR2Vec::Embeddings::Embeddings(Embeddings &&) = default;
+IR2Vec::Embeddings &
+IR2Vec::Embeddings::operator=(Embeddings &&) = default;
+IR2Vec::Embeddings::~Embeddings() = default;
+
+IR2Vec::Embeddings::Embeddings(Module &M, IR2VecMode mode, unsigned dim,
+                               std::string funcName, float WO, float WA,
+                               float WT)
+    : dim{dim} {
+  vocabulary = VocabularyFactory::createVocabulary(dim);
+  generateEncodings(M, mode, '\0', funcName, dim, nullptr, -1, WO, WA, WT);
+}
+
+IR2Vec::Embeddings::Embeddings(Module &M, IR2VecMode mode, char level,
+                               std::ostream *o, unsigned dim,
+                               std::string funcName, float WO, float WA,
+                               float WT)
+    : dim{dim} {
+  vocabulary = VocabularyFactory::createVocabulary(dim);
+  generateEncodings(M, mode, level, funcName, dim, o, -1, WO, WA, WT);
+}
 
 int IR2Vec::Embeddings::generateEncodings(llvm::Module &M,
                                           IR2Vec::IR2VecMode mode, char level,
@@ -21,41 +73,162 @@ int IR2Vec::Embeddings::generateEncodings(llvm::Module &M,
                                           std::ostream *o, int cls, float WO,
                                           float WA, float WT) {
 
-  IR2Vec::level = level;
-  IR2Vec::cls = cls;
-  IR2Vec::WO = WO;
-  IR2Vec::WA = WA;
-  IR2Vec::WT = WT;
-  IR2Vec::funcName = funcName;
-  IR2Vec::DIM = dim;
+  Config config;
+  config.level = level;
+  config.cls = cls;
+  config.funcName = funcName;
+  config.dim = dim;
+  config.WO = WO;
+  config.WA = WA;
+  config.WT = WT;
 
   if (mode == IR2Vec::IR2VecMode::FlowAware && !funcName.empty()) {
-    IR2Vec_FA FA(M, vocabulary);
+    IR2Vec_FA FA(M, *vocabulary, config);
     FA.generateFlowAwareEncodingsForFunction(o, funcName);
     instVecMap = FA.getInstVecMap();
     funcVecMap = FA.getFuncVecMap();
     bbVecMap = FA.getBBVecMap();
   } else if (mode == IR2Vec::IR2VecMode::FlowAware) {
-    IR2Vec_FA FA(M, vocabulary);
-    FA.generateFlowAwareEncodings(o);
-    instVecMap = FA.getInstVecMap();
-    funcVecMap = FA.getFuncVecMap();
-    bbVecMap = FA.getBBVecMap();
-    pgmVector = FA.getProgramVector();
+    FA = std::make_unique<IR2Vec_FA>(M, *vocabulary, config);
+    FA->generateFlowAwareEncodings(o);
+    funcVecMap = FA->getFuncVecMap();
+    pgmVector = FA->getProgramVector();
+    SmallMapVector<const Instruction *, Vector, 128> instVecs;
+    SmallMapVector<const BasicBlock *, Vector, 16> bbVecs;
+    FA->takeVecMaps(instVecs, bbVecs);
+    addVecMaps(instVecs, bbVecs, {});
   } else if (mode == IR2Vec::IR2VecMode::Symbolic && !funcName.empty()) {
-    IR2Vec_Symbolic SYM(M, vocabulary);
+    IR2Vec_Symbolic SYM(M, *vocabulary, config);
     SYM.generateSymbolicEncodingsForFunction(0, funcName);
     instVecMap = SYM.getInstVecMap();
     funcVecMap = SYM.getFuncVecMap();
     bbVecMap = SYM.getBBVecMap();
   } else if (mode == IR2Vec::IR2VecMode::Symbolic) {
-    IR2Vec_Symbolic SYM(M, vocabulary);
-    SYM.generateSymbolicEncodings(o);
-    instVecMap = SYM.getInstVecMap();
-    funcVecMap = SYM.getFuncVecMap();
-    bbVecMap = SYM.getBBVecMap();
-    pgmVector = SYM.getProgramVector();
+    SYM = std::make_unique<IR2Vec_Symbolic>(M, *vocabulary, config);
+    SYM->generateSymbolicEncodings(o);
+    funcVecMap = SYM->getFuncVecMap();
+    pgmVector = SYM->getProgramVector();
+    SmallMapVector<const Instruction *, Vector, 128> instVecs;
+    SmallMapVector<const BasicBlock *, Vector, 16> bbVecs;
+    SYM->takeVecMaps(instVecs, bbVecs);
+    addVecMaps(instVecs, bbVecs, {});
   }
 
   return 0;
 }
+
+// Merges the instruction and basic block vectors of the functions encoded
+// again, or of all functions on the first call. The vectors of the values of
+// Functions that no longer have one are removed first, as the values may have
+// been freed and their addresses reused by the new values
+void IR2Vec::Embeddings::addVecMaps(
+    SmallMapVector<const Instruction *, Vector, 128> &instVecs,
+    SmallMapVector<const BasicBlock *, Vector, 16> &bbVecs,
+    ArrayRef<const Function *> functions) {
+  SmallPtrSet<const Instruction *, 32> staleInsts;
+  SmallPtrSet<const BasicBlock *, 16> staleBBs;
+  for (auto F : functions) {
+    auto It = funcValues.find(F);
+    if (It == funcValues.end())
+      continue;
+    for (auto I : It->second.first) {
+      if (!instVecs.count(I))
+        staleInsts.insert(I);
+    }
+    for (auto BB : It->second.second) {
+      if (!bbVecs.count(BB))
+        staleBBs.insert(BB);
+    }
+    funcValues.erase(It);
+  }
+
+  if (!staleInsts.empty())
+    instVecMap.remove_if(
+        [&](const auto &It) { return staleInsts.count(It.first) != 0; });
+  if (!staleBBs.empty())
+    bbVecMap.remove_if(
+        [&](const auto &It) { return staleBBs.count(It.first) != 0; });
+
+  for (auto &It : instVecs) {
+    funcValues[It.first->getFunction()].first.push_back(It.first);
+    instVecMap[It.first] = std::move(It.second);
+  }
+  for (auto &It : bbVecs) {
+    funcValues[It.first->getParent()].second.push_back(It.first);
+    bbVecMap[It.first] = std::move(It.second);
+  }
+}
+
+bool IR2Vec::Embeddings::updateFunctions(ArrayRef<Function *> changed,
+                                         ArrayRef<const Function *> removed) {
+  // Embeddings of a single function keep no encoder to update
+  if (!FA && !SYM)
+    return false;
+
+  SmallPtrSet<const Function *, 16> seen;
+  SmallVector<Function *, 16> functions;
+  for (auto F : changed) {
+    if (seen.insert(F).second)
+      functions.push_back(F);
+  }
+  // In flow-aware mode, the vector of a function depends on whether its
+  // callees are defined
+  if (FA) {
+    for (unsigned i = 0, e = functions.size(); i < e; i++) {
+      auto F = functions[i];
+      if (F->isDeclaration() == !funcVecMap.count(F))
+        continue;
+      for (auto U : F->users()) {
+        auto call = dyn_cast<CallBase>(U);
+        if (!call)
+          continue;
+        bool calls = call->getCalledFunction() == F;
+        forEachCallbackFunction(*call, [&](Function *callback) {
+          calls |= callback == F;
+        });
+        if (calls && seen.insert(call->getFunction()).second)
+          functions.push_back(call->getFunction());
+      }
+    }
+  }
+
+  SmallMapVector<const Function *, Vector, 16> updated;
+  SmallMapVector<const Instruction *, Vector, 128> instVecs;
+  SmallMapVector<const BasicBlock *, Vector, 16> bbVecs;
+  if (FA) {
+    FA->updateFlowAwareEncodings(functions, removed, updated);
+    FA->takeVecMaps(instVecs, bbVecs);
+  } else {
+    SYM->updateSymbolicEncodings(functions, removed, updated);
+    SYM->takeVecMaps(instVecs, bbVecs);
+  }
+
+  SmallVector<const Function *, 16> encoded(functions.begin(),
+                                            functions.end());
+  encoded.append(removed.begin(), removed.end());
+  addVecMaps(instVecs, bbVecs, encoded);
+
+  const auto &kernels = getVectorKernels(dim);
+  SmallPtrSet<const Function *, 16> dropped(removed.begin(), removed.end());
+  for (auto F : functions) {
+    if (F->isDeclaration())
+      dropped.insert(F);
+  }
+  for (auto F : dropped) {
+    auto It = funcVecMap.find(F);
+    if (It != funcVecMap.end())
+      kernels.addScaled(pgmVector, -1, It->second);
+  }
+  if (!dropped.empty())
+    funcVecMap.remove_if(
+        [&](const auto &It) { return dropped.count(It.first) != 0; });
+
+  for (auto &It : updated) {
+    auto &vec = funcVecMap[It.first];
+    if (!vec.empty())
+      kernels.addScaled(pgmVector, -1, vec);
+    kernels.add(pgmVector, It.second);
+    vec = std::move(It.second);
+  }
+  return true;
+}
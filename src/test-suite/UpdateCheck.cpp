@@ -0,0 +1,196 @@
+//===- UpdateCheck.cpp - Checks of Embeddings::updateFunctions --*- C++ -*-===//
+//
+// Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+// Exceptions. See the LICENSE file for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+// Edits the functions of each input module in a few ways, updates the
+// embeddings of the module after each edit, and checks them against the ones
+// of a new Embeddings of the edited module.
+
+#include "IR2Vec.h"
+
+#include "llvm/IR/AbstractCallSite.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include <cmath>
+
+using namespace llvm;
+using namespace IR2Vec;
+
+cl::list<std::string> cl_inputs(cl::Positional, cl::OneOrMore,
+                                cl::desc("<.ll/.bc files>"));
+
+template <typename MapT>
+static bool sameVectors(const MapT &updated, const MapT &fresh) {
+  if (updated.size() != fresh.size())
+    return false;
+  for (auto &It : fresh) {
+    auto U = updated.find(It.first);
+    if (U == updated.end() || U->second != It.second)
+      return false;
+  }
+  return true;
+}
+
+// Compares the updated embeddings with the ones of a new Embeddings of M. The
+// program vectors only have to agree up to the rounding of their sums
+static bool matchesFresh(Module &M, IR2VecMode mode, Embeddings &updated,
+                         const std::string &step) {
+  Embeddings fresh(M, mode);
+  const char *differs = nullptr;
+  if (!sameVectors(updated.getFunctionVecMap(), fresh.getFunctionVecMap()))
+    differs = "function vectors";
+  else if (!sameVectors(updated.getInstVecMap(), fresh.getInstVecMap()))
+    differs = "instruction vectors";
+  else if (!sameVectors(updated.getBBVecMap(), fresh.getBBVecMap()))
+    differs = "basic block vectors";
+  else
+    for (unsigned i = 0; i < fresh.getProgramVector().size(); i++) {
+      double a = updated.getProgramVector()[i];
+      double b = fresh.getProgramVector()[i];
+      if (std::fabs(a - b) > 1e-6 * std::max(1.0, std::fabs(b)))
+        differs = "program vector";
+    }
+  if (differs)
+    errs() << step << ": " << differs << " differ from a new encoding\n";
+  return !differs;
+}
+
+// Turns the first integer or floating point addition or subtraction of F into
+// the other one
+static bool swapOpcode(Function &F) {
+  for (auto &I : instructions(F)) {
+    auto *op = dyn_cast<BinaryOperator>(&I);
+    if (!op)
+      continue;
+    Instruction::BinaryOps swapped;
+    switch (op->getOpcode()) {
+    case Instruction::Add:
+      swapped = Instruction::Sub;
+      break;
+    case Instruction::Sub:
+      swapped = Instruction::Add;
+      break;
+    case Instruction::FAdd:
+      swapped = Instruction::FSub;
+      break;
+    case Instruction::FSub:
+      swapped = Instruction::FAdd;
+      break;
+    default:
+      continue;
+    }
+    auto *replacement = BinaryOperator::Create(swapped, op->getOperand(0),
+                                               op->getOperand(1), "", op);
+    op->replaceAllUsesWith(replacement);
+    op->eraseFromParent();
+    return true;
+  }
+  return false;
+}
+
+// A defined function other than main that is called by a defined function,
+// directly or back through the !callback metadata of the call
+static Function *findCallee(Module &M) {
+  for (auto &F : M) {
+    if (F.isDeclaration() || F.getName() == "main")
+      continue;
+    for (auto U : F.users()) {
+      auto call = dyn_cast<CallBase>(U);
+      if (!call)
+        continue;
+      bool calls = call->getCalledFunction() == &F;
+      forEachCallbackFunction(*call, [&](Function *callback) {
+        calls |= callback == &F;
+      });
+      if (calls)
+        return &F;
+    }
+  }
+  return nullptr;
+}
+
+static bool checkModule(const std::string &path, IR2VecMode mode) {
+  LLVMContext context;
+  SMDiagnostic err;
+  auto M = parseIRFile(path, err, context);
+  if (!M) {
+    err.print(path.c_str(), errs());
+    return false;
+  }
+  std::string name = path + (mode == FlowAware ? " (fa)" : " (sym)");
+  bool passed = true;
+
+  Function *first = nullptr;
+  for (auto &F : *M)
+    if (!F.isDeclaration()) {
+      first = &F;
+      break;
+    }
+  if (!first)
+    return true;
+
+  Embeddings single(*M, mode, 300, first->getName().str());
+  if (single.updateFunctions({first})) {
+    errs() << name << ": embeddings of a single function were updated\n";
+    passed = false;
+  }
+
+  Embeddings embeddings(*M, mode);
+  for (auto &F : *M)
+    if (!F.isDeclaration() && swapOpcode(F)) {
+      embeddings.updateFunctions({&F});
+      passed &= matchesFresh(*M, mode, embeddings,
+                             name + ", opcode swapped in " + F.getName().str());
+      break;
+    }
+
+  ValueToValueMapTy VMap;
+  Function *clone = CloneFunction(first, VMap);
+  embeddings.updateFunctions({clone});
+  passed &= matchesFresh(*M, mode, embeddings,
+                         name + ", " + first->getName().str() + " cloned");
+
+  if (auto *callee = findCallee(*M)) {
+    callee->deleteBody();
+    embeddings.updateFunctions({callee});
+    passed &= matchesFresh(*M, mode, embeddings,
+                           name + ", body of " + callee->getName().str() +
+                               " deleted");
+  }
+
+  const Function *erased = clone;
+  clone->eraseFromParent();
+  embeddings.updateFunctions({}, {erased});
+  passed &= matchesFresh(*M, mode, embeddings, name + ", clone erased");
+  return passed;
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Checks of Embeddings::updateFunctions\n");
+  unsigned failed = 0;
+  for (auto &path : cl_inputs)
+    for (auto mode : {FlowAware, Symbolic})
+      failed += !checkModule(path, mode);
+
+  if (failed) {
+    errs() << "[Test Failed] " << failed
+           << " updates differ from a new encoding\n";
+    return 1;
+  }
+  outs() << "[Test Passed] Updated embeddings of " << cl_inputs.size()
+         << " modules match new encodings\n";
+  return 0;
+}
@@ -0,0 +1,33 @@
+; main starts worker through pthread_create, whose !callback metadata makes
+; worker a callee of main in the call graph, and calls helper directly.
+source_filename = "callback.c"
+
+define internal ptr @worker(ptr %arg) {
+entry:
+  %0 = load i32, ptr %arg, align 4
+  %inc = add nsw i32 %0, 1
+  store i32 %inc, ptr %arg, align 4
+  ret ptr null
+}
+
+define internal i32 @helper(i32 %x) {
+entry:
+  %mul = mul nsw i32 %x, 2
+  ret i32 %mul
+}
+
+define i32 @main() {
+entry:
+  %thread = alloca i64, align 8
+  %count = alloca i32, align 4
+  store i32 1, ptr %count, align 4
+  %call = call i32 @pthread_create(ptr %thread, ptr null, ptr @worker, ptr %count)
+  %0 = load i32, ptr %count, align 4
+  %call1 = call i32 @helper(i32 %0)
+  ret i32 %call1
+}
+
+declare !callback !0 i32 @pthread_create(ptr, ptr, ptr, ptr)
+
+!0 = !{!1}
+!1 = !{i64 2, i64 3, i1 false}
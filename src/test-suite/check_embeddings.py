@@ -0,0 +1,118 @@
+# Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+# Exceptions. See the LICENSE file for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+
+"""Checks the -format bin and npy output of ir2vec against the text output.
+
+compare LEVEL TEXT BIN NPY
+    Checks that BIN and NPY, along with NPY.keys, hold the rows of TEXT, of
+    level p or f, in the same order: the same keys (function-level text only)
+    and class labels (program-level text only), and the same values once
+    clamped and rounded like in the text.
+"""
+
+import struct
+import sys
+
+import numpy as np
+
+HEADER = struct.Struct("<8sIIQccB5xfff4xQQQQQQ")
+CLAMP_LIMIT = 0.0001
+
+
+def fail(message):
+    sys.exit("[Test Failed] " + message)
+
+
+def read_text(path, level, dim):
+    keys, labels, rows = [], [], []
+    with open(path) as f:
+        for line in f:
+            if level == "f":
+                key, values = line.rstrip("\n").split("\t=\t")
+                label = -1
+            else:
+                key, values = None, line
+            values = [float(v) for v in values.split()]
+            if level == "p" and len(values) == dim + 1:
+                label, values = int(values[0]), values[1:]
+            elif level == "p":
+                label = -1
+            keys.append(key)
+            labels.append(label)
+            rows.append(values)
+    return keys, labels, rows
+
+
+def read_bin(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    (magic, version, dim, rows, _, _, element_size, _, _, _, _, matrix_offset,
+     labels_offset, key_offsets_offset, keys_offset,
+     file_size) = HEADER.unpack_from(data)
+    if magic != b"IR2VECB\0" or version != 1:
+        fail(f"{path} is not an IR2Vec binary embedding file")
+    if file_size != len(data):
+        fail(f"{path} is {len(data)} bytes instead of {file_size}")
+    for offset in (matrix_offset, labels_offset, key_offsets_offset,
+                   keys_offset):
+        if offset % 64:
+            fail(f"{path} has a section at {offset}, not aligned to 64 bytes")
+    dtype = "<f4" if element_size == 4 else "<f8"
+    matrix = np.frombuffer(data, dtype, rows * dim, matrix_offset)
+    labels = list(np.frombuffer(data, "<i4", rows, labels_offset))
+    offsets = list(np.frombuffer(data, "<u8", rows + 1, key_offsets_offset))
+    keys = [
+        data[keys_offset + offsets[i]:keys_offset + offsets[i + 1]].decode()
+        for i in range(rows)
+    ]
+    return keys, labels, matrix.reshape(rows, dim)
+
+
+def unescape(key):
+    return (key.replace("\\\\", "\0").replace("\\t", "\t")
+            .replace("\\n", "\n").replace("\0", "\\"))
+
+
+def read_npy(path):
+    matrix = np.load(path)
+    keys, labels = [], []
+    with open(path + ".keys") as f:
+        for line in f:
+            key, _, label = line.rstrip("\n").partition("\t")
+            keys.append(unescape(key))
+            labels.append(int(label) if label else -1)
+    if len(keys) != matrix.shape[0]:
+        fail(f"{path}.keys lists {len(keys)} keys of {matrix.shape[0]} rows")
+    return keys, labels, matrix
+
+
+def check(path, level, text, table):
+    text_keys, text_labels, text_rows = text
+    keys, labels, matrix = table
+    if len(keys) != len(text_rows):
+        fail(f"{path} holds {len(keys)} rows instead of {len(text_rows)}")
+    if level == "f" and keys != text_keys:
+        fail(f"keys of {path} differ from the text output")
+    if labels != text_labels:
+        fail(f"labels of {path} differ from the text output")
+    clamped = np.where(np.abs(matrix) <= CLAMP_LIMIT, 0, matrix)
+    if not np.allclose(clamped, np.array(text_rows), rtol=0, atol=1e-6):
+        fail(f"values of {path} differ from the text output")
+
+
+def main():
+    if len(sys.argv) != 6 or sys.argv[1] != "compare":
+        sys.exit(__doc__)
+    level, text_path, bin_path, npy_path = sys.argv[2:]
+    binary, npy = read_bin(bin_path), read_npy(npy_path)
+    text = read_text(text_path, level, binary[2].shape[1])
+    check(bin_path, level, text, binary)
+    check(npy_path, level, text, npy)
+    if binary[0] != npy[0]:
+        fail(f"keys of {bin_path} and {npy_path} differ")
+
+
+if __name__ == "__main__":
+    main()
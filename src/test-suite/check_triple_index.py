@@ -0,0 +1,97 @@
+# Part of the IR2Vec Project, under the Apache License v2.0 with LLVM
+# Exceptions. See the LICENSE file for license information.
+# SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+#
+
+"""Checks the OpenKE index of ir2vec -collectIR -format bin.
+
+compare BIN_DIR PREPROCESSED_DIR NAMED_TRIPLES
+    Checks the index of BIN_DIR against the files preprocess.py generated in
+    PREPROCESSED_DIR from the text output, and appends the triples of BIN_DIR,
+    with entity names instead of ids, to NAMED_TRIPLES.
+holds BIN_DIR NAMED_TRIPLES
+    Checks that the triples of BIN_DIR are the ones of NAMED_TRIPLES, in any
+    order.
+"""
+
+import os
+import struct
+import sys
+
+HEADER = struct.Struct("<8sIIQQQ24x")
+TRIPLE = struct.Struct("<qqq")
+
+
+def fail(message):
+    sys.exit("[Test Failed] " + message)
+
+
+def read_ids(path):
+    with open(path) as f:
+        count = int(f.readline())
+        lines = [line.rstrip("\n").split("\t") for line in f]
+    if len(lines) != count:
+        fail(f"{path} lists {len(lines)} of {count} entries")
+    return [(name, int(id)) for name, id in lines]
+
+
+def read_bin(bin_dir):
+    with open(os.path.join(bin_dir, "train2id.bin"), "rb") as f:
+        data = f.read()
+    magic, version, _, count, entities, relations = HEADER.unpack_from(data)
+    if magic != b"IR2VTRP\0" or version != 1:
+        fail(f"{bin_dir}/train2id.bin is not an IR2Vec triple file")
+    if len(data) != HEADER.size + count * TRIPLE.size:
+        fail(f"{bin_dir}/train2id.bin does not hold {count} triples")
+    triples = [
+        TRIPLE.unpack_from(data, HEADER.size + i * TRIPLE.size) for i in range(count)
+    ]
+    return triples, entities, relations
+
+
+def named(bin_dir):
+    names = {id: name for name, id in read_ids(os.path.join(bin_dir, "entity2id.txt"))}
+    triples, _, _ = read_bin(bin_dir)
+    return [f"{names[h]}\t{r}\t{names[t]}" for h, r, t in triples]
+
+
+def compare(bin_dir, pre_dir, named_triples):
+    entities = read_ids(os.path.join(bin_dir, "entity2id.txt"))
+    if entities != read_ids(os.path.join(pre_dir, "entity2id.txt")):
+        fail(f"entities of {bin_dir} differ from preprocess.py")
+
+    # The count line of preprocess.py counts one more relation than it lists
+    relations = read_ids(os.path.join(bin_dir, "relation2id.txt"))
+    with open(os.path.join(pre_dir, "relation2id.txt")) as f:
+        f.readline()
+        expected = [line.rstrip("\n").split("\t") for line in f]
+    if relations != [(name, int(id)) for name, id in expected]:
+        fail(f"relations of {bin_dir} differ from preprocess.py")
+
+    triples, entityCount, relationCount = read_bin(bin_dir)
+    if entityCount != len(entities) or relationCount != len(relations):
+        fail(f"header of {bin_dir}/train2id.bin does not match its index")
+    # train2id.txt lists head, tail and relation
+    with open(os.path.join(pre_dir, "train2id.txt")) as f:
+        count = int(f.readline())
+        expected = [tuple(map(int, line.split())) for line in f]
+    if len(expected) != count or [(h, t, r) for h, r, t in triples] != expected:
+        fail(f"triples of {bin_dir} differ from preprocess.py")
+
+    with open(named_triples, "a") as f:
+        for triple in named(bin_dir):
+            f.write(triple + "\n")
+
+
+def holds(bin_dir, named_triples):
+    with open(named_triples) as f:
+        expected = f.read().splitlines()
+    if sorted(named(bin_dir)) != sorted(expected):
+        fail(f"triples of {bin_dir} are not the ones of {named_triples}")
+
+
+if __name__ == "__main__":
+    if sys.argv[1] == "compare":
+        compare(*sys.argv[2:5])
+    else:
+        holds(*sys.argv[2:4])
@@ -7,3 +7,6 @@ config.suffixes = [".lit"]
 
 config.test_source_root = os.path.dirname(__file__)
 config.test_exec_root = os.path.join(config.my_obj_root, "src/test-suite")
+
+# opt of the LLVM the plugin is built against
+config.substitutions.append(("%opt", os.path.join(config.llvm_tools_dir, "opt")))
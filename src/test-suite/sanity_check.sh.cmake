@@ -35,11 +35,12 @@ functions=("main" "buildMatchingMachine" "search" "BellamFord" "BFS" "isBCUtil"
 	"selectKItems" "getMinDiceThrows" "countSort" "subset_sum" "SolveSudoku" "SCC" "solveKTUtil" "topologicalSort" "transitiveClosure" "insertSuffix" "tugOfWar" "isUgly" "Union" "printVertexCover"
 	 "findMaxProfit" "solveWordWrap")
 
-perform_vector_comparison() {
+set_comparison_files() {
     LEVEL=$1
     FILE_PREFIX=$2
+    shift 2
 
-    echo -e "${BLUE}${BOLD}Running ir2vec on ${FILE_PREFIX}-level for ${EncodingType} encoding type"
+    echo -e "${BLUE}${BOLD}Running ir2vec on ${FILE_PREFIX}-level for ${EncodingType} encoding type $*"
 
     ORIG_FILE=oracle/${EncodingType}_${SEED_VERSION}_${FILE_PREFIX}/ir2vec.txt
     VIR_FILE=ir2vec_${FILE_PREFIX}.txt
@@ -51,30 +52,61 @@ perform_vector_comparison() {
         SQLITE_INPUT=./sqlite3.ll
         SQLITE_ORIG=oracle/${EncodingType}_${SEED_VERSION}_${FILE_PREFIX}/sqlite3.txt
     fi
+}
+
+# Arguments after the level and the file prefix are passed on to ir2vec
+perform_vector_comparison() {
+    set_comparison_files "$@"
+    shift 2
 
     # if file prefix is p or f, run the first while loop, else, run the second while loop
 
     if [[ "$FILE_PREFIX" == "p" || "$FILE_PREFIX" == "f" ]]; then
         while IFS= read -r d; do
-            ${IR2VEC_PATH} -${PASS} -level ${LEVEL} -o ${VIR_FILE} ${d} &> /dev/null
+            ${IR2VEC_PATH} -${PASS} -level ${LEVEL} "$@" -o ${VIR_FILE} ${d} &> /dev/null
         done < index-${SEED_VERSION}.files
         wait
 
         # SQLITE is currently only tested against the program (p) level
         if [[ "$ENABLE_SQLITE" == "ON" && "$FILE_PREFIX" == "p" ]]; then
-            ${IR2VEC_PATH} -${PASS} -level ${LEVEL} -o ${SQLITE_VIR} ${SQLITE_INPUT} &> /dev/null
+            ${IR2VEC_PATH} -${PASS} -level ${LEVEL} "$@" -o ${SQLITE_VIR} ${SQLITE_INPUT} &> /dev/null
         fi
     else
         while IFS= read -r d_on
         do
             for func in "${functions[@]}"
             do
-                ${IR2VEC_PATH} -${PASS} -level ${LEVEL} -funcName=$func -o ${VIR_FILE} ${d_on} &> /dev/null
+                ${IR2VEC_PATH} -${PASS} -level ${LEVEL} "$@" -funcName=$func -o ${VIR_FILE} ${d_on} &> /dev/null
             done
         done < index-${SEED_VERSION}.files
         wait
     fi
 
+    compare_with_oracle
+}
+
+# Runs ir2vec in batch mode on the two halves of the index in turn, so that
+# the output is checked to follow the input order and to be appended to
+perform_batch_comparison() {
+    set_comparison_files "$@" -batch
+    shift 2
+
+    HALF=$(( $(wc -l < index-${SEED_VERSION}.files) / 2 ))
+    head -n ${HALF} index-${SEED_VERSION}.files > batch_1.files
+    tail -n +$(( HALF + 1 )) index-${SEED_VERSION}.files > batch_2.files
+    for list in batch_1.files batch_2.files; do
+        ${IR2VEC_PATH} -${PASS} -level ${LEVEL} "$@" -batch ${list} -o ${VIR_FILE} &> /dev/null
+    done
+    rm -f batch_1.files batch_2.files
+
+    if [[ "$ENABLE_SQLITE" == "ON" && "$FILE_PREFIX" == "p" ]]; then
+        ${IR2VEC_PATH} -${PASS} -level ${LEVEL} "$@" -o ${SQLITE_VIR} ${SQLITE_INPUT} &> /dev/null
+    fi
+
+    compare_with_oracle
+}
+
+compare_with_oracle() {
     TEMP=temp_${EncodingType}_${SEED_VERSION}_${FILE_PREFIX}
     if [[ "$LEVEL" == "p" ]]; then
         if ls *${VIR_FILE} 1> /dev/null 2>&1; then
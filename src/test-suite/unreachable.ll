@@ -0,0 +1,34 @@
+; clamp has a block that is not reachable from its entry, which the analyses
+; of the pass plugin encode on a copy of the function without it.
+source_filename = "unreachable.c"
+
+define i32 @clamp(ptr %p) {
+entry:
+  %0 = load i32, ptr %p, align 4
+  %cmp = icmp sgt i32 %0, 10
+  br i1 %cmp, label %big, label %small
+
+big:
+  store i32 10, ptr %p, align 4
+  br label %small
+
+small:
+  %1 = load i32, ptr %p, align 4
+  %add = add nsw i32 %1, 1
+  ret i32 %add
+
+dead:
+  %mul = mul nsw i32 %0, 3
+  store i32 %mul, ptr %p, align 4
+  br label %small
+}
+
+define i32 @main() {
+entry:
+  %a = alloca i32, align 4
+  store i32 5, ptr %a, align 4
+  %call = call i32 @clamp(ptr %a)
+  %2 = load i32, ptr %a, align 4
+  %sum = add nsw i32 %call, %2
+  ret i32 %sum
+}
@@ -9,6 +9,11 @@
 #include "utils.h"
 #include "IR2Vec.h"
 #include "Vocabulary.h"
+
+#include "llvm/IR/Instruction.h"
+
+#include <array>
+#include <cstring>
 #include <fstream>
 #include <string>
 using namespace llvm;
@@ -20,14 +25,6 @@ bool IR2Vec::printTime;
 bool IR2Vec::collectIR;
 std::string IR2Vec::iname;
 std::string IR2Vec::oname;
-std::string IR2Vec::funcName;
-char IR2Vec::level;
-int IR2Vec::cls;
-float IR2Vec::WO;
-float IR2Vec::WA;
-float IR2Vec::WT;
-bool IR2Vec::debug;
-unsigned IR2Vec::DIM;
 
 std::unique_ptr<Module> IR2Vec::getLLVMIR() {
   SMDiagnostic err;
@@ -41,9 +38,55 @@ std::unique_ptr<Module> IR2Vec::getLLVMIR() {
   return M;
 }
 
-void IR2Vec::scaleVector(Vector &vec, float factor) {
-  for (unsigned i = 0; i < vec.size(); i++) {
-    vec[i] = vec[i] * factor;
+unsigned IR2Vec::getOpcodeEntity(unsigned opcode) {
+  // Resolved by name once, so that the vocabulary does not depend on the
+  // numbering of opcodes in a particular LLVM version
+  static const auto opcodeEntities = [] {
+    std::array<unsigned, Instruction::OtherOpsEnd> entities;
+    entities.fill(NUM_VOCAB_ENTITIES);
+    for (unsigned op = 1; op < Instruction::OtherOpsEnd; op++)
+      for (unsigned e = 0; e < NUM_VOCAB_ENTITIES; e++)
+        if (strcmp(Instruction::getOpcodeName(op), VocabEntityNames[e]) == 0)
+          entities[op] = e;
+    return entities;
+  }();
+  return opcode < opcodeEntities.size() ? opcodeEntities[opcode]
+                                        : NUM_VOCAB_ENTITIES;
+}
+
+unsigned IR2Vec::getTypeEntity(const Type *type) {
+  switch (type->getTypeID()) {
+  case Type::VoidTyID:
+    return VOCAB_voidTy;
+  case Type::HalfTyID:
+  case Type::BFloatTyID:
+  case Type::FloatTyID:
+  case Type::DoubleTyID:
+  case Type::X86_FP80TyID:
+  case Type::FP128TyID:
+  case Type::PPC_FP128TyID:
+    return VOCAB_floatTy;
+  case Type::IntegerTyID:
+    return VOCAB_integerTy;
+  case Type::FunctionTyID:
+    return VOCAB_functionTy;
+  case Type::StructTyID:
+    return VOCAB_structTy;
+  case Type::ArrayTyID:
+    return VOCAB_arrayTy;
+  case Type::PointerTyID:
+    return VOCAB_pointerTy;
+  case Type::FixedVectorTyID:
+  case Type::ScalableVectorTyID:
+    return VOCAB_vectorTy;
+  case Type::LabelTyID:
+    return VOCAB_labelTy;
+  case Type::TokenTyID:
+    return VOCAB_tokenTy;
+  case Type::MetadataTyID:
+    return VOCAB_metadataTy;
+  default:
+    return VOCAB_unknownTy;
   }
 }
 
@@ -61,37 +104,37 @@ std::string IR2Vec::getDemagledName(const llvm::Function *function) {
 }
 
 // Function to get actual function name
-char *IR2Vec::getActualName(llvm::Function *function) {
+std::string IR2Vec::getActualName(llvm::Function *function) {
   auto functionName = function->getName().str();
-  auto demangledName = getDemagledName(function);
+  llvm::ItaniumPartialDemangler Mangler;
+  if (Mangler.partialDemangle(functionName.c_str()))
+    return getDemagledName(function);
+
   size_t Size = 1;
   char *Buf = static_cast<char *>(std::malloc(Size));
-  const char *mangled = functionName.c_str();
-  char *baseName;
-  llvm::ItaniumPartialDemangler Mangler;
-  if (Mangler.partialDemangle(mangled)) {
-    baseName = &demangledName[0];
-  } else {
-    baseName = Mangler.getFunctionBaseName(Buf, &Size);
-  }
+  // Buf is grown with realloc as needed; the result points to it if set
+  char *Name = Mangler.getFunctionBaseName(Buf, &Size);
+  std::string baseName = Name ? Name : getDemagledName(function);
+  std::free(Name ? Name : Buf);
   return baseName;
 }
 
+std::string IR2Vec::getFunctionKey(const llvm::Function *f,
+                                   const llvm::Module *M) {
+  return M->getSourceFileName() + "__" + getDemagledName(f);
+}
+
 // Function to return updated res
 std::string IR2Vec::updatedRes(IR2Vec::Vector tmp, llvm::Function *f,
                                llvm::Module *M) {
   std::string res = "";
-  auto demangledName = getDemagledName(f);
 
-  res += M->getSourceFileName() + "__" + demangledName + "\t";
+  res += getFunctionKey(f, M) + "\t";
 
   res += "=\t";
-  for (auto i : tmp) {
-    if ((i <= 0.0001 && i > 0) || (i < 0 && i >= -0.0001)) {
-      i = 0;
-    }
+  clampVector(tmp);
+  for (auto i : tmp)
     res += std::to_string(i) + "\t";
-  }
 
   return res;
 }